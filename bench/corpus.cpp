@@ -0,0 +1,156 @@
+#include "corpus.h"
+#include "sif/Parser/parser.h"
+#include <iterator>
+#include <random>
+
+namespace {
+// How deep each nest of blocks goes before the next one starts.
+const size_t NEST_DEPTH = 48;
+// Operators in each chained initializer.
+const size_t CHAIN_LEN = 256;
+// Characters in each string literal.
+const size_t STRING_LEN = 256 * 1024;
+
+const char *const SHAPE_NAMES[] = {"flat", "nested", "chain", "functions",
+                                   "strings"};
+
+const char *const OPERATORS[] = {"||", "&&", "==", "!=", "<",  "<=", ">",
+                                 ">=", "+",  "-",  "*",  "/",  "%"};
+
+// Identifiers may only contain letters, so names are numbered in base 26.
+std::string name(char prefix, size_t n) {
+  std::string ident = std::string(1, prefix);
+  do {
+    ident += static_cast<char>('a' + n % 26);
+    n /= 26;
+  } while (n != 0);
+  return ident;
+}
+
+// A number literal, mostly small whole numbers as in real programs, with
+// the occasional decimal and large number the lexer stores apart.
+std::string number(std::mt19937 &rng) {
+  switch (rng() % 8) {
+  case 0:
+    return std::to_string(rng() % 1000) + "." + std::to_string(rng() % 100);
+  case 1:
+    return std::to_string(4000000000u + rng() % 1000);
+  default:
+    return std::to_string(rng() % 1000);
+  }
+}
+
+// A number or one of the count variables named with prefix declared so
+// far.
+std::string operand(std::mt19937 &rng, char prefix, size_t count) {
+  if (count == 0 || rng() % 2 == 0) {
+    return number(rng);
+  }
+  return name(prefix, rng() % count);
+}
+
+void flat(std::mt19937 &rng, size_t decl, std::string &src) {
+  src += "var " + name('V', decl) + " = " + operand(rng, 'V', decl) + ";\n";
+}
+
+void nested(std::mt19937 &rng, std::string &src) {
+  for (size_t depth = 0; depth < NEST_DEPTH; depth++) {
+    std::string indent = std::string(depth * 2, ' ');
+    src += indent + "{\n";
+    src += indent + "  var " + name('L', depth) + " = " +
+           operand(rng, 'L', depth) + " + " + operand(rng, 'L', depth) +
+           ";\n";
+    if (depth > 0) {
+      src += indent + "  " + name('L', rng() % depth) + " = " +
+             name('L', depth) + ";\n";
+    }
+  }
+  for (size_t depth = NEST_DEPTH; depth-- > 0;) {
+    src += std::string(depth * 2, ' ') + "}\n";
+  }
+}
+
+void chain(std::mt19937 &rng, size_t decl, std::string &src) {
+  src += "var " + name('V', decl) + " = " + operand(rng, 'V', decl);
+  for (size_t i = 0; i < CHAIN_LEN; i++) {
+    src += " ";
+    src += OPERATORS[rng() % std::size(OPERATORS)];
+    src += " ";
+    if (rng() % 8 == 0) {
+      src += "(" + operand(rng, 'V', decl) + " - " +
+             operand(rng, 'V', decl) + ")";
+    } else {
+      src += operand(rng, 'V', decl);
+    }
+  }
+  src += ";\n";
+}
+
+void function(std::mt19937 &rng, size_t decl, std::string &src) {
+  size_t arity = decl % (sif::Parser::FN_PARAM_MAX_LEN + 1);
+  std::string fn_name = name('F', decl);
+  src += "fn " + fn_name + "(";
+  for (size_t i = 0; i < arity; i++) {
+    src += (i == 0 ? "" : ", ") + name('P', i);
+  }
+  src += ") {\n  var total = " + operand(rng, 'P', arity) + ";\n";
+  for (size_t i = 0; i < arity; i += 4) {
+    src += "  total = total + " + name('P', i) + " * " +
+           operand(rng, 'P', arity) + ";\n";
+  }
+  src += "  return total;\n}\n\n" + fn_name + "(";
+  for (size_t i = 0; i < arity; i++) {
+    src += (i == 0 ? "" : ", ") + number(rng);
+  }
+  src += ");\n";
+}
+
+void string_lit(std::mt19937 &rng, size_t decl, std::string &src) {
+  static const char CHARS[] = "abcdefghijklmnopqrstuvwxyz0123456789 .,;:";
+  src += "var " + name('S', decl) + " = \"";
+  for (size_t i = 0; i < STRING_LEN; i++) {
+    src += CHARS[rng() % (sizeof(CHARS) - 1)];
+  }
+  src += "\";\n";
+}
+} // namespace
+
+const char *CorpusShapeName(CorpusShape shape) {
+  return SHAPE_NAMES[static_cast<size_t>(shape)];
+}
+
+bool ParseCorpusShape(const std::string &name, CorpusShape &shape) {
+  for (size_t i = 0; i < NUM_CORPUS_SHAPES; i++) {
+    if (name == SHAPE_NAMES[i]) {
+      shape = static_cast<CorpusShape>(i);
+      return true;
+    }
+  }
+  return false;
+}
+
+std::string GenerateCorpus(CorpusShape shape, size_t bytes, uint32_t seed) {
+  std::mt19937 rng(seed);
+  std::string src;
+  src.reserve(bytes + STRING_LEN);
+  for (size_t decl = 0; src.size() < bytes; decl++) {
+    switch (shape) {
+    case CorpusShape::Flat:
+      flat(rng, decl, src);
+      break;
+    case CorpusShape::Nested:
+      nested(rng, src);
+      break;
+    case CorpusShape::Chain:
+      chain(rng, decl, src);
+      break;
+    case CorpusShape::Functions:
+      function(rng, decl, src);
+      break;
+    case CorpusShape::Strings:
+      string_lit(rng, decl, src);
+      break;
+    }
+  }
+  return src;
+}
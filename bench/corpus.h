@@ -0,0 +1,35 @@
+// Generates sif programs of a given shape and size for the benchmarks.
+// The same shape, size and seed always give the same text, and every
+// program parses without errors.
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+enum class CorpusShape {
+  // One long list of global variable declarations.
+  Flat,
+  // Blocks nested deeply inside one another, each declaring locals.
+  Nested,
+  // Declarations whose initializers are long chains of operators of mixed
+  // precedence.
+  Chain,
+  // Functions of every arity up to Parser::FN_PARAM_MAX_LEN, each called
+  // once.
+  Functions,
+  // Very long string literals.
+  Strings,
+};
+
+const size_t NUM_CORPUS_SHAPES = static_cast<size_t>(CorpusShape::Strings) + 1;
+
+const char *CorpusShapeName(CorpusShape shape);
+
+// Returns false if name is not the name of a shape.
+bool ParseCorpusShape(const std::string &name, CorpusShape &shape);
+
+// Returns a program of the given shape at least bytes long, stopping at
+// the first whole declaration past that.
+std::string GenerateCorpus(CorpusShape shape, size_t bytes,
+                           uint32_t seed = 1);
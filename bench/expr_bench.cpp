@@ -0,0 +1,122 @@
+// Parses generated, expression-heavy programs and reports parse throughput.
+// Two shapes are generated: "ladder" uses at most one operator per
+// precedence level, which every version of the expression parser accepts,
+// and "chain" strings many operators of mixed precedence together.
+//
+//   expr_bench [ladder|chain] [declarations] [iterations]
+#include "sif/Parser/ast_context.h"
+#include "sif/Parser/lexer.h"
+#include "sif/Parser/parser.h"
+#include "sif/Parser/source_buffer.h"
+#include "sif/Parser/symbol_table.h"
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+
+using namespace sif;
+
+static const char *LEVELS[][4] = {
+    {"%"},         {"*", "/"},        {"+", "-"}, {"<", ">", "<=", ">="},
+    {"==", "!="},  {"&&"},            {"||"},
+};
+static const size_t LEVEL_SIZES[] = {1, 2, 2, 4, 2, 1, 1};
+static const size_t NUM_LEVELS = 7;
+static const size_t CHAIN_LEN = 24;
+
+// Identifiers may only contain letters, so variables are named in base 26.
+static std::string var_name(size_t n) {
+  std::string name = "V";
+  do {
+    name += static_cast<char>('a' + n % 26);
+    n /= 26;
+  } while (n != 0);
+  return name;
+}
+
+static std::string operand(std::mt19937 &rng, size_t decl) {
+  switch (rng() % 4) {
+  case 0:
+    return std::to_string(rng() % 1000);
+  case 1:
+    return decl == 0 ? "1" : var_name(rng() % decl);
+  case 2:
+    return "(" + std::to_string(rng() % 10) + " - " +
+           std::to_string(rng() % 10) + ")";
+  default:
+    return "-" + std::to_string(rng() % 10);
+  }
+}
+
+static std::string generate(bool chain, size_t decls) {
+  std::mt19937 rng(9);
+  std::string src;
+
+  for (size_t i = 0; i < decls; i++) {
+    src += "var " + var_name(i) + " = " + operand(rng, i);
+    if (chain) {
+      for (size_t j = 0; j < CHAIN_LEN; j++) {
+        size_t level = rng() % NUM_LEVELS;
+        src += " ";
+        src += LEVELS[level][rng() % LEVEL_SIZES[level]];
+        src += " " + operand(rng, i);
+      }
+    } else {
+      for (size_t level = 0; level < NUM_LEVELS; level++) {
+        if (rng() % 10 < 6) {
+          src += " ";
+          src += LEVELS[level][rng() % LEVEL_SIZES[level]];
+          src += " " + operand(rng, i);
+        }
+      }
+    }
+    src += ";\n";
+  }
+  return src;
+}
+
+int main(int argc, char *argv[]) {
+  bool chain = argc > 1 && std::string(argv[1]) == "chain";
+  size_t decls = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 50000;
+  size_t iterations = argc > 3 ? std::strtoul(argv[3], nullptr, 10) : 5;
+
+  std::string src = generate(chain, decls);
+
+  size_t tokens = 0;
+  size_t errors = 0;
+  std::chrono::duration<double> best = std::chrono::duration<double>::max();
+  for (size_t i = 0; i < iterations; i++) {
+    StringInterner interner;
+    ASTContext ctx;
+    auto lexer =
+        std::make_unique<Lexer>(SourceBuffer::FromString(src), interner);
+    if (i == 0) {
+      Lexer counter = Lexer(SourceBuffer::FromString(src), interner);
+      while (counter.Lex().GetKind() != TokenKind::Eof) {
+        tokens++;
+      }
+    }
+
+    Parser parser =
+        Parser(std::move(lexer), std::make_unique<SymbolTable>(), ctx);
+    auto start = std::chrono::steady_clock::now();
+    auto result = parser.Parse();
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+
+    errors = result.errors_.size();
+    if (elapsed < best) {
+      best = elapsed;
+    }
+  }
+
+  double count = static_cast<double>(tokens);
+  std::cout << "shape:             " << (chain ? "chain" : "ladder") << "\n";
+  std::cout << "tokens:            " << tokens << "\n";
+  std::cout << "parse errors:      " << errors << "\n";
+  std::cout << "best parse time:   " << best.count() * 1000.0 << " ms\n";
+  std::cout << "tokens/sec:        " << count / best.count() << "\n";
+  return 0;
+}
@@ -0,0 +1,201 @@
+// Parses a file and checks that its FlatAST survives a round trip: the
+// tree is flattened, rebuilt and flattened again, and both flat forms must
+// be equal. Then reports the time to flatten, and the best time to visit
+// every node in pre-order, recursively over the node classes and as a scan
+// of the flat form. Exits with 1 if the round trip changed anything.
+//
+//   flat_ast_bench <file.sif> [iterations]
+#include "sif/Parser/ast.h"
+#include "sif/Parser/ast_context.h"
+#include "sif/Parser/flat_ast.h"
+#include "sif/Parser/lexer.h"
+#include "sif/Parser/parser.h"
+#include "sif/Parser/symbol_table.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <string>
+
+using namespace sif;
+
+namespace {
+// The work done per node on both walks, so neither can be optimised away.
+struct Counts {
+  size_t nodes = 0;
+  size_t calls = 0;
+
+  void visit(ASTKind kind) {
+    nodes++;
+    calls += kind == ASTKind::FnCallExpr;
+  }
+};
+
+void walk_list(ASTList list, Counts &counts);
+
+void walk(const ASTNode *node, Counts &counts) {
+  if (node == nullptr) {
+    return;
+  }
+  counts.visit(node->GetKind());
+
+  switch (node->GetKind()) {
+  case ASTKind::Program:
+    walk_list(static_cast<const ProgramAST *>(node)->blocks_, counts);
+    break;
+  case ASTKind::Block:
+    walk_list(static_cast<const BlockAST *>(node)->decls_, counts);
+    break;
+  case ASTKind::IfStmt: {
+    auto ast = static_cast<const IfStmtAST *>(node);
+    walk(ast->cond_expr, counts);
+    walk(ast->if_stmts, counts);
+    walk_list(ast->elif_exprs, counts);
+    walk_list(ast->else_stmts, counts);
+    break;
+  }
+  case ASTKind::ElifStmt: {
+    auto ast = static_cast<const ElifStmtAST *>(node);
+    walk(ast->cond_expr_, counts);
+    walk(ast->stmts_, counts);
+    break;
+  }
+  case ASTKind::ForStmt: {
+    auto ast = static_cast<const ForStmtAST *>(node);
+    walk(ast->var_list_, counts);
+    walk(ast->in_expr_list_, counts);
+    walk(ast->stmts_, counts);
+    break;
+  }
+  case ASTKind::ReturnStmt:
+    walk(static_cast<const ReturnStmtAST *>(node)->ret_expr_, counts);
+    break;
+  case ASTKind::ExprStmt:
+    walk(static_cast<const ExprStmtAST *>(node)->expr_, counts);
+    break;
+  case ASTKind::VarDecl:
+    walk(static_cast<const VarDeclAST *>(node)->rhs_, counts);
+    break;
+  case ASTKind::FnDecl: {
+    auto ast = static_cast<const FnDeclAST *>(node);
+    walk(ast->params_, counts);
+    walk(ast->body_, counts);
+    walk(ast->captures_, counts);
+    break;
+  }
+  case ASTKind::FnParams:
+    walk_list(static_cast<const ParamListAST *>(node)->params_, counts);
+    break;
+  case ASTKind::FnCallExpr:
+    walk_list(static_cast<const FnCallExprAST *>(node)->fn_params_, counts);
+    break;
+  case ASTKind::VarAssignExpr:
+    walk(static_cast<const VarAssignAST *>(node)->rhs_, counts);
+    break;
+  case ASTKind::TableAccess:
+    walk(static_cast<const TableAccessAST *>(node)->index_, counts);
+    break;
+  case ASTKind::ArrayAccess:
+    walk(static_cast<const ArrayAccessAST *>(node)->index_, counts);
+    break;
+  case ASTKind::ArrayMutExpr: {
+    auto ast = static_cast<const ArrayMutExprAST *>(node);
+    walk(ast->index_, counts);
+    walk(ast->rhs_, counts);
+    break;
+  }
+  case ASTKind::BinaryExpr: {
+    auto ast = static_cast<const BinaryExprAST *>(node);
+    walk(ast->lhs_, counts);
+    walk(ast->rhs_, counts);
+    break;
+  }
+  case ASTKind::UnaryExpr:
+    walk(static_cast<const UnaryExprAST *>(node)->rhs_, counts);
+    break;
+  default:
+    break;
+  }
+}
+
+void walk_list(ASTList list, Counts &counts) {
+  for (const ASTNode *node : list) {
+    walk(node, counts);
+  }
+}
+
+// Runs walk iterations times and returns the best time, along with what
+// the last walk counted.
+template <typename WalkFn>
+double best_of(size_t iterations, WalkFn walk_once, Counts &counts) {
+  double best = 1e30;
+  for (size_t i = 0; i < iterations; i++) {
+    counts = Counts();
+    auto start = std::chrono::steady_clock::now();
+    walk_once(counts);
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    best = std::min(best, elapsed.count());
+  }
+  return best;
+}
+} // namespace
+
+int main(int argc, char *argv[]) {
+  if (argc < 2) {
+    std::cerr << "usage: flat_ast_bench <file.sif> [iterations]\n";
+    return 1;
+  }
+  size_t iterations = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 20;
+
+  StringInterner interner;
+  ASTContext ctx;
+  Parser parser = Parser(std::make_unique<Lexer>(std::string(argv[1]),
+                                                 interner),
+                         std::make_unique<SymbolTable>(), ctx);
+  auto result = parser.Parse();
+  if (result.contains_error_) {
+    for (ParseError &err : result.errors_) {
+      err.Emit();
+    }
+    return 1;
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  FlatAST flat = FlatAST::FromTree(result.ast_);
+  std::chrono::duration<double> flatten =
+      std::chrono::steady_clock::now() - start;
+
+  ASTContext rebuilt_ctx;
+  FlatAST again = FlatAST::FromTree(flat.ToTree(rebuilt_ctx));
+  if (!(again == flat)) {
+    std::cerr << "flat_ast_bench: round trip changed the tree of " << argv[1]
+              << "\n";
+    return 1;
+  }
+
+  Counts tree_counts;
+  double tree = best_of(
+      iterations, [&](Counts &counts) { walk(result.ast_, counts); },
+      tree_counts);
+  Counts flat_counts;
+  double scan = best_of(
+      iterations,
+      [&](Counts &counts) {
+        flat.Walk([&](NodeId id) { counts.visit(flat.Kind(id)); });
+      },
+      flat_counts);
+  if (tree_counts.nodes != flat_counts.nodes ||
+      tree_counts.calls != flat_counts.calls) {
+    std::cerr << "flat_ast_bench: the walks visited different nodes\n";
+    return 1;
+  }
+
+  std::cout << "nodes:             " << flat.Size() << "\n";
+  std::cout << "round trip:        ok\n";
+  std::cout << "flatten:           " << flatten.count() * 1000.0 << " ms\n";
+  std::cout << "tree walk:         " << tree * 1000.0 << " ms\n";
+  std::cout << "flat walk:         " << scan * 1000.0 << " ms\n";
+  return 0;
+}
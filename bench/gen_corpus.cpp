@@ -0,0 +1,25 @@
+// Writes a generated program to standard output, for the benchmarks that
+// read a file.
+//
+//   gen_corpus <flat|nested|chain|functions|strings> [megabytes] [seed]
+#include "corpus.h"
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+int main(int argc, char *argv[]) {
+  CorpusShape shape;
+  if (argc < 2 || !ParseCorpusShape(argv[1], shape)) {
+    std::cerr << "usage: gen_corpus <flat|nested|chain|functions|strings> "
+                 "[megabytes] [seed]\n";
+    return 1;
+  }
+
+  double mb = argc > 2 ? std::atof(argv[2]) : 1.0;
+  uint32_t seed =
+      argc > 3 ? static_cast<uint32_t>(std::strtoul(argv[3], nullptr, 10)) : 1;
+  std::cout << GenerateCorpus(shape, static_cast<size_t>(mb * (1 << 20)),
+                              seed);
+  return 0;
+}
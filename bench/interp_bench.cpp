@@ -0,0 +1,116 @@
+// Parses a program once and runs it with the tree-walking interpreter, or
+// with --vm compiles it once and runs the bytecode, reporting the best run
+// time. Output from print is discarded.
+//
+//   interp_bench [--vm] <file.sif> [iterations]
+#include "sif/Interpreter/interpreter.h"
+#include "sif/Parser/ast_context.h"
+#include "sif/Parser/constant_folder.h"
+#include "sif/Parser/lexer.h"
+#include "sif/Parser/parser.h"
+#include "sif/Parser/symbol_table.h"
+#include "sif/VM/compiler.h"
+#include "sif/VM/vm.h"
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <string_view>
+
+using namespace sif;
+
+namespace {
+// Runs the program iterations times and returns the best time, or a
+// negative duration on a runtime error.
+template <typename RunFn>
+std::chrono::duration<double> best_of(size_t iterations, RunFn run) {
+  std::chrono::duration<double> best = std::chrono::duration<double>::max();
+  for (size_t i = 0; i < iterations; i++) {
+    auto start = std::chrono::steady_clock::now();
+    bool ok = run();
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+
+    if (!ok) {
+      return std::chrono::duration<double>(-1);
+    }
+    if (elapsed < best) {
+      best = elapsed;
+    }
+  }
+  return best;
+}
+} // namespace
+
+int main(int argc, char *argv[]) {
+  bool use_vm = argc > 1 && std::string_view(argv[1]) == "--vm";
+  int first_arg = use_vm ? 2 : 1;
+  if (argc <= first_arg) {
+    std::cerr << "usage: interp_bench [--vm] <file.sif> [iterations]\n";
+    return 1;
+  }
+
+  size_t iterations = argc > first_arg + 1
+                          ? std::strtoul(argv[first_arg + 1], nullptr, 10)
+                          : 5;
+
+  StringInterner interner;
+  ASTContext ctx;
+  auto lexer =
+      std::make_unique<Lexer>(std::string(argv[first_arg]), interner);
+  const SourceBuffer &source = lexer->Source();
+  Parser parser =
+      Parser(std::move(lexer), std::make_unique<SymbolTable>(), ctx);
+
+  auto result = parser.Parse();
+  if (result.contains_error_) {
+    for (ParseError &err : result.errors_) {
+      err.Emit();
+    }
+    return 1;
+  }
+
+  // Fold constants as the driver does, so this times what sif would run.
+  ConstantFolder folder = ConstantFolder(ctx);
+  folder.Fold(result.ast_);
+
+  // A stream without a buffer swallows everything written to it.
+  std::ostream discard(nullptr);
+
+  std::chrono::duration<double> best;
+  if (use_vm) {
+    BytecodeProgram program;
+    Compiler compiler = Compiler(source, interner);
+    if (!compiler.Compile(result.ast_, program)) {
+      compiler.Error().value().Emit();
+      return 1;
+    }
+
+    VM vm = VM(program, source, discard);
+    best = best_of(iterations, [&]() { return vm.Run(); });
+    if (best.count() < 0) {
+      vm.Error().value().Emit();
+      return 1;
+    }
+  } else {
+    std::optional<RuntimeError> error;
+    best = best_of(iterations, [&]() {
+      Interpreter interpreter = Interpreter(source, interner, discard);
+      if (!interpreter.Run(result.ast_)) {
+        error = interpreter.Error();
+        return false;
+      }
+      return true;
+    });
+    if (best.count() < 0) {
+      error.value().Emit();
+      return 1;
+    }
+  }
+
+  std::cout << "best run time:     " << best.count() * 1000.0 << " ms\n";
+  return 0;
+}
@@ -0,0 +1,68 @@
+// Measures raw lexer throughput: lexes the given file to Eof a number of
+// times and reports tokens/sec and MB/s for the fastest run. Given a thread
+// count, the file is lexed in parallel chunks with Lexer::LexAll instead.
+//
+//   lex_bench <file.sif> [iterations] [threads]
+#include "sif/Parser/lexer.h"
+#include "sif/Parser/token.h"
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <sys/stat.h>
+
+using namespace sif;
+
+int main(int argc, char *argv[]) {
+  if (argc < 2) {
+    std::cerr << "usage: lex_bench <file.sif> [iterations] [threads]\n";
+    return 1;
+  }
+
+  std::string filename = argv[1];
+  int iterations = argc > 2 ? std::atoi(argv[2]) : 5;
+  size_t threads = argc > 3 ? std::strtoul(argv[3], nullptr, 10) : 0;
+  std::unique_ptr<WorkPool> pool;
+  if (threads != 0) {
+    pool = std::make_unique<WorkPool>(threads);
+  }
+
+  struct stat st;
+  if (stat(filename.c_str(), &st) != 0) {
+    std::cerr << "lex_bench: cannot stat " << filename << "\n";
+    return 1;
+  }
+  double mb = static_cast<double>(st.st_size) / (1024.0 * 1024.0);
+
+  size_t tokens = 0;
+  double best = 0.0;
+  for (int i = 0; i < iterations; i++) {
+    auto start = std::chrono::steady_clock::now();
+
+    StringInterner interner;
+    Lexer lexer = Lexer(filename, interner);
+    size_t count = 0;
+    if (pool != nullptr) {
+      count = lexer.LexAll(*pool).size() - 1;
+    } else {
+      while (lexer.Lex().GetKind() != TokenKind::Eof) {
+        count++;
+      }
+    }
+
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    if (i == 0 || elapsed.count() < best) {
+      best = elapsed.count();
+    }
+    tokens = count;
+  }
+
+  std::cout << "file:       " << filename << " (" << mb << " MB)\n";
+  std::cout << "tokens:     " << tokens << "\n";
+  std::cout << "best time:  " << best * 1000.0 << " ms\n";
+  std::cout << "tokens/sec: " << static_cast<double>(tokens) / best << "\n";
+  std::cout << "MB/s:       " << mb / best << "\n";
+  return 0;
+}
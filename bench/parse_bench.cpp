@@ -0,0 +1,81 @@
+// Parses a file and reports how many heap allocations the parser makes per
+// token, along with parse time. Allocations are counted by replacing the
+// global operator new; the AST itself comes from an ASTContext, so its slabs
+// show up as a handful of large allocations rather than one per node.
+//
+//   parse_bench <file.sif>
+#include "sif/Parser/ast_context.h"
+#include "sif/Parser/lexer.h"
+#include "sif/Parser/parser.h"
+#include "sif/Parser/symbol_table.h"
+#include "sif/Parser/token.h"
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <string>
+
+using namespace sif;
+
+static size_t alloc_count = 0;
+
+void *operator new(size_t size) {
+  void *ptr = std::malloc(size == 0 ? 1 : size);
+  if (ptr == nullptr) {
+    throw std::bad_alloc();
+  }
+  alloc_count++;
+  return ptr;
+}
+
+void operator delete(void *ptr) noexcept { std::free(ptr); }
+
+void operator delete(void *ptr, size_t) noexcept { operator delete(ptr); }
+
+static size_t count_tokens(const std::string &filename) {
+  StringInterner interner;
+  Lexer lexer = Lexer(filename, interner);
+  size_t count = 0;
+  while (lexer.Lex().GetKind() != TokenKind::Eof) {
+    count++;
+  }
+  return count;
+}
+
+int main(int argc, char *argv[]) {
+  if (argc < 2) {
+    std::cerr << "usage: parse_bench <file.sif>\n";
+    return 1;
+  }
+
+  std::string filename = std::string(argv[1]);
+  size_t tokens = count_tokens(filename);
+
+  StringInterner interner;
+  ASTContext ctx;
+  Parser parser = Parser(std::make_unique<Lexer>(filename, interner),
+                         std::make_unique<SymbolTable>(), ctx);
+
+  size_t allocs_before = alloc_count;
+  auto start = std::chrono::steady_clock::now();
+  auto result = parser.Parse();
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  size_t allocs = alloc_count - allocs_before;
+
+  if (result.contains_error_) {
+    std::cerr << "parse_bench: " << result.errors_.size()
+              << " parse errors\n";
+  }
+
+  double count = static_cast<double>(tokens);
+  std::cout << "tokens:            " << tokens << "\n";
+  std::cout << "allocations:       " << allocs << "\n";
+  std::cout << "allocs/token:      " << static_cast<double>(allocs) / count
+            << "\n";
+  std::cout << "ast bytes:         " << ctx.BytesAllocated() << "\n";
+  std::cout << "parse time:        " << elapsed.count() * 1000.0 << " ms\n";
+  std::cout << "tokens/sec:        " << count / elapsed.count() << "\n";
+  return 0;
+}
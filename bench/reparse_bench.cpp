@@ -0,0 +1,93 @@
+// Parses a file with IncrementalParser, then types a character at the start
+// of lines spread evenly through it and deletes it again, as an editor
+// would. Reports the time to parse the whole file against the time per
+// edit, and how many declarations each edit had to parse.
+//
+//   reparse_bench <file.sif> [edits]
+#include "sif/Parser/incremental_parser.h"
+#include "sif/Parser/string_interner.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace sif;
+
+static double seconds_since(std::chrono::steady_clock::time_point start) {
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  return elapsed.count();
+}
+
+int main(int argc, char *argv[]) {
+  if (argc < 2) {
+    std::cerr << "usage: reparse_bench <file.sif> [edits]\n";
+    return 1;
+  }
+
+  std::ifstream file(argv[1]);
+  if (!file) {
+    std::cerr << "reparse_bench: cannot open " << argv[1] << "\n";
+    return 1;
+  }
+  std::stringstream contents;
+  contents << file.rdbuf();
+  std::string text = contents.str();
+  size_t num_edits = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 200;
+
+  // Line starts spread evenly through the file.
+  std::vector<size_t> offsets;
+  for (size_t i = 0; i < num_edits && !text.empty(); i++) {
+    size_t offset = text.size() * i / num_edits;
+    offset = text.rfind('\n', offset);
+    offsets.push_back(offset == std::string::npos ? 0 : offset + 1);
+  }
+
+  StringInterner interner;
+  IncrementalParser parser = IncrementalParser(interner);
+  auto start = std::chrono::steady_clock::now();
+  parser.Parse(text);
+  double full = seconds_since(start);
+  size_t decls = parser.NumDecls();
+  size_t errors = parser.Errors().size();
+
+  for (const char *inserted : {" ", "x"}) {
+    double total = 0.0;
+    double worst = 0.0;
+    size_t parsed = 0;
+    for (size_t offset : offsets) {
+      start = std::chrono::steady_clock::now();
+      parser.Edit(offset, 0, inserted);
+      double insert = seconds_since(start);
+      parsed += parser.ParsedDecls();
+
+      start = std::chrono::steady_clock::now();
+      parser.Edit(offset, 1, "");
+      double remove = seconds_since(start);
+      parsed += parser.ParsedDecls();
+
+      total += insert + remove;
+      worst = std::max(worst, std::max(insert, remove));
+    }
+
+    double count = static_cast<double>(2 * offsets.size());
+    std::cout << "typing '" << inserted << "':\n";
+    std::cout << "  mean edit:       " << total / count * 1e6 << " us\n";
+    std::cout << "  worst edit:      " << worst * 1e6 << " us\n";
+    std::cout << "  decls/edit:      " << static_cast<double>(parsed) / count
+              << "\n";
+  }
+
+  if (parser.Errors().size() != errors) {
+    std::cerr << "reparse_bench: errors differ after undoing every edit\n";
+    return 1;
+  }
+
+  std::cout << "decls:             " << decls << "\n";
+  std::cout << "full parse:        " << full * 1000.0 << " ms\n";
+  return 0;
+}
@@ -0,0 +1,96 @@
+// Compares pulling tokens straight from the lexer one at a time against
+// reading them through a TokenStream at several batch sizes. Each token is
+// handed to an out-of-line consumer standing in for parser code, so the
+// lexer is re-entered after every token unless tokens are batched. A batch
+// size of one is the stream's default, which hands tokens over unbuffered.
+//
+//   stream_bench <file.sif> [iterations]
+#include "sif/Parser/lexer.h"
+#include "sif/Parser/token.h"
+#include "sif/Parser/token_stream.h"
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+using namespace sif;
+
+static uint64_t checksum = 0;
+
+__attribute__((noinline)) static void consume(Token tkn) {
+  checksum = checksum * 31 + static_cast<uint64_t>(tkn.GetKind()) +
+             tkn.GetOffset();
+}
+
+// Returns the fastest of the given number of runs, in seconds, and the
+// token count through tokens.
+template <typename Fn>
+static double time_best(int iterations, size_t &tokens, Fn fn) {
+  double best = 0.0;
+  for (int i = 0; i < iterations; i++) {
+    auto start = std::chrono::steady_clock::now();
+    tokens = fn();
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    if (i == 0 || elapsed.count() < best) {
+      best = elapsed.count();
+    }
+  }
+  return best;
+}
+
+static void report(const std::string &name, size_t tokens, double secs) {
+  std::cout << name << ": " << secs * 1000.0 << " ms, "
+            << static_cast<double>(tokens) / secs << " tokens/sec\n";
+}
+
+int main(int argc, char *argv[]) {
+  if (argc < 2) {
+    std::cerr << "usage: stream_bench <file.sif> [iterations]\n";
+    return 1;
+  }
+
+  std::string filename = argv[1];
+  int iterations = argc > 2 ? std::atoi(argv[2]) : 5;
+  size_t tokens = 0;
+
+  double pull = time_best(iterations, tokens, [&] {
+    StringInterner interner;
+    Lexer lexer = Lexer(filename, interner);
+    size_t count = 0;
+    for (;;) {
+      Token tkn = lexer.Lex();
+      consume(tkn);
+      if (tkn.GetKind() == TokenKind::Eof) {
+        return count;
+      }
+      count++;
+    }
+  });
+  std::cout << "file:   " << filename << " (" << tokens << " tokens)\n";
+  report("pull        ", tokens, pull);
+
+  for (size_t batch_size : {1, 16, 64, 256, 1024}) {
+    double secs = time_best(iterations, tokens, [&] {
+      StringInterner interner;
+      Lexer lexer = Lexer(filename, interner);
+      TokenStream stream = TokenStream(lexer, batch_size);
+      size_t count = 0;
+      for (;;) {
+        Token tkn = stream.Next();
+        consume(tkn);
+        if (tkn.GetKind() == TokenKind::Eof) {
+          return count;
+        }
+        count++;
+      }
+    });
+    std::string name = "batch " + std::to_string(batch_size);
+    name.resize(12, ' ');
+    report(name, tokens, secs);
+  }
+
+  // Keeps the consumer from being optimized away.
+  return checksum == 1 ? 2 : 0;
+}
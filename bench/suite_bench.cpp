@@ -0,0 +1,205 @@
+// Runs the lexer, the parser and sif --check over generated programs of
+// every shape in corpus.h, and times symbol table lookups, so that changes
+// anywhere in the front end can be compared on the same footing. Every
+// figure is the best of the given number of runs.
+//
+//   suite_bench [megabytes] [iterations]
+#include "corpus.h"
+#include "sif/Driver/driver.h"
+#include "sif/Parser/ast_context.h"
+#include "sif/Parser/lexer.h"
+#include "sif/Parser/parser.h"
+#include "sif/Parser/source_buffer.h"
+#include "sif/Parser/symbol_table.h"
+#include "sif/Parser/token.h"
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+using namespace sif;
+
+// Symbol table lookups are timed in batches of this many.
+static const size_t LOOKUPS = 1 << 22;
+// Globals in the symbol table, and scopes opened over them.
+static const size_t GLOBALS = 10000;
+static const size_t SCOPES = 32;
+static const size_t LOCALS_PER_SCOPE = 8;
+
+static uint64_t checksum = 0;
+
+// Returns the fastest of the given number of runs, in seconds.
+template <typename Fn> static double time_best(size_t iterations, Fn fn) {
+  double best = 0.0;
+  for (size_t i = 0; i < iterations; i++) {
+    auto start = std::chrono::steady_clock::now();
+    fn();
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    if (i == 0 || elapsed.count() < best) {
+      best = elapsed.count();
+    }
+  }
+  return best;
+}
+
+// Lexes and parses src once, returning its tokens, and the number of parse
+// errors through errors.
+static std::vector<Token> lex_all(const std::string &src, size_t &errors) {
+  StringInterner interner;
+  ASTContext ctx;
+  auto lexer = std::make_unique<Lexer>(SourceBuffer::FromString(src), interner);
+  Parser parser =
+      Parser(std::make_unique<Lexer>(SourceBuffer::FromString(src), interner),
+             std::make_unique<SymbolTable>(), ctx);
+  errors = parser.Parse().errors_.size();
+  return lexer->LexAll();
+}
+
+static void bench_shape(CorpusShape shape, size_t bytes, size_t iterations,
+                        bool &all_parsed) {
+  std::string src = GenerateCorpus(shape, bytes);
+  double mb = static_cast<double>(src.size()) / (1 << 20);
+  size_t errors = 0;
+  size_t tokens = lex_all(src, errors).size();
+  all_parsed = all_parsed && errors == 0;
+
+  // Lexer::Lex, one token at a time as the parser calls it.
+  double lex = time_best(iterations, [&] {
+    StringInterner interner;
+    Lexer lexer = Lexer(SourceBuffer::FromString(src), interner);
+    Token tkn;
+    do {
+      tkn = lexer.Lex();
+      checksum += tkn.GetOffset();
+    } while (tkn.GetKind() != TokenKind::Eof);
+  });
+
+  // Parser::Parse, lexing as it goes, as sif does.
+  double parse = time_best(iterations, [&] {
+    StringInterner interner;
+    ASTContext ctx;
+    Parser parser = Parser(
+        std::make_unique<Lexer>(SourceBuffer::FromString(src), interner),
+        std::make_unique<SymbolTable>(), ctx);
+    checksum += parser.Parse().errors_.size();
+  });
+
+  // sif --check on the program written to a file, from reading the file
+  // to reporting its errors.
+  char path[] = "/tmp/sif_suite_XXXXXX";
+  int fd = mkstemp(path);
+  if (fd >= 0) {
+    close(fd);
+  }
+  std::ofstream(path, std::ios::binary) << src;
+  double check = time_best(iterations, [&] {
+    std::ostringstream out;
+    std::ostringstream err;
+    DriverOptions opts = DriverOptions{false, false, true, 1, StatsFormat::None};
+    Driver driver = Driver({path}, opts, out, err, std::string(), nullptr);
+    checksum += driver.run();
+  });
+  std::remove(path);
+
+  std::cout << std::left << std::setw(11) << CorpusShapeName(shape)
+            << std::right << std::fixed << std::setprecision(1)
+            << std::setw(7) << mb << std::setw(11) << tokens << std::setw(8)
+            << errors << std::setw(11) << mb / lex << std::setw(11)
+            << static_cast<double>(tokens) / lex / 1e6 << std::setw(11)
+            << mb / parse << std::setw(11) << mb / check << "\n";
+}
+
+// Times SymbolTable::Retrieve for keys bound at the given depth, or for
+// unbound keys if depth is negative, with SCOPES scopes open over GLOBALS
+// globals.
+static double bench_retrieve(SymbolTable &symtab, int depth,
+                             size_t iterations) {
+  std::mt19937 rng(7);
+  std::vector<Symbol> keys(LOOKUPS);
+  for (Symbol &key : keys) {
+    if (depth < 0) {
+      key = static_cast<Symbol>(GLOBALS + SCOPES * LOCALS_PER_SCOPE +
+                                rng() % GLOBALS);
+    } else if (depth == 0) {
+      key = static_cast<Symbol>(rng() % GLOBALS);
+    } else {
+      key = static_cast<Symbol>(GLOBALS + (depth - 1) * LOCALS_PER_SCOPE +
+                                rng() % LOCALS_PER_SCOPE);
+    }
+  }
+
+  double secs = time_best(iterations, [&] {
+    for (Symbol key : keys) {
+      const SymbolRecord *record = symtab.Retrieve(key);
+      checksum += record != nullptr ? record->scope : 1;
+    }
+  });
+  return secs / LOOKUPS * 1e9;
+}
+
+static void bench_symbols(size_t iterations) {
+  SymbolTable symtab;
+  for (size_t i = 0; i < GLOBALS; i++) {
+    symtab.Store(static_cast<Symbol>(i), SymbolKind::Var, 0, nullptr);
+  }
+  // Each scope declares its own locals and shadows some globals.
+  for (size_t scope = 0; scope < SCOPES; scope++) {
+    symtab.InitScope();
+    for (size_t i = 0; i < LOCALS_PER_SCOPE; i++) {
+      symtab.Store(
+          static_cast<Symbol>(GLOBALS + scope * LOCALS_PER_SCOPE + i),
+          SymbolKind::Var, 0, nullptr);
+      symtab.Store(static_cast<Symbol>(scope * LOCALS_PER_SCOPE + i),
+                   SymbolKind::Var, 0, nullptr);
+    }
+  }
+
+  std::cout << "\nSymbolTable::Retrieve with " << GLOBALS << " globals and "
+            << SCOPES << " scopes open, ns per lookup\n";
+  for (int depth : {0, 1, static_cast<int>(SCOPES / 2),
+                    static_cast<int>(SCOPES)}) {
+    std::cout << "  bound at depth " << std::setw(2) << depth << ": "
+              << std::setprecision(2)
+              << bench_retrieve(symtab, depth, iterations) << "\n";
+  }
+  std::cout << "  unbound:            " << bench_retrieve(symtab, -1, iterations)
+            << "\n";
+}
+
+int main(int argc, char *argv[]) {
+  double mb = argc > 1 ? std::atof(argv[1]) : 4.0;
+  size_t iterations = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 5;
+  if (mb <= 0 || iterations == 0) {
+    std::cerr << "usage: suite_bench [megabytes] [iterations]\n";
+    return 1;
+  }
+  size_t bytes = static_cast<size_t>(mb * (1 << 20));
+
+  std::cout << "shape           MB     tokens  errors   lex MB/s  lex Mtok/s"
+               " parse MB/s check MB/s\n";
+  bool all_parsed = true;
+  for (size_t i = 0; i < NUM_CORPUS_SHAPES; i++) {
+    bench_shape(static_cast<CorpusShape>(i), bytes, iterations, all_parsed);
+  }
+  bench_symbols(iterations);
+
+  // Keeps the work above from being optimized away.
+  if (checksum == 42) {
+    std::cout << "\n";
+  }
+  if (!all_parsed) {
+    std::cerr << "suite_bench: a generated program did not parse\n";
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,74 @@
+// Lexes a file into a vector of tokens and reports how much memory the
+// token stream occupies (the vector plus anything the tokens themselves
+// allocate) along with lexing throughput.
+//
+//   token_bench <file.sif>
+#include "sif/Parser/lexer.h"
+#include "sif/Parser/token.h"
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <malloc.h>
+#include <new>
+#include <string>
+#include <vector>
+
+using namespace sif;
+
+static size_t live_bytes = 0;
+static size_t alloc_count = 0;
+
+void *operator new(size_t size) {
+  void *ptr = std::malloc(size == 0 ? 1 : size);
+  if (ptr == nullptr) {
+    throw std::bad_alloc();
+  }
+  live_bytes += malloc_usable_size(ptr);
+  alloc_count++;
+  return ptr;
+}
+
+void operator delete(void *ptr) noexcept {
+  if (ptr != nullptr) {
+    live_bytes -= malloc_usable_size(ptr);
+    std::free(ptr);
+  }
+}
+
+void operator delete(void *ptr, size_t) noexcept { operator delete(ptr); }
+
+int main(int argc, char *argv[]) {
+  if (argc < 2) {
+    std::cerr << "usage: token_bench <file.sif>\n";
+    return 1;
+  }
+
+  StringInterner interner;
+  Lexer lexer = Lexer(std::string(argv[1]), interner);
+  std::vector<Token> tokens;
+
+  size_t bytes_before = live_bytes;
+  size_t allocs_before = alloc_count;
+  auto start = std::chrono::steady_clock::now();
+  for (;;) {
+    Token tkn = lexer.Lex();
+    if (tkn.GetKind() == TokenKind::Eof) {
+      break;
+    }
+    tokens.push_back(tkn);
+  }
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+
+  size_t bytes = live_bytes - bytes_before;
+  double count = static_cast<double>(tokens.size());
+  std::cout << "sizeof(Token):     " << sizeof(Token) << " bytes\n";
+  std::cout << "tokens:            " << tokens.size() << "\n";
+  std::cout << "live heap:         " << bytes / 1024 << " KB\n";
+  std::cout << "heap bytes/token:  " << static_cast<double>(bytes) / count
+            << "\n";
+  std::cout << "allocations:       " << alloc_count - allocs_before << "\n";
+  std::cout << "lex time:          " << elapsed.count() * 1000.0 << " ms\n";
+  std::cout << "tokens/sec:        " << count / elapsed.count() << "\n";
+  return 0;
+}
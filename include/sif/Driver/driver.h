@@ -1,16 +1,83 @@
 #pragma once
 
+#include "sif/Driver/stats.h"
+#include "sif/Interpreter/deadline.h"
+#include "sif/Parser/source_buffer.h"
+#include <cstddef>
+#include <iostream>
+#include <memory>
 #include <string>
+#include <vector>
 
 namespace sif {
+class ProgramCache;
+
+enum class StatsFormat { None, Text, Json };
+
+struct DriverOptions {
+  // Compile to bytecode and run that, instead of walking the AST. A
+  // program too large for the bytecode's operands is walked anyway.
+  bool use_vm;
+  // Reuse bytecode cached by an earlier run of the same source, and cache
+  // it if there is none. Implies use_vm.
+  bool use_cache;
+  // Parse every given file, and every .sif file under a given directory,
+  // without running anything, and report all of their errors.
+  bool check_only;
+  // Threads to check files, or lex a very large file, on. Zero means one
+  // per hardware thread.
+  size_t jobs;
+  // Report what the run did and how long each phase took, after the
+  // program's own diagnostics.
+  StatsFormat stats;
+  // Fail the program once this many seconds have passed since sif started
+  // on it. Zero means no limit.
+  size_t timeout_seconds;
+};
+
+// Fills in paths and opts from the arguments sif was run with, less the
+// program name. Returns false if they do not make up a valid invocation.
+bool ParseArgs(const std::vector<std::string> &args,
+               std::vector<std::string> &paths, DriverOptions &opts);
+
 class Driver {
 public:
-  Driver(std::string filename) { filename_ = filename; };
+  Driver(std::vector<std::string> paths, DriverOptions opts)
+      : Driver(paths, opts, std::cout, std::cerr, std::string(), nullptr) {}
+
+  // Runs on behalf of another process, such as a client of Server. The
+  // program's output goes to out and diagnostics to err, relative paths
+  // are taken from dir, and programs are parsed and compiled through
+  // cache, which replaces the bytecode cache.
+  Driver(std::vector<std::string> paths, DriverOptions opts, std::ostream &out,
+         std::ostream &err, std::string dir, ProgramCache *cache)
+      : out_(out), err_(err) {
+    paths_ = paths;
+    opts_ = opts;
+    dir_ = dir;
+    cache_ = cache;
+  };
   ~Driver(){};
 
-  void run();
+  int run();
 
 private:
-  std::string filename_;
+  int run_file(const std::string &filename);
+  int run_cached(std::unique_ptr<SourceBuffer> file, PhaseTimer &timer);
+  int check_files();
+  std::string resolve(const std::string &path) const;
+  // Where to count and time the run, or nullptr if nobody asked.
+  Stats *stats() {
+    return opts_.stats == StatsFormat::None ? nullptr : &stats_;
+  }
+
+  std::vector<std::string> paths_;
+  DriverOptions opts_;
+  std::ostream &out_;
+  std::ostream &err_;
+  std::string dir_;
+  ProgramCache *cache_;
+  Stats stats_;
+  Deadline deadline_;
 };
 } // namespace sif
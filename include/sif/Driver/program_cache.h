@@ -0,0 +1,95 @@
+#pragma once
+
+#include "sif/Parser/ast.h"
+#include "sif/Parser/ast_context.h"
+#include "sif/Parser/parse_error.h"
+#include "sif/Parser/parser.h"
+#include "sif/Parser/source_buffer.h"
+#include "sif/Parser/string_interner.h"
+#include "sif/VM/bytecode.h"
+#include "sif/VM/compile_error.h"
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+namespace sif {
+// A parsed and folded program, shared by everything that asks for the same
+// source text. Once built it is only read, apart from being compiled to
+// bytecode the first time that is asked for, so any number of threads can
+// run it at once.
+class CachedProgram {
+public:
+  CachedProgram(std::unique_ptr<SourceBuffer> source);
+  ~CachedProgram() {}
+
+  CachedProgram(const CachedProgram &) = delete;
+  CachedProgram &operator=(const CachedProgram &) = delete;
+
+  const SourceBuffer &Source() const { return parser_->GetLexer().Source(); }
+  // Interning again a string the program already holds only reads the
+  // interner, which is all that running the program does.
+  StringInterner &Interner() { return interner_; }
+
+  // Empty if the source parsed.
+  const std::vector<ParseError> &Errors() const { return errors_; }
+  // Null if the source did not parse.
+  const ProgramAST *Program() const { return program_; }
+
+  // Compiles the program on first use. Returns nullptr if it does not
+  // compile, with the reason in CompileErr().
+  const BytecodeProgram *Bytecode();
+  std::optional<CompileError> CompileErr() const { return compile_error_; }
+
+  // Roughly how much memory the program holds on to.
+  size_t Bytes() const { return Source().Size() + ctx_.BytesAllocated(); }
+
+private:
+  StringInterner interner_;
+  ASTContext ctx_;
+  // Owns the source, through its lexer.
+  std::unique_ptr<Parser> parser_;
+  std::vector<ParseError> errors_;
+  ProgramAST *program_;
+
+  std::once_flag compiled_;
+  std::unique_ptr<BytecodeProgram> bytecode_;
+  std::optional<CompileError> compile_error_;
+};
+
+// Keeps the most recently used programs in memory, keyed by their source
+// text, until they hold more than max_bytes between them. Safe to use from
+// any number of threads.
+class ProgramCache {
+public:
+  ProgramCache(size_t max_bytes) {
+    bytes_ = 0;
+    max_bytes_ = max_bytes;
+  }
+  ~ProgramCache() {}
+
+  ProgramCache(const ProgramCache &) = delete;
+  ProgramCache &operator=(const ProgramCache &) = delete;
+
+  // Returns the program for source's text, parsing it if it is not cached.
+  // The program stays valid for as long as it is held, even once evicted.
+  std::shared_ptr<CachedProgram> Get(std::unique_ptr<SourceBuffer> source);
+
+private:
+  struct Entry {
+    uint64_t hash;
+    std::shared_ptr<CachedProgram> program;
+  };
+
+  std::mutex mu_;
+  // Most recently used first.
+  std::list<Entry> entries_;
+  std::unordered_map<uint64_t, std::list<Entry>::iterator> by_hash_;
+  size_t bytes_;
+  size_t max_bytes_;
+};
+} // namespace sif
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "sif/Driver/program_cache.h"
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace sif {
+// Runs sif on behalf of other processes from one long-lived process, so
+// that they do not pay for starting sif each time, and programs it has
+// seen before are not parsed again.
+//
+// Requests arrive on a Unix domain socket, one per connection, and are
+// served concurrently by a fixed set of threads, each of which accepts
+// and serves connections in turn. A client sends its working directory
+// and then the arguments of an ordinary sif invocation, each followed by
+// a NUL byte, and closes its end for writing. The reply is a line
+//
+//   <exit status> <output bytes> <diagnostic bytes>
+//
+// followed by the program's output and then its diagnostics.
+//
+// A client that stalls while sending its request or reading the reply is
+// dropped after IO_TIMEOUT_SECONDS, and a program's output and diagnostics
+// are each cut off after MAX_OUTPUT_BYTES, which makes the request fail.
+// A program fails once it has run for RUN_TIMEOUT_SECONDS, or less if the
+// request asks for a shorter --timeout, so that every request frees its
+// thread in bounded time.
+class Server {
+public:
+  // A server of num_threads threads, or one per hardware thread if zero.
+  Server(std::string socket_path, size_t num_threads);
+  ~Server() {}
+
+  Server(const Server &) = delete;
+  Server &operator=(const Server &) = delete;
+
+  // Serves requests until the process exits. Returns only if the socket
+  // could not be set up.
+  int Run();
+
+private:
+  // Programs are kept until they hold this much memory between them.
+  static const size_t CACHE_BYTES = 256 << 20;
+  // Longest request read, which is far more than any argument list.
+  static const size_t MAX_REQUEST_BYTES = 1 << 20;
+  // Most output, and most diagnostics, kept for a reply.
+  static const size_t MAX_OUTPUT_BYTES = 64 << 20;
+  // Longest wait for a client to send or accept more of a request or reply.
+  static const int IO_TIMEOUT_SECONDS = 10;
+  // Longest a program may run for a request.
+  static const size_t RUN_TIMEOUT_SECONDS = 30;
+
+  void serve(int listen_fd);
+  void handle(int fd);
+
+  std::string socket_path_;
+  size_t num_threads_;
+  ProgramCache cache_;
+};
+
+// Sends args as a request from the current directory to the server
+// listening at socket_path, writes the reply's output and diagnostics to
+// std::cout and std::cerr, and returns its exit status.
+int SendRequest(const std::string &socket_path,
+                const std::vector<std::string> &args);
+} // namespace sif
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "sif/Parser/ast.h"
+#include "sif/Parser/ast_context.h"
+#include "sif/Parser/lexer.h"
+#include "sif/Parser/source_buffer.h"
+#include "sif/Parser/symbol_table.h"
+#include "sif/Parser/token.h"
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+namespace sif {
+enum class Phase { Read, Lex, Parse, Fold, Compile, Run };
+
+const size_t NUM_PHASES = static_cast<size_t>(Phase::Run) + 1;
+
+// What a run of sif did and how long each part took, as reported by
+// sif --stats.
+//
+// Counts are gathered from the lexers, AST contexts and symbol tables that
+// did the work, once they are done, with Add. They are zero in a build
+// with the counters compiled out (see sif/Support/counters.h), which
+// COUNTERS_ENABLED says. Phase times come from PhaseTimer. When several
+// files are checked, everything is summed over them, so with more than one
+// thread the phase times add up to more than the wall time.
+struct Stats {
+  Stats();
+
+  void Add(const SourceBuffer &source);
+  void Add(const Lexer &lexer);
+  void Add(const ASTContext &ctx);
+  void Add(const SymbolTable &symtab);
+  // Adds in everything other has counted and timed.
+  void Add(const Stats &other);
+
+  // Records the process's peak RSS so far.
+  void SamplePeakRss();
+
+  void PrintText(std::ostream &out) const;
+  void PrintJson(std::ostream &out) const;
+
+  uint64_t bytes_read;
+  std::array<uint64_t, NUM_TOKEN_KINDS> tokens;
+  std::array<uint64_t, NUM_AST_KINDS> nodes;
+  // Indexed by the scope level lookups were made at.
+  std::vector<SymbolTable::LookupCount> lookups;
+  std::array<double, NUM_PHASES> phase_seconds;
+  double wall_seconds;
+  uint64_t peak_rss_bytes;
+};
+
+// Adds the time from its construction to its destruction to a phase of
+// stats, if there is one. Start moves on to the next phase, so a timer can
+// follow a function through its phases however it returns.
+class PhaseTimer {
+public:
+  PhaseTimer(Stats *stats, Phase phase);
+  ~PhaseTimer() { stop(); }
+
+  PhaseTimer(const PhaseTimer &) = delete;
+  PhaseTimer &operator=(const PhaseTimer &) = delete;
+
+  void Start(Phase phase);
+
+private:
+  void stop();
+
+  Stats *stats_;
+  Phase phase_;
+  std::chrono::steady_clock::time_point start_;
+};
+} // namespace sif
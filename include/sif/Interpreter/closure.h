@@ -0,0 +1,69 @@
+#pragma once
+
+#include "sif/Interpreter/value.h"
+#include "sif/Parser/ast.h"
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+namespace sif {
+// A variable captured by one or more closures. loc points at wherever the
+// variable lives now: a register of the VM function that declared it while
+// that function is still running, and otherwise value, which everything
+// that captured the variable shares.
+struct Upvalue {
+  Value *loc;
+  Value value;
+  // The register loc points at while it points at one, as an index into
+  // the VM's register stack.
+  size_t slot;
+};
+
+// A function value along with the variables it captured from the code
+// around it. The tree walker makes closures of a declaration, whose
+// captures_ name the upvalues in order, and the VM of a proto.
+struct Closure {
+  const FnDeclAST *fn;
+  uint32_t proto;
+  std::vector<Upvalue *> upvals;
+};
+
+// Owns the closures and upvalues made while a program runs. As with the
+// string arena, nothing is freed until the arena is destroyed, so values
+// can point at them without owning them.
+class ClosureArena {
+public:
+  ClosureArena() {}
+  ~ClosureArena() {}
+
+  ClosureArena(const ClosureArena &) = delete;
+  ClosureArena &operator=(const ClosureArena &) = delete;
+
+  // An upvalue that already holds its own value.
+  Upvalue *NewUpvalue(Value val) {
+    upvals_.push_back(Upvalue{nullptr, val, 0});
+    Upvalue *upval = &upvals_.back();
+    upval->loc = &upval->value;
+    return upval;
+  }
+
+  // An upvalue still living in register slot of the VM, at loc.
+  Upvalue *NewOpenUpvalue(Value *loc, size_t slot) {
+    upvals_.push_back(Upvalue{loc, Value(), slot});
+    return &upvals_.back();
+  }
+
+  Closure *NewClosure(const FnDeclAST *fn, uint32_t proto,
+                      size_t num_upvals) {
+    closures_.push_back(
+        Closure{fn, proto, std::vector<Upvalue *>(num_upvals, nullptr)});
+    return &closures_.back();
+  }
+
+private:
+  // A deque never moves what it holds, so the pointers stay valid.
+  std::deque<Upvalue> upvals_;
+  std::deque<Closure> closures_;
+};
+} // namespace sif
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+namespace sif {
+// A point in time after which a run is stopped, if one is set. Both
+// engines check it on every loop iteration and call, and fail with
+// TimedOut once it has passed. Reading the clock costs far more than the
+// work between two checks, so only one check in CHECK_EVERY reads it.
+class Deadline {
+public:
+  typedef std::chrono::steady_clock Clock;
+
+  Deadline() {
+    is_set_ = false;
+    countdown_ = CHECK_EVERY;
+  }
+
+  void Set(Clock::time_point at) {
+    at_ = at;
+    is_set_ = true;
+  }
+
+  // Returns false once the deadline has passed.
+  bool Check() {
+    if (--countdown_ != 0) {
+      return true;
+    }
+    countdown_ = CHECK_EVERY;
+    return !is_set_ || Clock::now() < at_;
+  }
+
+private:
+  static const uint32_t CHECK_EVERY = 1 << 12;
+
+  Clock::time_point at_;
+  bool is_set_;
+  uint32_t countdown_;
+};
+} // namespace sif
@@ -0,0 +1,94 @@
+#pragma once
+
+#include "sif/Interpreter/closure.h"
+#include "sif/Interpreter/value.h"
+#include "sif/Parser/string_interner.h"
+#include <cstdint>
+#include <vector>
+
+namespace sif {
+// Variable storage for the interpreter, laid out like the parser's
+// SymbolTable: one open addressed slot per symbol pointing at its newest
+// binding, a stack of bindings that each remember what they shadow, and
+// scope marks so leaving a scope pops exactly the bindings it made.
+//
+// Function calls push a frame as well as a scope. A lookup only sees the
+// current frame's locals and the globals, so a callee cannot read its
+// caller's locals. A function reaches the locals of the code around it
+// through the upvalues of its closure instead, and a local that has been
+// captured lives in its upvalue rather than in its binding.
+class Environment {
+public:
+  Environment();
+  ~Environment() {}
+
+  Environment(const Environment &) = delete;
+  Environment &operator=(const Environment &) = delete;
+
+  void PushScope() {
+    scope_marks_.push_back(static_cast<uint32_t>(bindings_.size()));
+  }
+
+  void PopScope();
+
+  void PushFrame() {
+    frame_++;
+    PushScope();
+  }
+
+  void PopFrame() {
+    PopScope();
+    frame_--;
+  }
+
+  // Binds key in the current scope. Defining a key that is already bound
+  // in the same scope overwrites it.
+  void Define(Symbol key, Value val);
+
+  // Returns the newest binding for key among the current frame's locals,
+  // else the global one, or nullptr if there is neither. Sets is_local to
+  // which it was. A binding's pointer is invalidated by the next Define or
+  // PopScope, but a captured local's stays valid.
+  Value *Lookup(Symbol key, bool &is_local);
+
+  // Returns the upvalue of the newest binding for key among the current
+  // frame's locals, moving the local into one from arena if it is not
+  // already captured, or nullptr if there is no such local.
+  Upvalue *Capture(Symbol key, ClosureArena &arena);
+
+private:
+  static const uint32_t NO_BINDING = UINT32_MAX;
+  static const size_t INITIAL_SLOTS = 256;
+
+  struct Slot {
+    Symbol key;
+    uint32_t head;
+  };
+
+  // cell is null until the binding is captured.
+  struct Binding {
+    Value val;
+    Upvalue *cell;
+    Symbol key;
+    uint32_t shadowed;
+    uint32_t scope;
+    uint32_t frame;
+  };
+
+  static size_t hash(Symbol key) { return key * 2654435769u; }
+
+  static Value *value_of(Binding &binding) {
+    return binding.cell != nullptr ? binding.cell->loc : &binding.val;
+  }
+
+  Binding *find_local(Symbol key);
+  size_t find_slot(Symbol key) const;
+  void grow();
+
+  std::vector<Slot> slots_;
+  size_t used_slots_;
+  std::vector<Binding> bindings_;
+  std::vector<uint32_t> scope_marks_;
+  uint32_t frame_;
+};
+} // namespace sif
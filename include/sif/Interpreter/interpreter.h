@@ -0,0 +1,93 @@
+#pragma once
+
+#include "sif/Interpreter/closure.h"
+#include "sif/Interpreter/deadline.h"
+#include "sif/Interpreter/environment.h"
+#include "sif/Interpreter/runtime_error.h"
+#include "sif/Interpreter/string_arena.h"
+#include "sif/Interpreter/value.h"
+#include "sif/Parser/ast.h"
+#include "sif/Parser/source_buffer.h"
+#include "sif/Parser/string_interner.h"
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <ostream>
+#include <string_view>
+#include <vector>
+
+namespace sif {
+// Executes a parsed program by walking its AST directly. The source buffer
+// and interner must be the ones the program was parsed from, since tokens
+// only refer back into them. Output from print goes to out.
+class Interpreter {
+public:
+  Interpreter(const SourceBuffer &source, StringInterner &interner,
+              std::ostream &out);
+  ~Interpreter() {}
+
+  Interpreter(const Interpreter &) = delete;
+  Interpreter &operator=(const Interpreter &) = delete;
+
+  // Runs every top level declaration in order. Returns false if execution
+  // stopped on a runtime error, which is then available from Error().
+  bool Run(const ProgramAST *program);
+
+  std::optional<RuntimeError> Error() const { return error_; }
+
+  void SetDeadline(Deadline deadline) { deadline_ = deadline; }
+
+private:
+  // Native stack a run may use. Each call recurses through every statement
+  // and expression it is nested in, so a function with a deeply nested
+  // body can run out of stack well before MAX_CALL_DEPTH.
+  static const size_t MAX_STACK_BYTES = 4 << 20;
+
+  enum class ExecStatus { Normal, Return, Error };
+
+  ExecStatus exec(const ASTNode *node);
+  ExecStatus exec_list(ASTList stmts);
+  void exec_fn_decl(const FnDeclAST *ast);
+  ExecStatus exec_if(const IfStmtAST *ast);
+  ExecStatus exec_for(const ForStmtAST *ast);
+
+  bool eval(const ASTNode *node, Value &result);
+  bool eval_literal(const LiteralExprAST *ast, Value &result);
+  bool eval_binary(const BinaryExprAST *ast, Value &result);
+  bool eval_unary(const UnaryExprAST *ast, Value &result);
+  bool eval_assign(const VarAssignAST *ast, Value &result);
+  bool eval_call(const FnCallExprAST *ast, Value &result);
+  bool eval_std_call(const FnCallExprAST *ast, Value &result);
+  bool eval_args(ASTList args);
+
+  Value *lookup(Symbol sym);
+  Upvalue *capture(Symbol sym);
+  Upvalue *captured(Symbol sym);
+
+  bool fail(RuntimeErrorKind kind, Token tkn);
+
+  const SourceBuffer &source_;
+  StringInterner &interner_;
+  std::ostream &out_;
+  Environment env_;
+
+  // Arguments are evaluated onto this stack rather than into a fresh
+  // container per call.
+  std::vector<Value> args_;
+  Value ret_val_;
+  // Calls to sif functions currently running, and the address of the
+  // native stack where the run started.
+  size_t call_depth_;
+  uintptr_t stack_base_;
+  std::optional<RuntimeError> error_;
+  Deadline deadline_;
+  // The closure of the function running now, or null if it captured
+  // nothing.
+  const Closure *closure_;
+  ClosureArena closures_;
+
+  Symbol print_sym_;
+  Symbol range_sym_;
+  StringArena strings_;
+};
+} // namespace sif
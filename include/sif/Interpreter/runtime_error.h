@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstddef>
+#include <iostream>
+#include <string>
+
+namespace sif {
+enum class RuntimeErrorKind {
+  UndefinedSymbol,
+  TypeMismatch,
+  NotCallable,
+  WrongArgCount,
+  NotIterable,
+  StackOverflow,
+  TimedOut,
+  UnsupportedExpr
+};
+
+// How deeply calls to sif functions may nest, on either engine, before the
+// call that would go deeper fails with StackOverflow.
+const size_t MAX_CALL_DEPTH = 5000;
+
+class RuntimeError {
+public:
+  RuntimeError(RuntimeErrorKind kind, int line, int pos) {
+    kind_ = kind;
+    line_ = line;
+    pos_ = pos;
+  };
+  ~RuntimeError() {}
+
+  RuntimeErrorKind Kind() { return kind_; }
+  int Line() { return line_; }
+  int Pos() { return pos_; }
+  void Emit() { Emit(std::cerr); }
+  void Emit(std::ostream &out) {
+    out << "sif: Runtime error - " << error_to_msg() << "\n";
+  }
+
+private:
+  std::string error_to_msg();
+
+  int line_;
+  int pos_;
+  RuntimeErrorKind kind_;
+};
+
+} // namespace sif
@@ -0,0 +1,30 @@
+#pragma once
+
+#include "sif/Interpreter/value.h"
+#include <memory>
+#include <string_view>
+#include <vector>
+
+namespace sif {
+// Owns the bytes of strings built while a program runs. Nothing is freed
+// until the arena is destroyed, which is what lets a Value point at these
+// bytes without owning them.
+class StringArena {
+public:
+  StringArena() {
+    chunk_curr_ = nullptr;
+    chunk_end_ = nullptr;
+  }
+  ~StringArena() {}
+
+  StringArena(const StringArena &) = delete;
+  StringArena &operator=(const StringArena &) = delete;
+
+  Value Concat(std::string_view lhs, std::string_view rhs);
+
+private:
+  std::vector<std::unique_ptr<char[]>> chunks_;
+  char *chunk_curr_;
+  char *chunk_end_;
+};
+} // namespace sif
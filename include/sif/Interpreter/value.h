@@ -0,0 +1,142 @@
+#pragma once
+
+#include "sif/Parser/ast.h"
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string_view>
+
+namespace sif {
+struct Closure;
+
+// Fn values are made by the tree walker and refer to the declaration, while
+// CompiledFn values are made by the VM and refer to a compiled proto. Either
+// engine makes a Closure instead for a function that captures variables.
+enum class ValueKind : uint8_t {
+  Nil,
+  Bool,
+  Number,
+  String,
+  Fn,
+  CompiledFn,
+  Closure,
+  Range
+};
+
+// A runtime value. Everything but the bytes of a long string is stored in
+// the value itself, so copying one never allocates: strings of up to
+// SMALL_STRING_MAX bytes are kept inline, and longer ones point at bytes
+// owned elsewhere (the interner for literals, the interpreter's string
+// arena for strings built while running).
+class Value {
+public:
+  static const size_t SMALL_STRING_MAX = 16;
+
+  Value() {
+    kind_ = ValueKind::Nil;
+    small_len_ = 0;
+    num_ = 0;
+  }
+
+  static Value FromBool(bool b) {
+    Value val;
+    val.kind_ = ValueKind::Bool;
+    val.bool_ = b;
+    return val;
+  }
+
+  static Value FromNumber(double num) {
+    Value val;
+    val.kind_ = ValueKind::Number;
+    val.num_ = num;
+    return val;
+  }
+
+  // Long strings are not copied, so str must outlive the value.
+  static Value FromString(std::string_view str);
+
+  static Value FromFn(const FnDeclAST *fn) {
+    Value val;
+    val.kind_ = ValueKind::Fn;
+    val.fn_ = fn;
+    return val;
+  }
+
+  static Value FromProto(uint32_t proto) {
+    Value val;
+    val.kind_ = ValueKind::CompiledFn;
+    val.proto_ = proto;
+    return val;
+  }
+
+  static Value FromClosure(const Closure *closure) {
+    Value val;
+    val.kind_ = ValueKind::Closure;
+    val.closure_ = closure;
+    return val;
+  }
+
+  // The half-open range [start, end), stepping by one.
+  static Value FromRange(double start, double end) {
+    Value val;
+    val.kind_ = ValueKind::Range;
+    val.range_ = RangeBounds{start, end};
+    return val;
+  }
+
+  ValueKind Kind() const { return kind_; }
+  bool GetBool() const { return bool_; }
+  double GetNumber() const { return num_; }
+  const FnDeclAST *GetFn() const { return fn_; }
+  uint32_t GetProto() const { return proto_; }
+  const Closure *GetClosure() const { return closure_; }
+  double RangeStart() const { return range_.start; }
+  double RangeEnd() const { return range_.end; }
+
+  // Views of short strings point into the value itself and are only valid
+  // as long as it is.
+  std::string_view GetString() const {
+    if (small_len_ != 0 || str_.data == nullptr) {
+      return std::string_view(small_, small_len_);
+    }
+    return std::string_view(str_.data, str_.size);
+  }
+
+  // Only nil and false are falsy.
+  bool IsTruthy() const {
+    return !(kind_ == ValueKind::Nil ||
+             (kind_ == ValueKind::Bool && !bool_));
+  }
+
+  bool Equals(const Value &other) const;
+  void Print(std::ostream &out) const;
+
+private:
+  struct StringRef {
+    const char *data;
+    size_t size;
+  };
+
+  struct RangeBounds {
+    double start;
+    double end;
+  };
+
+  ValueKind kind_;
+  // Length of an inline string. Zero means the string is either empty or
+  // stored out of line in str_.
+  uint8_t small_len_;
+  union {
+    bool bool_;
+    double num_;
+    const FnDeclAST *fn_;
+    uint32_t proto_;
+    const Closure *closure_;
+    RangeBounds range_;
+    StringRef str_;
+    char small_[SMALL_STRING_MAX];
+  };
+};
+
+static_assert(sizeof(Value) == 24);
+} // namespace sif
@@ -1,14 +1,15 @@
 #pragma once
 
 #include "sif/Parser/token.h"
-#include <memory>
-#include <optional>
-#include <vector>
+#include <span>
 
 namespace sif {
 class ASTNode;
-typedef std::unique_ptr<ASTNode> ASTPtr;
-typedef std::shared_ptr<ASTNode> SharedASTPtr;
+
+// AST nodes are allocated in an ASTContext and freed all at once with it,
+// so children are plain non-owning pointers and child lists are spans of
+// pointers copied into the same arena.
+typedef std::span<ASTNode *> ASTList;
 
 enum class ASTKind {
   Program,
@@ -38,10 +39,13 @@ enum class ASTKind {
   Empty
 };
 
+// Number of ASTKind values, for tables indexed by kind.
+const size_t NUM_AST_KINDS = static_cast<size_t>(ASTKind::Empty) + 1;
+
+// Nodes are not polymorphic: use GetKind() to find the concrete type and
+// static_cast to it.
 class ASTNode {
 public:
-  virtual ~ASTNode() = default;
-
   ASTKind GetKind() const { return kind_; }
 
 protected:
@@ -50,251 +54,247 @@ protected:
 
 class ProgramAST : public ASTNode {
 public:
-  ProgramAST(std::vector<ASTPtr> blocks) {
+  ProgramAST(ASTList blocks) {
     kind_ = ASTKind::Program;
-    blocks_ = std::move(blocks);
+    blocks_ = blocks;
   }
 
-  ~ProgramAST() {}
-
-private:
-  std::vector<ASTPtr> blocks_;
+  ASTList blocks_;
 };
 
 class BlockAST : public ASTNode {
 public:
-  BlockAST(std::vector<ASTPtr> decls, size_t scope) {
+  BlockAST(ASTList decls, size_t scope) {
     kind_ = ASTKind::Block;
-    decls_ = std::move(decls);
+    decls_ = decls;
     scope_ = scope;
   }
 
-  ~BlockAST() {}
-
-  std::vector<ASTPtr> decls_;
+  ASTList decls_;
   size_t scope_;
 };
 
 class IfStmtAST : public ASTNode {
 public:
-  IfStmtAST(ASTPtr cond, ASTPtr ifs, std::vector<ASTPtr> elifs,
-            std::vector<ASTPtr> elses) {
+  IfStmtAST(ASTNode *cond, ASTNode *ifs, ASTList elifs, ASTList elses) {
     kind_ = ASTKind::IfStmt;
-    cond_expr = std::move(cond);
-    if_stmts = std::move(ifs);
-    elif_exprs = std::move(elifs);
-    else_stmts = std::move(elses);
+    cond_expr = cond;
+    if_stmts = ifs;
+    elif_exprs = elifs;
+    else_stmts = elses;
   }
 
-  ~IfStmtAST() {}
-
-  ASTPtr cond_expr;
-  ASTPtr if_stmts;
-  std::vector<ASTPtr> elif_exprs;
-  std::vector<ASTPtr> else_stmts;
+  ASTNode *cond_expr;
+  ASTNode *if_stmts;
+  ASTList elif_exprs;
+  ASTList else_stmts;
 };
 
 class ElifStmtAST : public ASTNode {
 public:
-  ElifStmtAST(ASTPtr cond_expr, ASTPtr stmts) {
+  ElifStmtAST(ASTNode *cond_expr, ASTNode *stmts) {
     kind_ = ASTKind::ElifStmt;
-    cond_expr_ = std::move(cond_expr);
-    stmts_ = std::move(stmts);
+    cond_expr_ = cond_expr;
+    stmts_ = stmts;
   }
 
-  ~ElifStmtAST() {}
-
-  ASTPtr cond_expr_;
-  ASTPtr stmts_;
+  ASTNode *cond_expr_;
+  ASTNode *stmts_;
 };
 
 class ForStmtAST : public ASTNode {
 public:
-  ForStmtAST(ASTPtr var_list, ASTPtr in_expr_list, ASTPtr stmts) {
+  ForStmtAST(ASTNode *var_list, ASTNode *in_expr_list, ASTNode *stmts) {
     kind_ = ASTKind::ForStmt;
-    var_list_ = std::move(var_list);
-    in_expr_list_ = std::move(in_expr_list);
-    stmts_ = std::move(stmts);
+    var_list_ = var_list;
+    in_expr_list_ = in_expr_list;
+    stmts_ = stmts;
   }
 
-  ~ForStmtAST() {}
-
-  ASTPtr var_list_;
-  ASTPtr in_expr_list_;
-  ASTPtr stmts_;
+  ASTNode *var_list_;
+  ASTNode *in_expr_list_;
+  ASTNode *stmts_;
 };
 
 class ReturnStmtAST : public ASTNode {
 public:
-  ReturnStmtAST(std::optional<ASTPtr> ret_expr) {
+  // ret_expr is null for a bare `return;`
+  ReturnStmtAST(ASTNode *ret_expr) {
     kind_ = ASTKind::ReturnStmt;
-    ret_expr_ = std::move(ret_expr);
+    ret_expr_ = ret_expr;
   }
 
-  ~ReturnStmtAST() {}
-
-  std::optional<ASTPtr> ret_expr_;
+  ASTNode *ret_expr_;
 };
 
 class ExprStmtAST : public ASTNode {
 public:
-  ExprStmtAST(ASTPtr expr) {
+  ExprStmtAST(ASTNode *expr) {
     kind_ = ASTKind::ExprStmt;
-    expr_ = std::move(expr);
+    expr_ = expr;
   }
 
-  ~ExprStmtAST() {}
-
-  ASTPtr expr_;
+  ASTNode *expr_;
 };
 
 class VarDeclAST : public ASTNode {
 public:
-  VarDeclAST(std::unique_ptr<Token> ident_token, bool is_global,
-             std::optional<ASTPtr> rhs) {
-    ident_token_ = std::move(ident_token);
+  // rhs is null for a declaration without an initialiser.
+  VarDeclAST(Token ident_token, bool is_global, ASTNode *rhs) {
+    kind_ = ASTKind::VarDecl;
+    ident_token_ = ident_token;
     is_global_ = is_global;
-    rhs_ = std::move(rhs);
+    rhs_ = rhs;
   }
 
-  ~VarDeclAST() {}
-
-  std::unique_ptr<Token> ident_token_;
+  Token ident_token_;
   bool is_global_;
-  std::optional<ASTPtr> rhs_;
+  ASTNode *rhs_;
 };
 
 class FnDeclAST : public ASTNode {
 public:
-  FnDeclAST(std::unique_ptr<Token> ident_token, ASTPtr params, ASTPtr body,
-            size_t scope) {
+  // captures lists, as identifiers, the variables the body uses that are
+  // declared outside the function and are not globals, each once.
+  FnDeclAST(Token ident_token, ASTNode *params, ASTNode *body,
+            ASTNode *captures, size_t scope) {
     kind_ = ASTKind::FnDecl;
-    ident_token_ = std::move(ident_token);
-    params_ = std::move(params);
-    body_ = std::move(body);
+    ident_token_ = ident_token;
+    params_ = params;
+    body_ = body;
+    captures_ = captures;
     scope_ = scope;
   }
 
-  ~FnDeclAST() {}
-
-  std::unique_ptr<Token> ident_token_;
-  ASTPtr params_;
-  ASTPtr body_;
+  Token ident_token_;
+  ASTNode *params_;
+  ASTNode *body_;
+  ASTNode *captures_;
   size_t scope_;
 };
 
 class FnCallExprAST : public ASTNode {
 public:
-  FnCallExprAST(Token fn_ident_tkn, std::vector<ASTPtr> fn_params, bool is_std)
-      : fn_ident_tkn_(TokenKind::Eof, 0, 0) {
+  FnCallExprAST(Token fn_ident_tkn, ASTList fn_params, bool is_std) {
     kind_ = ASTKind::FnCallExpr;
     fn_ident_tkn_ = fn_ident_tkn;
-    fn_params_ = std::move(fn_params);
+    fn_params_ = fn_params;
     is_std_ = is_std;
   }
 
   Token fn_ident_tkn_;
-  std::vector<ASTPtr> fn_params_;
+  ASTList fn_params_;
   bool is_std_;
 };
 
 class ParamListAST : public ASTNode {
 public:
-  ParamListAST(std::vector<ASTPtr> params) { params_ = std::move(params); }
+  ParamListAST(ASTList params) {
+    kind_ = ASTKind::FnParams;
+    params_ = params;
+  }
 
-  std::vector<ASTPtr> params_;
+  ASTList params_;
 };
 
 class VarAssignAST : public ASTNode {
 public:
-  VarAssignAST(Token ident_tkn, bool is_global, ASTPtr rhs)
-      : ident_tkn_(TokenKind::Eof, 0, 0) {
+  VarAssignAST(Token ident_tkn, bool is_global, ASTNode *rhs) {
     ident_tkn_ = ident_tkn;
     is_global_ = is_global;
-    rhs_ = std::move(rhs);
+    rhs_ = rhs;
     kind_ = ASTKind::VarAssignExpr;
   }
 
   Token ident_tkn_;
   bool is_global_;
-  ASTPtr rhs_;
+  ASTNode *rhs_;
 };
 
 class TableAccessAST : public ASTNode {
 public:
-  TableAccessAST(Token table_tkn, ASTPtr index)
-      : table_tkn_(TokenKind::Eof, 0, 0) {
+  TableAccessAST(Token table_tkn, ASTNode *index) {
     kind_ = ASTKind::TableAccess;
     table_tkn_ = table_tkn;
-    index_ = std::move(index);
+    index_ = index;
   }
 
   Token table_tkn_;
-  ASTPtr index_;
+  ASTNode *index_;
 };
 
 class ArrayAccessAST : public ASTNode {
 public:
-  ArrayAccessAST(Token array_tkn, ASTPtr index)
-      : array_tkn_(TokenKind::Eof, 0, 0) {
+  ArrayAccessAST(Token array_tkn, ASTNode *index) {
     array_tkn_ = array_tkn;
-    index_ = std::move(index);
+    index_ = index;
     kind_ = ASTKind::ArrayAccess;
   }
 
   Token array_tkn_;
-  ASTPtr index_;
+  ASTNode *index_;
 };
 
 class ArrayMutExprAST : public ASTNode {
 public:
-  ArrayMutExprAST(Token array_tkn, ASTPtr index, ASTPtr rhs)
-      : array_tkn_(TokenKind::Eof, 0, 0) {
+  ArrayMutExprAST(Token array_tkn, ASTNode *index, ASTNode *rhs) {
     array_tkn_ = array_tkn;
-    index_ = std::move(index);
-    rhs_ = std::move(rhs);
+    index_ = index;
+    rhs_ = rhs;
     kind_ = ASTKind::ArrayMutExpr;
   }
 
   Token array_tkn_;
-  ASTPtr index_;
-  ASTPtr rhs_;
+  ASTNode *index_;
+  ASTNode *rhs_;
 };
 
 class BinaryExprAST : public ASTNode {
 public:
-  BinaryExprAST(Token op_tkn, ASTPtr lhs, ASTPtr rhs)
-      : op_tkn_(TokenKind::Eof, 0, 0) {
+  BinaryExprAST(Token op_tkn, ASTNode *lhs, ASTNode *rhs) {
     op_tkn_ = op_tkn;
-    lhs_ = std::move(lhs);
-    rhs_ = std::move(rhs);
+    lhs_ = lhs;
+    rhs_ = rhs;
     kind_ = ASTKind::BinaryExpr;
   }
 
   Token op_tkn_;
-  ASTPtr lhs_;
-  ASTPtr rhs_;
+  ASTNode *lhs_;
+  ASTNode *rhs_;
 };
 
 class UnaryExprAST : public ASTNode {
 public:
-  UnaryExprAST(Token op_tkn, ASTPtr rhs) : op_tkn_(TokenKind::Eof, 0, 0) {
+  UnaryExprAST(Token op_tkn, ASTNode *rhs) {
     op_tkn_ = op_tkn;
-    rhs_ = std::move(rhs);
+    rhs_ = rhs;
     kind_ = ASTKind::UnaryExpr;
   }
 
   Token op_tkn_;
-  ASTPtr rhs_;
+  ASTNode *rhs_;
 };
 
 class LiteralExprAST : public ASTNode {
 public:
-  LiteralExprAST(Token lit_tkn) : lit_tkn_(TokenKind::Eof, 0, 0) {
+  LiteralExprAST(Token lit_tkn) {
     lit_tkn_ = lit_tkn;
+    num_ = 0;
     kind_ = ASTKind::LiteralExpr;
   }
+
+  // A number literal. The value was parsed by the lexer or produced by
+  // constant folding, and the token only locates it in the source.
+  LiteralExprAST(Token lit_tkn, double num) {
+    lit_tkn_ = lit_tkn;
+    num_ = num;
+    kind_ = ASTKind::LiteralExpr;
+  }
+
+  double GetNumber() const { return num_; }
+
   Token lit_tkn_;
+  double num_;
 };
 
 class EmptyAST : public ASTNode {
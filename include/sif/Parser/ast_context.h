@@ -0,0 +1,80 @@
+#pragma once
+
+#include "sif/Parser/ast.h"
+#include "sif/Support/counters.h"
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace sif {
+// Owns every AST node created during one parse. Nodes are bump allocated
+// out of large slabs and are never freed individually: destroying (or
+// resetting) the context releases the whole tree at once, without walking
+// it. Pointers handed out by the context are valid until then.
+class ASTContext {
+public:
+  ASTContext() {
+    curr_ = nullptr;
+    end_ = nullptr;
+    next_slab_size_ = INITIAL_SLAB_SIZE;
+    allocated_ = 0;
+    node_counts_.fill(0);
+  }
+
+  ~ASTContext() { release(); }
+
+  ASTContext(const ASTContext &) = delete;
+  ASTContext &operator=(const ASTContext &) = delete;
+
+  template <typename T, typename... Args> T *Create(Args &&...args) {
+    static_assert(std::is_trivially_destructible_v<T>,
+                  "arena allocated nodes are never destroyed");
+    void *mem = allocate(sizeof(T), alignof(T));
+    T *node = new (mem) T(std::forward<Args>(args)...);
+    SIF_COUNT(node_counts_[static_cast<size_t>(node->GetKind())]++);
+    return node;
+  }
+
+  // Copies a child list built up during parsing into the arena.
+  ASTList CreateList(const std::vector<ASTNode *> &nodes) {
+    if (nodes.empty()) {
+      return ASTList();
+    }
+
+    void *mem =
+        allocate(nodes.size() * sizeof(ASTNode *), alignof(ASTNode *));
+    ASTNode **list = static_cast<ASTNode **>(mem);
+    std::copy(nodes.begin(), nodes.end(), list);
+    return ASTList(list, nodes.size());
+  }
+
+  // Frees every node created so far, keeping one slab around for reuse.
+  void Reset();
+
+  size_t BytesAllocated() const { return allocated_; }
+  // How many nodes of each kind have been created, including any since
+  // freed by Reset.
+  const std::array<uint64_t, NUM_AST_KINDS> &NodeCounts() const {
+    return node_counts_;
+  }
+
+private:
+  static const size_t INITIAL_SLAB_SIZE = 64 * 1024;
+  static const size_t MAX_SLAB_SIZE = 16 * 1024 * 1024;
+
+  void *allocate(size_t size, size_t align);
+  void release();
+
+  std::vector<char *> slabs_;
+  char *curr_;
+  char *end_;
+  size_t next_slab_size_;
+  size_t allocated_;
+  std::array<uint64_t, NUM_AST_KINDS> node_counts_;
+};
+} // namespace sif
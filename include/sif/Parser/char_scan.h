@@ -0,0 +1,57 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+namespace sif {
+// Character classes used by the lexer. These replace <cctype>, whose
+// functions are locale dependent and cannot be inlined into the scanner.
+enum CharClass : uint8_t {
+  CharSpace = 1 << 0,
+  CharAlpha = 1 << 1,
+  CharDigit = 1 << 2,
+};
+
+constexpr std::array<uint8_t, 256> make_char_classes() {
+  std::array<uint8_t, 256> classes = {};
+  for (int c = 0; c < 256; c++) {
+    if (c == ' ' || (c >= '\t' && c <= '\r')) {
+      classes[c] |= CharSpace;
+    }
+    if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z')) {
+      classes[c] |= CharAlpha;
+    }
+    if (c >= '0' && c <= '9') {
+      classes[c] |= CharDigit;
+    }
+  }
+  return classes;
+}
+
+inline constexpr std::array<uint8_t, 256> char_classes = make_char_classes();
+
+inline bool is_space(char c) {
+  return char_classes[static_cast<uint8_t>(c)] & CharSpace;
+}
+
+inline bool is_alpha(char c) {
+  return char_classes[static_cast<uint8_t>(c)] & CharAlpha;
+}
+
+inline bool is_digit(char c) {
+  return char_classes[static_cast<uint8_t>(c)] & CharDigit;
+}
+
+// Bulk scanning kernels. Each returns a pointer to the first character in
+// [curr, end) that does not belong to the run, or end if every character
+// does. On x86 these use SSE2 or AVX2 (picked once at startup based on the
+// running CPU) to test 16 or 32 bytes at a time. Other targets use a plain
+// scalar loop.
+const char *skip_space_run(const char *curr, const char *end);
+const char *skip_alpha_run(const char *curr, const char *end);
+
+// The run ends at a '"', '#' or '/', where a string or a comment may start,
+// and for skip_code_line_run also at a newline. Never reads past end.
+const char *skip_code_run(const char *curr, const char *end);
+const char *skip_code_line_run(const char *curr, const char *end);
+} // namespace sif
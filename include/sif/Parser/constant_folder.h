@@ -0,0 +1,42 @@
+#pragma once
+
+#include "sif/Parser/ast.h"
+#include "sif/Parser/ast_context.h"
+#include <cstddef>
+
+namespace sif {
+// Simplifies a parsed program in place before it is run.
+//
+// Arithmetic, comparisons and boolean operators on literals are replaced
+// by a single literal. Identities such as x * 1, x + 0 and true && x are
+// removed too, but only where that cannot change what the program does:
+// since variables are untyped, x must be known to produce a number (or a
+// bool) for the identity to hold, and an operand that may have side
+// effects is never dropped.
+//
+// New nodes are allocated in ctx.
+class ConstantFolder {
+public:
+  ConstantFolder(ASTContext &ctx) : ctx_(ctx) { folded_ = 0; }
+  ~ConstantFolder() {}
+
+  void Fold(ProgramAST *program);
+
+  // The number of operators removed so far.
+  size_t Folded() const { return folded_; }
+
+private:
+  ASTNode *fold(ASTNode *node);
+  void fold_list(ASTList list);
+  ASTNode *fold_binary(BinaryExprAST *ast);
+  ASTNode *fold_logical(BinaryExprAST *ast);
+  ASTNode *fold_identity(BinaryExprAST *ast);
+  ASTNode *fold_unary(UnaryExprAST *ast);
+
+  ASTNode *make_number(Token at, double num);
+  ASTNode *make_bool(Token at, bool b);
+
+  ASTContext &ctx_;
+  size_t folded_;
+};
+} // namespace sif
@@ -0,0 +1,84 @@
+#pragma once
+
+#include "sif/Parser/ast.h"
+#include "sif/Parser/ast_context.h"
+#include "sif/Parser/token.h"
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace sif {
+typedef uint32_t NodeId;
+
+// A struct-of-arrays copy of an AST. Nodes are numbered in pre-order, so
+// node 0 is the root, the descendants of a node follow it directly, and a
+// walk over the whole tree is a linear scan of a few flat arrays rather than
+// a chase through pointers.
+//
+// Every node has a kind, a token (the operator, identifier or literal it was
+// built from, or a default Token if it has none), a small integer payload
+// and a range of children in a side array. The payload is the scope level
+// for blocks and functions, the is_global / is_std flag for declarations,
+// assignments and calls, the number of elif branches for if statements, and
+// for a number literal, one plus the index of its value in a side array of
+// numbers. A missing optional child is stored as NO_NODE.
+class FlatAST {
+public:
+  static constexpr NodeId NO_NODE = UINT32_MAX;
+
+  FlatAST() {}
+
+  static FlatAST FromTree(const ASTNode *root);
+
+  // Rebuilds the node classes from ast.h inside ctx and returns the root.
+  ASTNode *ToTree(ASTContext &ctx) const;
+
+  size_t Size() const { return kinds_.size(); }
+  NodeId Root() const { return 0; }
+
+  ASTKind Kind(NodeId id) const { return kinds_[id]; }
+  Token GetToken(NodeId id) const { return tokens_[id]; }
+  uint32_t Data(NodeId id) const { return data_[id]; }
+
+  std::span<const NodeId> Children(NodeId id) const {
+    return std::span<const NodeId>(children_.data() + child_begin_[id],
+                                   child_count_[id]);
+  }
+
+  // One past the last node in the subtree rooted at id. Jumping here from id
+  // skips the whole subtree.
+  NodeId SubtreeEnd(NodeId id) const { return subtree_end_[id]; }
+
+  // True if both hold the same nodes with the same tokens and payloads.
+  // Flattening, rebuilding and flattening again gives an equal FlatAST.
+  bool operator==(const FlatAST &other) const;
+
+  // Calls visit(id) for every node in pre-order.
+  template <typename Visitor> void Walk(Visitor &&visit) const {
+    for (NodeId id = 0; id < Size(); id++) {
+      visit(id);
+    }
+  }
+
+private:
+  NodeId add_node(ASTKind kind, Token tkn, uint32_t data, size_t children);
+  NodeId flatten(const ASTNode *node);
+  void flatten_child(NodeId parent, size_t idx, const ASTNode *child);
+  void flatten_list(NodeId parent, size_t first, ASTList list);
+
+  ASTNode *rebuild(NodeId id, ASTContext &ctx) const;
+  ASTNode *rebuild_child(NodeId id, size_t idx, ASTContext &ctx) const;
+  ASTList rebuild_list(NodeId id, size_t first, size_t count,
+                       ASTContext &ctx) const;
+
+  std::vector<ASTKind> kinds_;
+  std::vector<Token> tokens_;
+  std::vector<uint32_t> data_;
+  std::vector<uint32_t> child_begin_;
+  std::vector<uint32_t> child_count_;
+  std::vector<NodeId> subtree_end_;
+  std::vector<NodeId> children_;
+  std::vector<double> numbers_;
+};
+} // namespace sif
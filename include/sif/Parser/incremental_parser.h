@@ -0,0 +1,146 @@
+#pragma once
+
+#include "sif/Parser/ast.h"
+#include "sif/Parser/ast_context.h"
+#include "sif/Parser/parse_error.h"
+#include "sif/Parser/parser.h"
+#include "sif/Parser/source_buffer.h"
+#include "sif/Parser/string_interner.h"
+#include "sif/Parser/symbol_table.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace sif {
+// Parses a file that is edited over and over, such as one open in an
+// editor, reparsing only what each edit can have changed.
+//
+// Every top-level declaration is kept with the range of text it was parsed
+// from, its errors and the global symbols it looked up and declared. After
+// an edit, declarations that end before it are kept as they are. Parsing
+// starts again at the first one the edit reaches and stops at the first
+// declaration after it that the new parse lines up with, provided the
+// global declarations made so far are the same as before, or differ only in
+// symbols that nothing looks up. Everything from there on is kept, so apart
+// from copying the text an edit costs about as much as the declarations it
+// touches, whatever the size of the file. A declaration met on the way
+// whose tokens are unchanged, such as one followed by an edit to a comment
+// after it, is kept too.
+//
+// An edit that changes a global declaration other code uses, such as
+// renaming a function that is called, has to check every declaration after
+// it. Only those that looked the changed symbols up are parsed again.
+//
+// The result is always what parsing the whole text with Parser would give.
+class IncrementalParser {
+public:
+  IncrementalParser(StringInterner &interner);
+  ~IncrementalParser() {}
+
+  IncrementalParser(const IncrementalParser &) = delete;
+  IncrementalParser &operator=(const IncrementalParser &) = delete;
+
+  // Parses text from scratch.
+  void Parse(std::string text);
+
+  // Replaces the removed bytes at offset with inserted and reparses.
+  void Edit(size_t offset, size_t removed, std::string_view inserted);
+
+  const SourceBuffer &Source() const { return parser_->GetLexer().Source(); }
+
+  // The errors in the current text, in source order.
+  const std::vector<ParseError> &Errors() const { return errors_; }
+
+  // The program for the current text, valid until the next Parse or Edit.
+  // Its nodes are shared with later parses, so it must not be changed,
+  // such as by ConstantFolder. Token offsets in declarations that moved
+  // are brought up to date here rather than by Edit, so a caller that
+  // only wants errors never pays for it.
+  ProgramAST *Program();
+
+  size_t NumDecls() const { return decls_.size(); }
+  // How many declarations the last Parse or Edit had to parse.
+  size_t ParsedDecls() const { return parsed_decls_; }
+
+private:
+  // Garbage in the arena is collected, by parsing from scratch into an
+  // empty one, once it is at least this large and outweighs the live tree.
+  static const size_t MIN_GARBAGE_BYTES = 1 << 20;
+
+  // An error anchored to the declaration it was found in, so that it moves
+  // with it. Errors at the tokens after a declaration are anchored to its
+  // end instead of its start.
+  struct DeclError {
+    ParseErrorKind kind;
+    uint32_t offset;
+    bool after_end;
+  };
+
+  struct Decl {
+    // The declaration's first token, and the first token after it.
+    uint32_t begin;
+    uint32_t end;
+    // The end of the last token lexed while parsing it, which may be past
+    // end. The byte there was looked at too. A declaration that lexed Eof
+    // depended on the rest of the text, so this is the end of the text.
+    uint32_t lexed_end;
+    // How far the node's token offsets are behind begin.
+    int64_t shift;
+    // Null if the declaration had an error.
+    ASTNode *node;
+    size_t node_bytes;
+    // Parse errors, then malformed tokens.
+    std::vector<DeclError> errors;
+    std::vector<SymbolEvent> symbols;
+    // What each of its global declarations replaced in symbols_, with found
+    // unset if the symbol was unbound. Only valid while it is applied.
+    std::vector<SymbolEvent> shadowed;
+  };
+
+  // Where a declaration lexed from a new offset ends.
+  struct DeclSpan {
+    uint32_t end;
+    uint32_t lexed_end;
+  };
+
+  void reparse(std::unique_ptr<SourceBuffer> source, size_t offset,
+               size_t removed, size_t inserted);
+  void parse_decl(Parser &parser, std::vector<Decl> &decls);
+  void drop_decl(const Decl &decl);
+  size_t mark_stores(const std::vector<SymbolEvent> &events,
+                     std::vector<bool> &dirty) const;
+  void splice_errors(size_t first, size_t last,
+                     const std::vector<Decl> &region, uint32_t restart,
+                     int64_t delta);
+  void collect_garbage();
+  void apply_symbols(size_t count);
+
+  static bool same_tokens(const SourceBuffer &old_source, const Decl &decl,
+                          const SourceBuffer &source, uint32_t begin,
+                          StringInterner &interner, DeclSpan &span);
+  static bool symbols_match(const Decl &decl, SymbolTable &symtab,
+                            const std::vector<bool> *dirty);
+  static void replay_symbols(const Decl &decl, SymbolTable &symtab);
+
+  StringInterner &interner_;
+  ASTContext ctx_;
+  // Owns the current text, through its lexer.
+  std::unique_ptr<Parser> parser_;
+  std::vector<Decl> decls_;
+  // The global symbols declared by the first applied_ declarations. Edits
+  // tend to come close together, so this is moved from one to the next
+  // rather than built again from the start of the file.
+  std::unique_ptr<SymbolTable> symbols_;
+  size_t applied_;
+  std::vector<ParseError> errors_;
+  ProgramAST *program_;
+  // How many times the declarations in decls_ look up each symbol.
+  std::vector<uint32_t> lookups_;
+  // Bytes of nodes reachable from decls_.
+  size_t live_bytes_;
+  size_t parsed_decls_;
+};
+} // namespace sif
@@ -1,37 +1,136 @@
 #pragma once
 
+#include "sif/Parser/parse_error.h"
+#include "sif/Parser/source_buffer.h"
+#include "sif/Parser/string_interner.h"
 #include "sif/Parser/token.h"
-#include <optional>
+#include "sif/Support/counters.h"
+#include "sif/Support/work_pool.h"
+#include <array>
+#include <cstdint>
+#include <memory>
 #include <string>
-#include <unordered_map>
 #include <vector>
 
 namespace sif {
 class Lexer {
 public:
-  Lexer(std::string filename);
+  Lexer(std::string filename, StringInterner &interner);
+  // A streamed source is lexed through its window, which is refilled
+  // whenever a token might carry on past it.
+  Lexer(std::unique_ptr<SourceBuffer> source, StringInterner &interner);
+  // Lexes [begin, end) of a NUL terminated buffer owned elsewhere, such as
+  // by another lexer, with offsets counted from buf_start. Unless end is
+  // the end of the buffer, it must follow a newline that is not inside a
+  // string literal, so no token crosses it. There is no Source, so Errors
+  // cannot be used.
+  Lexer(const char *buf_start, const char *begin, const char *end,
+        StringInterner &interner);
   ~Lexer() {}
 
   Token Lex();
 
+  // Lexes up to max tokens into out, stopping after Eof, and returns how
+  // many were lexed.
+  size_t LexBatch(Token *out, size_t max);
+
+  // Carries on lexing from offset, which must be the start of a token or
+  // of the whitespace before one. Errors found at or after offset are
+  // dropped, as lexing that text again finds them again. Not for a
+  // streamed source.
+  void Seek(size_t offset);
+  // Where the next token will be lexed from.
+  size_t Offset() const {
+    return static_cast<size_t>(cur_ - buf_start_) + base_;
+  }
+
+  // Lexes the rest of the input at once and returns its tokens, ending
+  // with Eof. A large input is split into chunks that are lexed
+  // concurrently on pool; the result is exactly what calling Lex until Eof
+  // would have returned, including symbols and errors. Not for a streamed
+  // source.
+  std::vector<Token> LexAll(WorkPool &pool);
+  // Lexes the rest of the input at once on the calling thread.
+  std::vector<Token> LexAll();
+
+  const SourceBuffer &Source() const { return *source_; }
+  StringInterner &Interner() const { return interner_; }
+
+  // The value of a number literal lexed by this lexer.
+  double GetNumber(Token tkn) const;
+
+  // Malformed input found so far. The lexer still returns a token for it,
+  // so the parser carries on and can report further errors.
+  std::vector<ParseError> Errors() const;
+  // Removes and returns the errors found before offset, so that a caller
+  // reporting errors as it goes does not see them again.
+  std::vector<ParseError> TakeErrors(size_t offset);
+
+  // Nothing before offset, which is past the last token returned, will be
+  // asked about again, so a streamed source can forget the lines and
+  // number literals there. Errors there must have been taken already.
+  void Release(size_t offset);
+
+  // How many tokens of each kind have been lexed, counting a token again
+  // each time it is lexed again after a Seek.
+  const std::array<uint64_t, NUM_TOKEN_KINDS> &TokenCounts() const {
+    return token_counts_;
+  }
+
 private:
-  inline bool finished() { return curr_line_ >= buffer_.size(); }
+  // Chunks are at least this large, so that each is worth a task.
+  static const size_t MIN_CHUNK_SIZE = 1 << 20;
+
+  // Number tokens hold whole numbers below 2^31 directly. Anything else is
+  // stored in numbers_, and the token holds its index with this bit set.
+  static const uint32_t NUMBER_IN_TABLE = 1u << 31;
+
+  std::vector<Token> lex_chunk();
+  Token lex_streamed();
+  void refill(const char *keep);
+  std::vector<const char *> split_chunks(size_t num_chunks) const;
 
-  void advance();
+  // The body of Lex, kept inline so that LexBatch loops over it without a
+  // call per token.
+  inline Token lex_token();
   Token lex_str_lit();
   Token lex_num_lit();
   Token lex_ident();
-  Token consume(TokenKind ty);
-  Token consume_str_lit(std::string str, int pos, int line);
-  Token consume_num_lit(std::string num, int pos, int line);
-  std::optional<char> peek();
+  Token consume(TokenKind kind, size_t len);
+  Token make_token(TokenKind kind, const char *start, const char *end);
   void skip_whitespace();
-  void next_line();
+  void skip_line();
+  void add_error(ParseErrorKind kind, const char *at);
+
+  // Errors are located only when asked for, as locating builds the line
+  // index, which chunk lexers must not do concurrently.
+  struct PendingError {
+    ParseErrorKind kind;
+    uint32_t offset;
+  };
+
+  // Null for a chunk lexer.
+  std::unique_ptr<SourceBuffer> source_;
+  StringInterner &interner_;
+  // The source buffer is NUL terminated, so reading *cur_ is always valid
+  // and the NUL at end_ marks the end of input. A chunk lexer's end_ is the
+  // start of the next chunk instead, so Lex also compares against it.
+  const char *buf_start_;
+  const char *cur_;
+  const char *end_;
+  // The offset of buf_start_ in a streamed source, and zero otherwise.
+  size_t base_;
+  bool streaming_;
+  // Whether the stream may hold more than the window.
+  bool refillable_;
+
+  std::vector<double> numbers_;
+  std::vector<PendingError> errors_;
+  // When streaming, numbers released from the front of numbers_, and where
+  // each number still in it was lexed.
+  size_t numbers_base_;
+  std::vector<uint32_t> number_offsets_;
 
-  std::vector<std::string> buffer_;
-  std::optional<char> curr_char_;
-  std::unordered_map<std::string, TokenKind> reserved_words_;
-  int curr_pos_;
-  int curr_line_;
+  std::array<uint64_t, NUM_TOKEN_KINDS> token_counts_;
 };
 } // namespace sif
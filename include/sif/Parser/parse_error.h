@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstdint>
 #include <iostream>
 #include <string>
 
@@ -15,26 +16,39 @@ enum class ParseErrorKind {
   WrongFnParamCount,
   UndeclaredSymbol,
   UnassignedVar,
-  ExpectedIdent
+  ExpectedIdent,
+  InvalidNumber,
+  UnterminatedString,
+  UnsupportedExpression
 };
 
 class ParseError {
 public:
-  ParseError(ParseErrorKind kind, int line, int pos) {
+  ParseError(ParseErrorKind kind, uint32_t offset, int line, int pos) {
     kind_ = kind;
+    offset_ = offset;
     line_ = line;
     pos_ = pos;
   };
   ~ParseError() {}
 
-  ParseErrorKind Kind() { return kind_; }
-  int Line() { return line_; }
-  int Pos() { return pos_; }
-  void Emit() { std::cerr << "sif: Parse error - " << error_to_msg() << "\n"; }
+  ParseErrorKind Kind() const { return kind_; }
+  // The byte offset in the source that line and pos were computed from.
+  uint32_t Offset() const { return offset_; }
+  int Line() const { return line_; }
+  int Pos() const { return pos_; }
+  void Emit() { Emit(std::cerr); }
+  void Emit(std::ostream &out) {
+    out << "sif: Parse error - " << error_to_msg() << "\n";
+  }
+  void Emit(std::ostream &out, const std::string &filename) {
+    out << "sif: " << filename << ": Parse error - " << error_to_msg() << "\n";
+  }
 
 private:
   std::string error_to_msg();
 
+  uint32_t offset_;
   int line_;
   int pos_;
   ParseErrorKind kind_;
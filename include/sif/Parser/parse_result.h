@@ -1,16 +1,11 @@
 #pragma once
 
-#include "ast.h"
 #include "sif/Parser/ast.h"
 #include "sif/Parser/parse_error.h"
-#include <memory>
-#include <optional>
+#include <cstdint>
 #include <vector>
 
 namespace sif {
-class ParseCallResult;
-typedef std::unique_ptr<ParseCallResult> ParseCallResultPtr;
-
 class ParseFullResult {
 public:
   ParseFullResult() {
@@ -18,57 +13,55 @@ public:
     contains_error_ = false;
   };
 
-  ParseFullResult(ASTPtr ast, bool contains_error) {
-    ast_ = std::move(ast);
+  ParseFullResult(ProgramAST *ast, bool contains_error) {
+    ast_ = ast;
     contains_error_ = contains_error;
   }
 
   ~ParseFullResult() {}
 
-  ASTPtr ast_;
+  // Owned by the ASTContext the parser was given.
+  ProgramAST *ast_;
   bool contains_error_;
   std::vector<ParseError> errors_;
 };
 
+// The result of a single grammar rule: either a node or the index of the
+// error that stopped it. The error itself lives in the parser's error
+// list, so this stays two words wide and is returned by value without
+// touching the heap.
 class ParseCallResult {
 public:
-  // it would be better to use a builder pattern here
-  // instead of multiple constructors probably
-  ParseCallResult(ASTPtr ast) {
-    ast_ = std::move(ast);
-    err_ = nullptr;
+  static const uint32_t NO_ERROR = UINT32_MAX;
+
+  ParseCallResult(ASTNode *ast) {
+    ast_ = ast;
+    err_ = NO_ERROR;
   }
 
-  ParseCallResult(ParseError err) {
-    err_ = std::make_unique<ParseError>(err);
+  ParseCallResult(uint32_t err) {
     ast_ = nullptr;
+    err_ = err;
   }
 
-  ParseCallResult() {}
-
-  ~ParseCallResult() {}
-
-  bool has_ast() { return ast_ != nullptr; }
-  bool has_error() { return err_ != nullptr; }
-  // TODO: too much moving here? would prefer this to be a pointer
-  // instead of a move
-  ASTPtr ast() { return std::move(ast_); }
-  ParseError error() { return *err_; }
+  bool has_ast() const { return ast_ != nullptr; }
+  bool has_error() const { return err_ != NO_ERROR; }
+  ASTNode *ast() const { return ast_; }
+  uint32_t error() const { return err_; }
 
 private:
-  // TODO: why would these be pointers?
-  ASTPtr ast_;
-  std::unique_ptr<ParseError> err_;
+  ASTNode *ast_;
+  uint32_t err_;
 };
 
 class ParseResultFactory {
 public:
-  static ParseCallResultPtr from_ast(ASTPtr node) {
-    return std::make_unique<ParseCallResult>(std::move(node));
+  static ParseCallResult from_ast(ASTNode *node) {
+    return ParseCallResult(node);
   }
 
-  static ParseCallResultPtr from_err(ParseError err) {
-    return std::make_unique<ParseCallResult>(err);
+  static ParseCallResult from_err(uint32_t err) {
+    return ParseCallResult(err);
   }
 };
 } // namespace sif
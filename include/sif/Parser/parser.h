@@ -1,72 +1,114 @@
 #pragma once
 
+#include "sif/Parser/ast_context.h"
 #include "sif/Parser/lexer.h"
 #include "sif/Parser/parse_error.h"
 #include "sif/Parser/parse_result.h"
 #include "sif/Parser/symbol_table.h"
 #include "sif/Parser/token.h"
+#include "sif/Parser/token_stream.h"
+#include <cstddef>
+#include <cstdint>
 #include <memory>
 #include <optional>
+#include <vector>
 
 namespace sif {
-typedef std::optional<std::vector<std::unique_ptr<ASTNode>>>
-    OptionalBlockBindings;
+typedef std::optional<ASTList> OptionalBlockBindings;
 
 class Parser {
 public:
-  Parser(std::unique_ptr<Lexer> lexer, std::unique_ptr<SymbolTable> symtab)
-      : curr_tkn_(TokenKind::Eof, 0, 0) {
+  // The most parameters a function can declare or be called with.
+  static const size_t FN_PARAM_MAX_LEN = 64;
+
+  Parser(std::unique_ptr<Lexer> lexer, std::unique_ptr<SymbolTable> symtab,
+         ASTContext &ctx)
+      : Parser(std::move(lexer), std::vector<Token>(), std::move(symtab),
+               ctx) {}
+
+  // Parses tokens lexed up front, such as by Lexer::LexAll, which must end
+  // with Eof. The lexer is still used for its source, interner, numbers and
+  // errors. With no tokens this is the same as the constructor above.
+  Parser(std::unique_ptr<Lexer> lexer, std::vector<Token> tokens,
+         std::unique_ptr<SymbolTable> symtab, ASTContext &ctx)
+      : tokens_(*lexer, std::move(tokens)), ctx_(ctx) {
     lexer_ = std::move(lexer);
     symtab_ = std::move(symtab);
-    curr_tkn_ = lexer_->Lex();
+    consume();
     check_symtab_for_ident_ = true;
   }
 
   ~Parser() {}
   ParseFullResult Parse();
 
+  // Parse is a loop over top-level declarations. These let a caller such
+  // as IncrementalParser run that loop itself and skip over declarations
+  // it already has. Errors found by ParseDecl collect in Errors, apart from
+  // malformed tokens, which are in GetLexer().Errors().
+  ParseCallResult ParseDecl() { return decl(); }
+  bool AtEnd() const { return curr_tkn_.GetKind() == TokenKind::Eof; }
+  // Where the next declaration starts.
+  uint32_t DeclOffset() const { return curr_tkn_.GetOffset(); }
+  // Carries on from offset, which must be where a declaration starts.
+  void Seek(size_t offset) {
+    tokens_.Seek(offset);
+    consume();
+  }
+
+  const std::vector<ParseError> &Errors() const { return errors_; }
+  // Forgets the errors reported so far, once nothing refers to them.
+  void ClearErrors() { errors_.clear(); }
+  const Lexer &GetLexer() const { return *lexer_; }
+  SymbolTable &Symbols() { return *symtab_; }
+
 private:
-  const size_t FN_PARAM_MAX_LEN = 64;
-
-  ParseCallResultPtr block(OptionalBlockBindings bindings);
-
-  ParseCallResultPtr decl();
-  ParseCallResultPtr var_decl();
-  ParseCallResultPtr fn_decl();
-  ParseCallResultPtr table_decl(Token ident_tkn);
-  ParseCallResultPtr array_decl(Token ident_tkn);
-
-  ParseCallResultPtr stmt();
-  ParseCallResultPtr if_stmt();
-  ParseCallResultPtr for_stmt();
-  ParseCallResultPtr ret_stmt();
-  ParseCallResultPtr expr_stmt();
-
-  ParseCallResultPtr expr();
-  ParseCallResultPtr assign_expr();
-  ParseCallResultPtr or_expr();
-  ParseCallResultPtr and_expr();
-  ParseCallResultPtr equality_expr();
-  ParseCallResultPtr compare_expr();
-  ParseCallResultPtr add_or_sub_expr();
-  ParseCallResultPtr mul_or_div_expr();
-  ParseCallResultPtr modulo_expr();
-  ParseCallResultPtr unary_expr();
-  ParseCallResultPtr fn_call_expr();
-  ParseCallResultPtr group_expr();
-  ParseCallResultPtr literal_expr();
-
-  ParseCallResultPtr param_list(bool could_be_expr);
+  // A function whose body is being parsed, and the variables it has
+  // captured so far. Everything its body declares is at a deeper level of
+  // scope than level.
+  struct OpenFn {
+    int level;
+    std::vector<ASTNode *> captures;
+  };
+
+  ParseCallResult block(OptionalBlockBindings bindings);
+
+  ParseCallResult decl();
+  ParseCallResult var_decl();
+  ParseCallResult fn_decl();
+  ParseCallResult table_decl(Token ident_tkn);
+  ParseCallResult array_decl(Token ident_tkn);
+
+  ParseCallResult stmt();
+  ParseCallResult if_stmt();
+  ParseCallResult for_stmt();
+  ParseCallResult ret_stmt();
+  ParseCallResult expr_stmt();
+
+  ParseCallResult expr();
+  ParseCallResult assign_expr();
+  ParseCallResult binary_expr(uint8_t min_power);
+  ParseCallResult unary_expr();
+  ParseCallResult fn_call_expr();
+  ParseCallResult postfix_expr(Token ident_tkn);
+  ParseCallResult group_expr();
+  ParseCallResult literal_expr();
+
+  ParseCallResult param_list(bool could_be_expr);
 
   std::optional<Token> match_ident();
-  std::optional<ParseError> match(TokenKind kind);
+  std::optional<ParseCallResult> match(TokenKind kind);
+  bool is_declared(Token ident_tkn, bool is_callee);
+  void capture(Token ident_tkn, int scope);
   void consume();
-  ParseError add_error(ParseErrorKind kind);
+  ParseCallResult add_error(ParseErrorKind kind);
 
   std::unique_ptr<Lexer> lexer_;
+  TokenStream tokens_;
   std::unique_ptr<SymbolTable> symtab_;
+  ASTContext &ctx_;
   Token curr_tkn_;
   std::vector<ParseError> errors_;
+  std::vector<OpenFn> open_fns_;
   bool check_symtab_for_ident_;
 };
 } // namespace sif
@@ -1,30 +1,96 @@
 #pragma once
 
 #include "sif/Parser/token.h"
-#include <set>
-#include <string>
-#include <unordered_map>
+#include <string_view>
 
 namespace sif {
-inline std::unordered_map<std::string, TokenKind> get_reserved_words() {
-  std::unordered_map<std::string, TokenKind> reserved = {
-      {"if", TokenKind::If},       {"elif", TokenKind::ElIf},
-      {"else", TokenKind::Else},   {"var", TokenKind::Var},
-      {"fn", TokenKind::Fn},       {"return", TokenKind::Ret},
-      {"table", TokenKind::Table}, {"array", TokenKind::Array},
-      {"for", TokenKind::For},     {"in", TokenKind::In},
-      {"true", TokenKind::True},   {"false", TokenKind::False},
-  };
-  return reserved;
+// Returns the token kind of a reserved word, or TokenKind::Identifier if
+// the word is not reserved. Dispatching on length and then on the first
+// character means any input is compared against at most one keyword.
+constexpr TokenKind get_reserved_word(std::string_view word) {
+  switch (word.size()) {
+  case 2:
+    switch (word[0]) {
+    case 'i':
+      if (word == "if") {
+        return TokenKind::If;
+      } else if (word == "in") {
+        return TokenKind::In;
+      }
+      break;
+    case 'f':
+      if (word == "fn") {
+        return TokenKind::Fn;
+      }
+      break;
+    }
+    break;
+  case 3:
+    switch (word[0]) {
+    case 'v':
+      if (word == "var") {
+        return TokenKind::Var;
+      }
+      break;
+    case 'f':
+      if (word == "for") {
+        return TokenKind::For;
+      }
+      break;
+    }
+    break;
+  case 4:
+    switch (word[0]) {
+    case 'e':
+      if (word == "elif") {
+        return TokenKind::ElIf;
+      } else if (word == "else") {
+        return TokenKind::Else;
+      }
+      break;
+    case 't':
+      if (word == "true") {
+        return TokenKind::True;
+      }
+      break;
+    }
+    break;
+  case 5:
+    switch (word[0]) {
+    case 't':
+      if (word == "table") {
+        return TokenKind::Table;
+      }
+      break;
+    case 'a':
+      if (word == "array") {
+        return TokenKind::Array;
+      }
+      break;
+    case 'f':
+      if (word == "false") {
+        return TokenKind::False;
+      }
+      break;
+    }
+    break;
+  case 6:
+    if (word == "return") {
+      return TokenKind::Ret;
+    }
+    break;
+  }
+  return TokenKind::Identifier;
 }
 
-inline std::set<std::string> get_reserved_fns() {
-  std::set<std::string> reserved = {"print", "range"};
-  return reserved;
+constexpr bool is_std_lib_fn(std::string_view name) {
+  return name == "print" || name == "range";
 }
 
-inline bool is_std_lib_fn(std::string name) {
-  return get_reserved_fns().contains(name);
-}
+static_assert(get_reserved_word("elif") == TokenKind::ElIf);
+static_assert(get_reserved_word("else") == TokenKind::Else);
+static_assert(get_reserved_word("in") == TokenKind::In);
+static_assert(get_reserved_word("iff") == TokenKind::Identifier);
+static_assert(is_std_lib_fn("print") && !is_std_lib_fn("prints"));
 
 } // namespace sif
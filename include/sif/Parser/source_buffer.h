@@ -0,0 +1,92 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace sif {
+struct SourceLocation {
+  int line;
+  int col;
+};
+
+// Owns the raw bytes of a single source file. Files are mapped into memory
+// when possible so the lexer can walk the whole input as one contiguous
+// string_view without copying it line by line. When mapping is not possible
+// the file is read into a single owned buffer instead.
+//
+// In both cases the byte at Text().data()[Size()] is guaranteed to be NUL,
+// which the lexer uses as a sentinel instead of bounds checking every read.
+//
+// Input that is not a file, such as a pipe, can instead be read through a
+// window that the lexer moves along it. Text() is then only the window,
+// and offsets, which are 32 bits, count from the start of the stream.
+class SourceBuffer {
+public:
+  static const size_t DEFAULT_WINDOW_SIZE = 64 * 1024;
+
+  ~SourceBuffer();
+
+  SourceBuffer(const SourceBuffer &) = delete;
+  SourceBuffer &operator=(const SourceBuffer &) = delete;
+
+  // Returns nullptr if the file cannot be opened.
+  static std::unique_ptr<SourceBuffer> FromFile(const std::string &filename);
+  static std::unique_ptr<SourceBuffer> FromString(std::string contents);
+  // The text of source with the removed bytes at offset replaced by
+  // inserted. If source has built its line index, the new buffer's is
+  // patched from it rather than built again by scanning the whole text.
+  static std::unique_ptr<SourceBuffer> FromEdit(const SourceBuffer &source,
+                                                size_t offset, size_t removed,
+                                                std::string_view inserted);
+  // Reads the first window_size bytes of in, which must outlive the
+  // buffer. The rest is read by Refill.
+  static std::unique_ptr<SourceBuffer>
+  FromStream(std::istream &in, size_t window_size = DEFAULT_WINDOW_SIZE);
+
+  std::string_view Text() const { return std::string_view(data_, size_); }
+  size_t Size() const { return size_; }
+  bool IsMapped() const { return map_len_ != 0; }
+  bool IsStream() const { return stream_ != nullptr; }
+
+  // Where Text() starts in the stream. Zero unless streaming.
+  size_t Base() const { return base_; }
+
+  // Drops the text before keep_from and reads on from the end of the
+  // window, which grows if what is kept fills more than half of it, such
+  // as for a very long token. Returns false at the end of the stream,
+  // having only dropped text. Invalidates Text().
+  bool Refill(size_t keep_from);
+
+  // Nothing before offset will be located again, so the starts of the
+  // lines before the one it is on need not be kept.
+  void Release(size_t offset);
+
+  // Computes the zero based line and column of a byte offset. The line start
+  // index is built the first time this is called, so buffers that never
+  // need a location never pay for it.
+  SourceLocation Locate(size_t offset) const;
+
+private:
+  SourceBuffer() {}
+
+  void build_line_index() const;
+  void index_lines(size_t from);
+
+  const char *data_ = nullptr;
+  size_t size_ = 0;
+  size_t map_len_ = 0;
+  std::string owned_;
+  mutable std::vector<uint32_t> line_starts_;
+
+  std::istream *stream_ = nullptr;
+  size_t window_size_ = 0;
+  size_t base_ = 0;
+  // Lines released from the front of line_starts_.
+  size_t released_lines_ = 0;
+};
+} // namespace sif
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "sif/Parser/ast.h"
+#include "sif/Parser/ast_context.h"
+#include "sif/Parser/lexer.h"
+#include "sif/Parser/parse_error.h"
+#include "sif/Parser/parser.h"
+#include "sif/Parser/source_buffer.h"
+#include "sif/Parser/string_interner.h"
+#include <cstddef>
+#include <functional>
+#include <istream>
+#include <memory>
+#include <vector>
+
+namespace sif {
+// Parses a program as it arrives on a stream, such as a script piped in by
+// another process, one top-level declaration at a time.
+//
+// The text is lexed through a window of the stream, and each declaration
+// is handed over as soon as it has been parsed and then freed. However long
+// the stream is, memory is bounded by the window, which only grows to fit
+// the longest token together with any comments just before it, the largest
+// declaration, and the names and global symbols seen. Offsets, and so
+// streams, are limited to 4 GiB.
+//
+// Declarations and errors come in the same order and with the same
+// locations as parsing the whole text with Parser would give.
+class StreamParser {
+public:
+  // Called with each declaration, or nullptr if it had an error, and the
+  // errors found in it. The declaration is freed once this returns.
+  typedef std::function<void(ASTNode *decl,
+                             const std::vector<ParseError> &errors)>
+      DeclHandler;
+
+  StreamParser(std::istream &in, StringInterner &interner,
+               size_t window_size = SourceBuffer::DEFAULT_WINDOW_SIZE);
+  ~StreamParser() {}
+
+  StreamParser(const StreamParser &) = delete;
+  StreamParser &operator=(const StreamParser &) = delete;
+
+  // Parses to the end of the stream, calling handler with every
+  // declaration. Returns false if there were any errors.
+  bool Parse(const DeclHandler &handler);
+
+  Parser &GetParser() { return *parser_; }
+  const ASTContext &Context() const { return ctx_; }
+
+private:
+  ASTContext ctx_;
+  // Owned by the parser.
+  Lexer *lexer_;
+  std::unique_ptr<Parser> parser_;
+};
+} // namespace sif
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+namespace sif {
+// A Symbol is a stable id for an interned string. Two symbols from the same
+// interner are equal exactly when their strings are equal.
+typedef uint32_t Symbol;
+
+// Interns identifiers and string literals so that every distinct spelling is
+// stored once and the rest of the pipeline can compare and hash plain
+// integers. String bytes live in an arena of large chunks that is never
+// reallocated, so views returned by Lookup stay valid for the lifetime of
+// the interner.
+class StringInterner {
+public:
+  StringInterner();
+  ~StringInterner() {}
+
+  StringInterner(const StringInterner &) = delete;
+  StringInterner &operator=(const StringInterner &) = delete;
+
+  Symbol Intern(std::string_view str);
+  std::string_view Lookup(Symbol sym) const { return strings_[sym]; }
+  size_t Size() const { return strings_.size(); }
+
+private:
+  static uint32_t hash(std::string_view str);
+
+  const char *store(std::string_view str);
+  void grow();
+
+  // Open addressed table of symbol + 1, where 0 marks an empty slot. The
+  // capacity is always a power of two.
+  std::vector<uint32_t> slots_;
+  std::vector<uint32_t> hashes_;
+  std::vector<std::string_view> strings_;
+
+  std::vector<std::unique_ptr<char[]>> chunks_;
+  char *chunk_curr_;
+  char *chunk_end_;
+};
+} // namespace sif
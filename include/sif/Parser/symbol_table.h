@@ -1,42 +1,128 @@
 #pragma once
 
 #include "sif/Parser/ast.h"
-#include <memory>
-#include <optional>
-#include <unordered_map>
+#include "sif/Parser/string_interner.h"
+#include "sif/Support/counters.h"
+#include <cstdint>
+#include <vector>
 
 namespace sif {
-typedef std::unordered_map<std::string, ASTNode> Scope;
 enum class SymbolKind { Fn, Var };
 
+// What the parser needs to know about a declaration without looking at its
+// node. node is owned by the ASTContext it was created in, and is null
+// while a function's body is still being parsed.
+struct SymbolRecord {
+  SymbolKind kind;
+  uint32_t arity;
+  int scope;
+  ASTNode *node;
+};
+
+// A global lookup or binding made while a log was attached. A lookup that
+// found nothing has found set to false and the rest of the record unset.
+struct SymbolEvent {
+  Symbol key;
+  bool is_store;
+  bool found;
+  SymbolKind kind;
+  uint32_t arity;
+  ASTNode *node;
+};
+
+// Maps symbols to the record of their declaration, honouring lexical scope.
+//
+// Every symbol has one slot in an open addressed table, holding the most
+// recent binding for it. Bindings live on a stack and each one remembers
+// the binding it shadows, so lookup is a single probe and never walks the
+// enclosing scopes. Opening a scope records the height of the stack, and
+// closing it pops back to that height, restoring whatever each popped
+// binding had shadowed.
+//
+// A table can be layered over a base table, which answers lookups of the
+// symbols the table itself has no binding for. The base must outlive the
+// table and must not change while it is in use.
 class SymbolTable {
 public:
-  SymbolTable() {
-    curr_level_ = 0;
-    Scope first;
-    table_.push_back(first);
-  }
+  // Lookups made from one depth of scope, and how many of them found a
+  // binding.
+  struct LookupCount {
+    uint64_t probes;
+    uint64_t hits;
+  };
 
+  SymbolTable();
+  explicit SymbolTable(const SymbolTable *base);
   ~SymbolTable() {}
 
+  SymbolTable(const SymbolTable &) = delete;
+  SymbolTable &operator=(const SymbolTable &) = delete;
+
   void InitScope() {
-    curr_level_++;
-    Scope next;
-    table_.push_back(next);
+    scope_marks_.push_back(static_cast<uint32_t>(bindings_.size()));
   }
 
-  void CloseScope() { curr_level_--; }
-  bool constexpr IsGlobal() { return curr_level_ == 0; }
-  int Level() const { return curr_level_; }
-  bool Contains(std::string key) { return Retrieve(key).has_value(); }
-  void Store(std::string key, ASTNode ast) {
-    table_.at(curr_level_).insert({key, ast});
-  }
+  void CloseScope();
+  bool IsGlobal() const { return scope_marks_.empty(); }
+  int Level() const { return static_cast<int>(scope_marks_.size()); }
+  bool Contains(Symbol key) const { return Retrieve(key) != nullptr; }
+
+  // Binds key in the current scope, filling in the record's scope. Storing
+  // a key that is already bound in the same scope replaces that binding
+  // rather than shadowing it.
+  void Store(Symbol key, SymbolKind kind, uint32_t arity, ASTNode *node);
+
+  // Undoes the Store that bound key in the current scope, which must be the
+  // newest binding in the table.
+  void Unbind(Symbol key);
 
-  std::optional<ASTNode> Retrieve(std::string key);
+  // Returns the innermost declaration of key, or nullptr if it is unbound.
+  // The pointer is invalidated by the next Store or CloseScope.
+  const SymbolRecord *Retrieve(Symbol key) const;
+
+  // While log is set, every Store in the global scope and every Retrieve
+  // that finds a global binding or none at all is appended to it. That is
+  // all a stretch of parsing learns from outside itself, so it can be
+  // checked and replayed later without parsing again.
+  void SetLog(std::vector<SymbolEvent> *log) { log_ = log; }
+
+  // Lookups so far, indexed by the scope level they were made at. Lookups
+  // the base table answers are counted by it too.
+  const std::vector<LookupCount> &LookupCounts() const {
+    return lookup_counts_;
+  }
 
 private:
-  int curr_level_;
-  std::vector<Scope> table_;
+  static const uint32_t NO_BINDING = UINT32_MAX;
+  static const size_t INITIAL_SLOTS = 256;
+
+  struct Slot {
+    Symbol key;
+    uint32_t head;
+  };
+
+  struct Binding {
+    SymbolRecord record;
+    Symbol key;
+    uint32_t shadowed;
+  };
+
+  static size_t hash(Symbol key) { return key * 2654435769u; }
+
+  size_t find_slot(Symbol key) const;
+  void grow();
+  void count_lookup(bool hit) const;
+
+  // Open addressed table with a power of two capacity. A slot whose key is
+  // NO_BINDING is empty. Slots are never removed: once a symbol's bindings
+  // have all gone out of scope its slot keeps the key with a NO_BINDING
+  // head, ready for the next declaration.
+  std::vector<Slot> slots_;
+  size_t used_slots_;
+  std::vector<Binding> bindings_;
+  std::vector<uint32_t> scope_marks_;
+  const SymbolTable *base_;
+  std::vector<SymbolEvent> *log_;
+  mutable std::vector<LookupCount> lookup_counts_;
 };
 } // namespace sif
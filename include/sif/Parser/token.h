@@ -1,14 +1,12 @@
 #pragma once
 
-#include <memory>
-#include <optional>
+#include "sif/Parser/string_interner.h"
+#include <cstdint>
+#include <ostream>
 #include <type_traits>
 
 namespace sif {
-class Token;
-typedef std::unique_ptr<Token> TokenPtr;
-
-enum class TokenKind {
+enum class TokenKind : uint8_t {
   // Single character tokens
   LeftParen,
   RightParen,
@@ -62,6 +60,9 @@ enum class TokenKind {
   False
 };
 
+// Number of TokenKind values, for tables indexed by kind.
+const size_t NUM_TOKEN_KINDS = static_cast<size_t>(TokenKind::False) + 1;
+
 template <typename T>
 std::ostream &operator<<(
     typename std::enable_if<std::is_enum<T>::value, std::ostream>::type &stream,
@@ -69,64 +70,45 @@ std::ostream &operator<<(
   return stream << static_cast<typename std::underlying_type<T>::type>(e);
 }
 
+// A token is its kind plus the span of source text it was lexed from. It
+// does not own any text: identifiers and string literals carry the Symbol
+// their spelling was interned as, number literals carry their value as
+// encoded by the Lexer, and line/column are computed from the offset only
+// when a diagnostic needs them. Keeping tokens small and
+// trivially copyable makes it cheap to pass them by value through the
+// parser and to store them in AST nodes.
 class Token {
 public:
-  Token(TokenKind kind, int pos, int line) {
+  Token() : Token(TokenKind::Eof, 0, 0) {}
+  Token(TokenKind kind, uint32_t offset, uint32_t length) {
     kind_ = kind;
-    pos_ = pos;
-    line_ = line;
+    offset_ = offset;
+    length_ = length;
+    data_ = 0;
   }
 
-  ~Token() {}
-
   TokenKind GetKind() const { return kind_; }
-  int GetPos() const { return pos_; }
-  int GetLine() const { return line_; }
-  std::optional<std::string> GetStringLit() const { return str_lit_; }
-  std::optional<std::string> GetIdentLit() const { return ident_lit_; }
-  std::optional<std::string> GetNumberLit() const { return num_lit_; }
-  void SetPos(int pos) { pos_ = pos; }
-  void SetLine(int line) { line_ = line; }
-  void SetStringLit(std::string lit) {
-    str_lit_ = std::make_optional<std::string>(lit);
-  }
-  void SetIdentLit(std::string lit) {
-    ident_lit_ = std::make_optional<std::string>(lit);
-  }
-  void SetNumberLit(std::string lit) {
-    num_lit_ = std::make_optional<std::string>(lit);
-  }
-  std::string GetName();
-  float GetNumber();
+  uint32_t GetOffset() const { return offset_; }
+  uint32_t GetLength() const { return length_; }
+  void SetOffset(uint32_t offset) { offset_ = offset; }
+
+  // The interned spelling of an identifier, or the contents of a string
+  // literal without its quotes.
+  Symbol GetSymbol() const { return data_; }
+  void SetSymbol(Symbol sym) { data_ = sym; }
+
+  // The value of a number literal. Only the lexer that produced the token
+  // can decode it, see Lexer::GetNumber.
+  uint32_t GetNumberBits() const { return data_; }
+  void SetNumberBits(uint32_t bits) { data_ = bits; }
 
 private:
+  uint32_t offset_;
+  uint32_t length_;
+  uint32_t data_;
   TokenKind kind_;
-  int pos_;
-  int line_;
-  // TODO: this should be a class that extends an abstract class Token
-  std::optional<std::string> str_lit_;
-  std::optional<std::string> ident_lit_;
-  std::optional<std::string> num_lit_;
 };
 
-class TokenFactory {
-public:
-  static Token MakeIdentToken(int pos, int line, std::string ident) {
-    Token t = Token(TokenKind::Identifier, pos, line);
-    t.SetIdentLit(ident);
-    return t;
-  }
-
-  static Token MakeStringLiteralToken(int pos, int line, std::string literal) {
-    Token t = Token(TokenKind::StringLiteral, pos, line);
-    t.SetStringLit(literal);
-    return t;
-  }
-
-  static Token MakeNumberLiteralToken(int pos, int line, std::string literal) {
-    Token t = Token(TokenKind::StringLiteral, pos, line);
-    t.SetNumberLit(literal);
-    return t;
-  }
-};
+static_assert(std::is_trivially_copyable_v<Token>);
+static_assert(sizeof(Token) == 16);
 } // namespace sif
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "sif/Parser/lexer.h"
+#include "sif/Parser/token.h"
+#include <cstddef>
+#include <vector>
+
+namespace sif {
+// The parser's view of the token sequence, with lookahead.
+//
+// Tokens that have been looked at with Peek are held in a buffer until Next
+// returns them. With a batch size above one, tokens are also lexed that
+// many at a time into the buffer, so the lexer runs in a tight loop instead
+// of being re-entered from parser code for every token. A stream can also
+// be given tokens that were lexed up front, such as by Lexer::LexAll, and
+// then never calls the lexer.
+//
+// Once the Eof token is reached, Next and Peek keep returning it.
+class TokenStream {
+public:
+  // How far Peek can look past the next token.
+  static const size_t MAX_LOOKAHEAD = 8;
+
+  // Writing each token to the buffer and reading it back costs more than
+  // calling the lexer per token, so tokens are not batched by default. See
+  // bench/stream_bench.cpp.
+  static const size_t DEFAULT_BATCH_SIZE = 1;
+
+  // Lexes batch_size tokens at a time, which must be at least one.
+  TokenStream(Lexer &lexer, size_t batch_size = DEFAULT_BATCH_SIZE);
+  // Streams pre-lexed tokens, which must end with Eof. If there are none,
+  // tokens are lexed as usual.
+  TokenStream(Lexer &lexer, std::vector<Token> tokens);
+  ~TokenStream() {}
+
+  // Returns the next token and moves past it.
+  Token Next() {
+    if (head_ == tail_) {
+      // Nothing has been looked ahead at, so the lexer can hand the token
+      // straight over.
+      if (batch_size_ == 1 && !lexed_eof_) {
+        return lexer_.Lex();
+      }
+      refill(1);
+    }
+    return buf_[head_++];
+  }
+
+  // Returns the token n places after the next one without consuming
+  // anything. n must be less than MAX_LOOKAHEAD.
+  Token Peek(size_t n) {
+    if (head_ + n >= tail_) {
+      refill(n + 1);
+    }
+    return buf_[head_ + n];
+  }
+
+  // Drops any tokens looked ahead at and carries on lexing from offset, as
+  // Lexer::Seek. Pre-lexed tokens are dropped too.
+  void Seek(size_t offset);
+
+private:
+  // Makes at least count tokens available in the buffer.
+  void refill(size_t count);
+
+  Lexer &lexer_;
+  // Tokens [head_, tail_) have been lexed but not returned by Next. Once
+  // Eof has been lexed, the buffer is padded with copies of it.
+  std::vector<Token> buf_;
+  size_t head_;
+  size_t tail_;
+  size_t batch_size_;
+  bool lexed_eof_;
+};
+} // namespace sif
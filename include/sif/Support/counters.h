@@ -0,0 +1,19 @@
+#pragma once
+
+// The lexer, AST context and symbol table count what they do for
+// sif --stats, at the cost of an increment per token, node and lookup.
+// Defining SIF_NO_STATS, as the SIF_STATS=OFF build option does, compiles
+// the counting out and leaves every count at zero.
+#ifdef SIF_NO_STATS
+#define SIF_COUNT(stmt)
+#else
+#define SIF_COUNT(stmt) stmt
+#endif
+
+namespace sif {
+#ifdef SIF_NO_STATS
+const bool COUNTERS_ENABLED = false;
+#else
+const bool COUNTERS_ENABLED = true;
+#endif
+} // namespace sif
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace sif {
+// A fixed set of worker threads that run batches of indexed tasks.
+//
+// Each worker has its own queue of task indices. A batch is split into one
+// contiguous run per worker, which the worker takes from the back of its
+// queue; a worker that runs dry steals from the front of another's. Uneven
+// tasks, such as files of very different sizes, are thereby balanced
+// without the workers contending on a single shared queue.
+class WorkPool {
+public:
+  // A pool of num_threads workers, or one per hardware thread if zero.
+  WorkPool(size_t num_threads);
+  ~WorkPool();
+
+  WorkPool(const WorkPool &) = delete;
+  WorkPool &operator=(const WorkPool &) = delete;
+
+  // Calls fn(i) for every i in [0, count) and returns once all calls have
+  // finished. Calls run concurrently and in no particular order. Only one
+  // batch may run at a time.
+  void ForEach(size_t count, const std::function<void(size_t)> &fn);
+
+  size_t Size() const { return workers_.size(); }
+
+private:
+  struct TaskQueue {
+    std::mutex mu;
+    std::deque<size_t> tasks;
+  };
+
+  void work(size_t self);
+  bool take(size_t self, size_t &task);
+
+  std::vector<std::thread> workers_;
+  std::vector<std::unique_ptr<TaskQueue>> queues_;
+  const std::function<void(size_t)> *fn_;
+  std::atomic<size_t> pending_;
+
+  // Guards generation_ and stop_, which workers wait on between batches.
+  std::mutex mu_;
+  std::condition_variable work_cv_;
+  std::condition_variable done_cv_;
+  uint64_t generation_;
+  bool stop_;
+};
+} // namespace sif
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "sif/Interpreter/value.h"
+#include "sif/Parser/source_buffer.h"
+#include "sif/VM/opcode.h"
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <vector>
+
+namespace sif {
+// One compiled function. Parameters arrive in registers 0 to arity - 1.
+// A function with upvalues can only run as a closure.
+//
+// The code is a view, so that a program loaded from a cache file can run
+// straight out of the mapped file.
+struct FnProto {
+  std::span<const Instr> code;
+  // Source offset of the token each instruction was compiled from, used to
+  // locate runtime errors.
+  std::span<const uint32_t> offsets;
+  uint32_t arity;
+  uint32_t num_regs;
+  uint32_t num_upvals;
+};
+
+// The output of the Compiler. Proto 0 is the top level of the program.
+//
+// A program does not refer back to the AST: function values are proto
+// indices. Long string constants point into the interner the program was
+// compiled with, or into the cache file it was loaded from.
+class BytecodeProgram {
+public:
+  BytecodeProgram() { num_globals_ = 0; }
+  ~BytecodeProgram() {}
+
+  BytecodeProgram(BytecodeProgram &&) = default;
+  BytecodeProgram &operator=(BytecodeProgram &&) = default;
+
+  // Takes ownership of the code for proto idx.
+  void SetCode(uint32_t idx, std::vector<Instr> code,
+               std::vector<uint32_t> offsets) {
+    code_.push_back(std::move(code));
+    offsets_.push_back(std::move(offsets));
+    protos_[idx].code = code_.back();
+    protos_[idx].offsets = offsets_.back();
+  }
+
+  std::vector<FnProto> protos_;
+  std::vector<Value> constants_;
+  uint32_t num_globals_;
+
+  // Backing storage for code compiled in this process. Moving the outer
+  // vectors never moves the inner buffers the protos point at.
+  std::vector<std::vector<Instr>> code_;
+  std::vector<std::vector<uint32_t>> offsets_;
+  // The mapped cache file, for a program loaded from one.
+  std::unique_ptr<SourceBuffer> mapping_;
+};
+} // namespace sif
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "sif/Parser/source_buffer.h"
+#include "sif/VM/bytecode.h"
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace sif {
+// Keeps compiled programs in a directory of .sifc files, one per distinct
+// source text, so running an unchanged script again skips lexing, parsing
+// and compiling.
+//
+// A cache file is laid out so that loading it needs no parsing: the file
+// is mapped, and each proto's instructions and offsets are used in place.
+// Only the constant pool is rebuilt, as it holds pointers.
+//
+// Files are named by a hash of the source and also hold a copy of it, the
+// format version and a fingerprint of the build that wrote them, so an
+// edited script, a hash collision or a different sif simply misses.
+// Loading checks the operands of every instruction in one pass, so a
+// damaged file misses rather than indexing past the registers, tables or
+// code of the program.
+//
+// Each file also holds the source, so the directory is kept to max_bytes
+// by evicting the least recently used files whenever one is stored. A hit
+// counts as a use by setting the file's access time.
+class BytecodeCache {
+public:
+  BytecodeCache(std::string dir, uint64_t max_bytes) {
+    dir_ = dir;
+    max_bytes_ = max_bytes;
+  }
+  ~BytecodeCache() {}
+
+  // Returns false, leaving out untouched, if there is no usable cache file
+  // for this source.
+  bool Load(const SourceBuffer &source, BytecodeProgram &out) const;
+
+  // Writes the program's cache file, creating the directory if needed.
+  // Returns false if it could not be written. A failed write never leaves
+  // a partial file behind.
+  bool Store(const SourceBuffer &source, const BytecodeProgram &program) const;
+
+  static uint64_t Hash(std::string_view text);
+
+  // $SIF_CACHE_DIR, else sif/ under the user's cache directory. Empty if
+  // there is nowhere suitable.
+  static std::string DefaultDir();
+
+  // $SIF_CACHE_SIZE in bytes, else 64 MiB.
+  static uint64_t DefaultMaxBytes();
+
+private:
+  std::string path_for(uint64_t hash) const;
+  void evict(const std::string &keep) const;
+
+  std::string dir_;
+  uint64_t max_bytes_;
+};
+} // namespace sif
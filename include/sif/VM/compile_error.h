@@ -0,0 +1,47 @@
+#pragma once
+
+#include <iostream>
+#include <string>
+
+namespace sif {
+enum class CompileErrorKind {
+  UndefinedSymbol,
+  TooManyRegisters,
+  TooManyConstants,
+  TooManyGlobals,
+  TooManyFunctions,
+  TooManyUpvalues,
+  JumpTooFar,
+  UnsupportedExpr,
+  WrongArgCount
+};
+
+class CompileError {
+public:
+  CompileError(CompileErrorKind kind, int line, int pos) {
+    kind_ = kind;
+    line_ = line;
+    pos_ = pos;
+  };
+  ~CompileError() {}
+
+  CompileErrorKind Kind() { return kind_; }
+  int Line() { return line_; }
+  int Pos() { return pos_; }
+  // Whether the program is only too large for the operands of some
+  // instruction, in which case the tree walker can still run it.
+  bool IsLimit();
+  void Emit() { Emit(std::cerr); }
+  void Emit(std::ostream &out) {
+    out << "sif: Compile error - " << error_to_msg() << "\n";
+  }
+
+private:
+  std::string error_to_msg();
+
+  int line_;
+  int pos_;
+  CompileErrorKind kind_;
+};
+
+} // namespace sif
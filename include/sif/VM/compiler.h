@@ -0,0 +1,152 @@
+#pragma once
+
+#include "sif/Parser/ast.h"
+#include "sif/Parser/source_buffer.h"
+#include "sif/Parser/string_interner.h"
+#include "sif/VM/bytecode.h"
+#include "sif/VM/compile_error.h"
+#include <cstdint>
+#include <optional>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace sif {
+// Compiles a parsed program to register based bytecode for the VM.
+//
+// Variables declared at the top level of the program become globals, and
+// every other variable lives in a register of the function (or top level
+// code) that declares it.
+//
+// A function reaches the other variables it uses, which the parser lists
+// as its captures, through the upvalues of its closure. A captured variable
+// stays in its register until its scope ends, when a Close moves it out
+// into the upvalue that every closure capturing it shares.
+//
+// Calls to a function declared at the top level, and to a local function
+// that captures nothing, are resolved to its proto here so they need no
+// lookup at runtime, as long as nothing else ever binds or assigns the
+// name.
+class Compiler {
+public:
+  Compiler(const SourceBuffer &source, StringInterner &interner);
+  ~Compiler() {}
+
+  Compiler(const Compiler &) = delete;
+  Compiler &operator=(const Compiler &) = delete;
+
+  // Returns false if the program could not be compiled, in which case the
+  // reason is available from Error().
+  bool Compile(const ProgramAST *program, BytecodeProgram &out);
+
+  std::optional<CompileError> Error() const { return error_; }
+
+private:
+  static const uint32_t NO_PROTO = UINT32_MAX;
+  static const uint32_t MAX_REGS = 256;
+
+  // captured is set once a closure has captured the local, so that its
+  // scope has to close it.
+  struct Local {
+    Symbol sym;
+    uint8_t reg;
+    uint32_t proto;
+    int depth;
+    bool captured;
+  };
+
+  struct Global {
+    uint16_t slot;
+    uint32_t proto;
+  };
+
+  // Per function compilation state. Locals are in declaration order and
+  // always occupy the registers directly below free_reg. Upvalue i holds
+  // the variable named by captures[i]. The code is handed to the program
+  // once the function is complete.
+  struct FnState {
+    uint32_t proto;
+    ASTList captures;
+    std::vector<Local> locals;
+    int depth;
+    uint32_t free_reg;
+    std::vector<Instr> code;
+    std::vector<uint32_t> offsets;
+  };
+
+  enum class Storage { Local, Upvalue, Global };
+
+  // Where a name resolved to, and its register, upvalue or global slot.
+  // proto is the function the name was declared as, if calls can be bound
+  // to it.
+  struct Resolved {
+    Storage storage;
+    uint32_t index;
+    uint32_t proto;
+  };
+
+  void scan(const ASTNode *node);
+
+  bool stmt(const ASTNode *node);
+  bool block(ASTList stmts);
+  bool var_decl(const VarDeclAST *ast);
+  bool fn_decl(const FnDeclAST *ast);
+  bool if_stmt(const IfStmtAST *ast);
+  bool for_stmt(const ForStmtAST *ast);
+  bool ret_stmt(const ReturnStmtAST *ast);
+
+  bool expr(const ASTNode *node, uint8_t dst);
+  bool expr_any(const ASTNode *node, uint8_t &reg);
+  bool literal(const LiteralExprAST *ast, uint8_t dst);
+  bool load_symbol(Token tkn, uint8_t dst);
+  bool binary(const BinaryExprAST *ast, uint8_t dst);
+  bool logical(const BinaryExprAST *ast, uint8_t dst);
+  bool unary(const UnaryExprAST *ast, uint8_t dst);
+  bool assign(const VarAssignAST *ast, std::optional<uint8_t> dst);
+  bool call(const FnCallExprAST *ast, uint8_t dst);
+
+  bool resolve(Token tkn, Resolved &out);
+  bool global_slot(Symbol sym, uint16_t &slot);
+  bool declare_local(Symbol sym, uint32_t proto, uint8_t &reg);
+  Local *find_local(Symbol sym);
+  bool load_fn(const FnDeclAST *ast, uint32_t idx, uint8_t dst);
+  bool alloc_reg(uint8_t &reg);
+  bool is_temp(uint8_t reg);
+  void begin_scope();
+  void end_scope();
+
+  bool add_constant(Value val, uint16_t &idx);
+  bool number_constant(double num, uint16_t &idx);
+  bool string_constant(Symbol sym, uint16_t &idx);
+
+  void emit(Instr ins);
+  size_t emit_jump(OpCode op, uint8_t a);
+  bool patch_jump(size_t at);
+  bool emit_loop(OpCode op, uint8_t a, size_t target);
+
+  bool fail(CompileErrorKind kind);
+
+  FnState &fn() { return *fn_stack_.back(); }
+  FnProto &proto() { return out_->protos_[fn().proto]; }
+  bool in_top_level() { return fn_stack_.size() == 1; }
+  bool at_global_scope() { return in_top_level() && fn().depth == 0; }
+
+  const SourceBuffer &source_;
+  StringInterner &interner_;
+  BytecodeProgram *out_;
+  std::vector<FnState *> fn_stack_;
+  std::unordered_map<Symbol, Global> globals_;
+
+  // The names that are assigned to anywhere in the program, or declared
+  // more than once as globals, so calls cannot be bound to a function of
+  // that name.
+  std::unordered_set<Symbol> rebound_;
+  std::unordered_map<uint64_t, uint16_t> number_consts_;
+  std::unordered_map<Symbol, uint16_t> string_consts_;
+  uint32_t curr_offset_;
+  std::optional<CompileError> error_;
+
+  Symbol print_sym_;
+  Symbol range_sym_;
+};
+} // namespace sif
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstdint>
+
+namespace sif {
+// Every instruction is 32 bits: an 8 bit opcode followed by either three
+// 8 bit operands (A, B, C) or one 8 bit operand and a 16 bit one (A, Bx).
+// Jumps use Bx as a signed offset (sBx) from the next instruction.
+//
+// R[x] is register x of the current frame, K[x] is constant x, G[x] is
+// global x and U[x] is upvalue x of the running closure.
+#define SIF_OPCODES(X)                                                         \
+  X(LoadK)      /* R[A] = K[Bx] */                                             \
+  X(LoadNil)    /* R[A] = nil */                                               \
+  X(LoadBool)   /* R[A] = B != 0 */                                            \
+  X(Move)       /* R[A] = R[B] */                                              \
+  X(GetGlobal)  /* R[A] = G[Bx] */                                             \
+  X(SetGlobal)  /* G[Bx] = R[A] */                                             \
+  X(GetUpval)   /* R[A] = U[Bx] */                                             \
+  X(SetUpval)   /* U[Bx] = R[A] */                                             \
+  X(Closure)    /* R[A] = closure of P[Bx], see below */                       \
+  X(Close)      /* move variables in R[A] and above out to their upvalues */   \
+  X(Add)        /* R[A] = R[B] + R[C], also concatenates strings */            \
+  X(Sub)        /* R[A] = R[B] - R[C] */                                       \
+  X(Mul)        /* R[A] = R[B] * R[C] */                                       \
+  X(Div)        /* R[A] = R[B] / R[C] */                                       \
+  X(Mod)        /* R[A] = R[B] % R[C] */                                       \
+  X(Eq)         /* R[A] = R[B] == R[C] */                                      \
+  X(Ne)         /* R[A] = R[B] != R[C] */                                      \
+  X(Lt)         /* R[A] = R[B] < R[C] */                                       \
+  X(Le)         /* R[A] = R[B] <= R[C] */                                      \
+  X(Gt)         /* R[A] = R[B] > R[C] */                                       \
+  X(Ge)         /* R[A] = R[B] >= R[C] */                                      \
+  X(Neg)        /* R[A] = -R[B] */                                             \
+  X(Not)        /* R[A] = !R[B] */                                             \
+  X(Jmp)        /* pc += sBx */                                                \
+  X(JmpFalse)   /* if !R[A] then pc += sBx */                                  \
+  X(JmpTrue)    /* if R[A] then pc += sBx */                                   \
+  X(Call)       /* R[A] = P[Bx](R[A + 1], ...) */                              \
+  X(CallValue)  /* R[A] = R[A](R[A + 1], ..., R[A + B]) */                     \
+  X(Ret)        /* return R[A] */                                              \
+  X(RetNil)     /* return nil */                                               \
+  X(Print)      /* print(R[A], ..., R[A + B - 1]) */                           \
+  X(Range)      /* R[A] = range(R[B], R[C]) */                                 \
+  X(ForPrep)    /* check R[A] is iterable, R[A + 1] = 0, pc += sBx */          \
+  X(ForLoop)    /* if another element: R[A + 2] = element,                     \
+                   R[A + 3] = index, R[A + 1]++, pc += sBx */
+
+// Closure is followed by one instruction per upvalue of P[Bx], saying what
+// it captures: Move 0 B for R[B], or GetUpval 0 Bx for U[Bx].
+enum class OpCode : uint8_t {
+#define SIF_OPCODE_ENUM(name) name,
+  SIF_OPCODES(SIF_OPCODE_ENUM)
+#undef SIF_OPCODE_ENUM
+};
+
+typedef uint32_t Instr;
+
+const int32_t SBX_BIAS = 32767;
+const int32_t SBX_MAX = 32767;
+const int32_t SBX_MIN = -32767;
+
+constexpr Instr encode_abc(OpCode op, uint8_t a, uint8_t b, uint8_t c) {
+  return static_cast<Instr>(op) | (static_cast<Instr>(a) << 8) |
+         (static_cast<Instr>(b) << 16) | (static_cast<Instr>(c) << 24);
+}
+
+constexpr Instr encode_abx(OpCode op, uint8_t a, uint16_t bx) {
+  return static_cast<Instr>(op) | (static_cast<Instr>(a) << 8) |
+         (static_cast<Instr>(bx) << 16);
+}
+
+constexpr Instr encode_asbx(OpCode op, uint8_t a, int32_t sbx) {
+  return encode_abx(op, a, static_cast<uint16_t>(sbx + SBX_BIAS));
+}
+
+constexpr OpCode op_of(Instr ins) { return static_cast<OpCode>(ins & 0xff); }
+constexpr uint8_t arg_a(Instr ins) { return (ins >> 8) & 0xff; }
+constexpr uint8_t arg_b(Instr ins) { return (ins >> 16) & 0xff; }
+constexpr uint8_t arg_c(Instr ins) { return (ins >> 24) & 0xff; }
+constexpr uint16_t arg_bx(Instr ins) { return ins >> 16; }
+constexpr int32_t arg_sbx(Instr ins) {
+  return static_cast<int32_t>(arg_bx(ins)) - SBX_BIAS;
+}
+
+static_assert(arg_sbx(encode_asbx(OpCode::Jmp, 0, -5)) == -5);
+static_assert(arg_c(encode_abc(OpCode::Add, 1, 2, 3)) == 3);
+} // namespace sif
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "sif/Interpreter/closure.h"
+#include "sif/Interpreter/deadline.h"
+#include "sif/Interpreter/runtime_error.h"
+#include "sif/Interpreter/string_arena.h"
+#include "sif/Interpreter/value.h"
+#include "sif/Parser/source_buffer.h"
+#include "sif/VM/bytecode.h"
+#include <cstddef>
+#include <optional>
+#include <ostream>
+#include <vector>
+
+namespace sif {
+// Runs a compiled program. Every function's registers are a window onto
+// one shared register stack: a call's arguments are already in place as
+// the first registers of the callee's window, and its result is written
+// back to the register just below it.
+//
+// A closure's upvalues point into the register stack for as long as the
+// variables they capture are in scope, and are closed, taking their own
+// copy, when the scope ends or its function returns.
+//
+// The program, and the source buffer and interner it was compiled from,
+// must outlive the VM.
+class VM {
+public:
+  VM(const BytecodeProgram &program, const SourceBuffer &source,
+     std::ostream &out);
+  ~VM() {}
+
+  VM(const VM &) = delete;
+  VM &operator=(const VM &) = delete;
+
+  // Returns false if execution stopped on a runtime error, which is then
+  // available from Error().
+  bool Run();
+
+  std::optional<RuntimeError> Error() const { return error_; }
+
+  void SetDeadline(Deadline deadline) { deadline_ = deadline; }
+
+private:
+  struct Frame {
+    const FnProto *proto;
+    const Instr *pc;
+    size_t base;
+    const Closure *closure;
+  };
+
+  Upvalue *open_upvalue(size_t slot);
+  void close_upvalues(size_t from);
+  void grow_regs(size_t needed);
+
+  // pc is the instruction after the one that failed.
+  bool fail(RuntimeErrorKind kind, const FnProto *proto, const Instr *pc);
+
+  const BytecodeProgram &program_;
+  const SourceBuffer &source_;
+  std::ostream &out_;
+
+  std::vector<Value> regs_;
+  std::vector<Value> globals_;
+  std::vector<Frame> frames_;
+  StringArena strings_;
+  ClosureArena closures_;
+  // Upvalues still pointing into regs_, in order of their slots.
+  std::vector<Upvalue *> open_upvals_;
+  std::optional<RuntimeError> error_;
+  Deadline deadline_;
+};
+} // namespace sif
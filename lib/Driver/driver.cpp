@@ -1,22 +1,394 @@
 #include "sif/Driver/driver.h"
+#include "sif/Driver/program_cache.h"
+#include "sif/Interpreter/interpreter.h"
+#include "sif/Parser/constant_folder.h"
 #include "sif/Parser/lexer.h"
 #include "sif/Parser/parser.h"
+#include "sif/Parser/stream_parser.h"
 #include "sif/Parser/symbol_table.h"
 #include "sif/Parser/token.h"
-#include <cassert>
+#include "sif/Support/work_pool.h"
+#include "sif/VM/bytecode_cache.h"
+#include "sif/VM/compiler.h"
+#include "sif/VM/vm.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
 #include <iostream>
+#include <optional>
+#include <thread>
 
 using namespace sif;
 
-void Driver::run() {
-  Lexer l = Lexer(filename_);
-  SymbolTable symtab = SymbolTable();
-  Parser parser =
-      Parser(std::make_unique<Lexer>(l), std::make_unique<SymbolTable>(symtab));
+namespace {
+const size_t PARALLEL_LEX_MIN_SIZE = 8 << 20;
+
+// The path that names standard input, and what to call it in diagnostics.
+const char *const STDIN_PATH = "-";
+const char *const STDIN_NAME = "<stdin>";
+
+int run_vm(const BytecodeProgram &program, const SourceBuffer &source,
+           Deadline deadline, std::ostream &out, std::ostream &err) {
+  VM vm = VM(program, source, out);
+  vm.SetDeadline(deadline);
+  if (!vm.Run()) {
+    vm.Error().value().Emit(err);
+    return 1;
+  }
+  return 0;
+}
+
+// Appends path, or every .sif file under it in sorted order if it is a
+// directory. The directory is read from resolved, which path names, but
+// the files found are named starting with path. Returns false if a
+// directory could not be read.
+bool collect_files(const std::string &path, const std::string &resolved,
+                   std::vector<std::string> &files) {
+  namespace fs = std::filesystem;
+  std::error_code ec;
+  if (!fs::is_directory(resolved, ec)) {
+    // Anything else is left for the parse to report if it cannot be read.
+    files.push_back(path);
+    return true;
+  }
+
+  std::vector<std::string> found;
+  auto it = fs::recursive_directory_iterator(resolved, ec);
+  for (; !ec && it != fs::recursive_directory_iterator(); it.increment(ec)) {
+    if (it->is_regular_file(ec) && it->path().extension() == ".sif") {
+      found.push_back(path + it->path().string().substr(resolved.size()));
+    }
+  }
+  if (ec) {
+    return false;
+  }
+
+  std::sort(found.begin(), found.end());
+  files.insert(files.end(), found.begin(), found.end());
+  return true;
+}
+
+struct CheckResult {
+  bool opened;
+  std::vector<ParseError> errors;
+  Stats stats;
+};
+
+// Lexes up front when stats are wanted, so that lexing is timed apart from
+// parsing. Otherwise tokens are lexed as the parser asks for them.
+std::vector<Token> lex_for_stats(Lexer &lexer, PhaseTimer &timer,
+                                 Stats *stats) {
+  if (stats == nullptr || lexer.Source().IsStream()) {
+    return std::vector<Token>();
+  }
+  timer.Start(Phase::Lex);
+  return lexer.LexAll();
+}
+
+void add_counts(Stats *stats, Parser &parser, const ASTContext &ctx) {
+  if (stats != nullptr) {
+    stats->Add(parser.GetLexer().Source());
+    stats->Add(parser.GetLexer());
+    stats->Add(ctx);
+    stats->Add(parser.Symbols());
+  }
+}
+
+// Every file gets its own interner, AST and symbol table, so files can be
+// checked on any thread without sharing anything. With a cache, files are
+// parsed through it instead, which is safe on any thread too, but counts
+// nothing.
+CheckResult check_file(const std::string &filename, ProgramCache *cache,
+                       bool want_stats) {
+  CheckResult result = CheckResult{true, {}, Stats()};
+  Stats *stats = want_stats ? &result.stats : nullptr;
+  PhaseTimer timer = PhaseTimer(stats, Phase::Read);
+  std::unique_ptr<SourceBuffer> file = SourceBuffer::FromFile(filename);
+  if (file == nullptr) {
+    result.opened = false;
+    return result;
+  }
+  if (cache != nullptr) {
+    if (stats != nullptr) {
+      stats->Add(*file);
+    }
+    timer.Start(Phase::Parse);
+    result.errors = cache->Get(std::move(file))->Errors();
+    return result;
+  }
+
+  StringInterner interner;
+  ASTContext ctx;
+  auto lexer = std::make_unique<Lexer>(std::move(file), interner);
+  std::vector<Token> tokens = lex_for_stats(*lexer, timer, stats);
+  timer.Start(Phase::Parse);
+  Parser parser = Parser(std::move(lexer), std::move(tokens),
+                         std::make_unique<SymbolTable>(), ctx);
+  result.errors = std::move(parser.Parse().errors_);
+  add_counts(stats, parser, ctx);
+  return result;
+}
+
+// Only the errors are kept, so however much is piped in, checking it takes
+// no more memory than its largest declaration. The stream is read and
+// lexed as it is parsed, so all of that is timed as parsing.
+CheckResult check_stream(std::istream &in, bool want_stats) {
+  CheckResult result = CheckResult{true, {}, Stats()};
+  Stats *stats = want_stats ? &result.stats : nullptr;
+  PhaseTimer timer = PhaseTimer(stats, Phase::Parse);
+  StringInterner interner;
+  StreamParser parser = StreamParser(in, interner);
+  parser.Parse([&](ASTNode *, const std::vector<ParseError> &decl_errors) {
+    result.errors.insert(result.errors.end(), decl_errors.begin(),
+                         decl_errors.end());
+  });
+  add_counts(stats, parser.GetParser(), parser.Context());
+  return result;
+}
+} // namespace
+
+bool sif::ParseArgs(const std::vector<std::string> &args,
+                    std::vector<std::string> &paths, DriverOptions &opts) {
+  opts = DriverOptions{false, false, false, 0, StatsFormat::None, 0};
+  for (size_t i = 0; i < args.size(); i++) {
+    const std::string &arg = args[i];
+    if (arg == "--vm") {
+      opts.use_vm = true;
+    } else if (arg == "--cache") {
+      opts.use_cache = true;
+    } else if (arg == "--check") {
+      opts.check_only = true;
+    } else if (arg == "--stats") {
+      opts.stats = StatsFormat::Text;
+    } else if (arg == "--stats=json") {
+      opts.stats = StatsFormat::Json;
+    } else if (arg == "-j" && i + 1 < args.size()) {
+      opts.jobs = std::strtoul(args[++i].c_str(), nullptr, 10);
+    } else if (arg == "--timeout" && i + 1 < args.size()) {
+      opts.timeout_seconds = std::strtoul(args[++i].c_str(), nullptr, 10);
+    } else {
+      paths.push_back(arg);
+    }
+  }
+
+  // Only checking takes more than one file.
+  return !paths.empty() && (opts.check_only || paths.size() == 1);
+}
+
+int Driver::run() {
+  auto start = std::chrono::steady_clock::now();
+  if (opts_.timeout_seconds != 0) {
+    deadline_.Set(start + std::chrono::seconds(opts_.timeout_seconds));
+  }
+  int status = opts_.check_only ? check_files() : run_file(paths_.front());
+  if (stats() == nullptr) {
+    return status;
+  }
+
+  stats_.wall_seconds = std::chrono::duration<double>(
+                            std::chrono::steady_clock::now() - start)
+                            .count();
+  stats_.SamplePeakRss();
+  if (opts_.stats == StatsFormat::Json) {
+    stats_.PrintJson(err_);
+  } else {
+    stats_.PrintText(err_);
+  }
+  return status;
+}
+
+int Driver::check_files() {
+  std::vector<std::string> files;
+  for (const std::string &path : paths_) {
+    if (!collect_files(path, resolve(path), files)) {
+      err_ << "sif: cannot read directory '" << path << "'\n";
+      return 1;
+    }
+  }
+
+  std::vector<CheckResult> results(files.size());
+  // A server's standard input is not its client's, so a server looks for -
+  // as a file like any other path.
+  bool want_stats = stats() != nullptr;
+  auto check = [&](size_t i) {
+    if (files[i] == STDIN_PATH && cache_ == nullptr) {
+      results[i] = check_stream(std::cin, want_stats);
+    } else {
+      results[i] = check_file(resolve(files[i]), cache_, want_stats);
+    }
+  };
+  if (opts_.jobs == 1) {
+    for (size_t i = 0; i < files.size(); i++) {
+      check(i);
+    }
+  } else {
+    WorkPool pool = WorkPool(opts_.jobs);
+    pool.ForEach(files.size(), check);
+  }
+
+  // Diagnostics are only written once every file is done, in the order the
+  // files were given, so the output does not depend on scheduling.
+  int status = 0;
+  for (size_t i = 0; i < files.size(); i++) {
+    if (!results[i].opened) {
+      err_ << "sif: cannot open '" << files[i] << "'\n";
+      status = 1;
+    }
+    const std::string &name = files[i] == STDIN_PATH ? STDIN_NAME : files[i];
+    for (ParseError &err : results[i].errors) {
+      err.Emit(err_, name);
+      status = 1;
+    }
+    stats_.Add(results[i].stats);
+  }
+  return status;
+}
+
+int Driver::run_file(const std::string &filename) {
+  PhaseTimer timer = PhaseTimer(stats(), Phase::Read);
+  // Standard input is lexed through a window as it is read. Running needs
+  // the whole program, but not the whole text.
+  std::unique_ptr<SourceBuffer> file =
+      filename == STDIN_PATH && cache_ == nullptr
+          ? SourceBuffer::FromStream(std::cin)
+          : SourceBuffer::FromFile(resolve(filename));
+  if (file == nullptr) {
+    err_ << "sif: cannot open '" << filename << "'\n";
+    return 1;
+  }
+  if (cache_ != nullptr) {
+    return run_cached(std::move(file), timer);
+  }
+
+  // A cached program runs without the source being lexed at all. The
+  // source is only needed again to locate a runtime error.
+  std::optional<BytecodeCache> cache;
+  if (opts_.use_cache && !file->IsStream() &&
+      !BytecodeCache::DefaultDir().empty()) {
+    cache.emplace(BytecodeCache::DefaultDir(),
+                  BytecodeCache::DefaultMaxBytes());
+    BytecodeProgram program;
+    if (cache->Load(*file, program)) {
+      if (stats() != nullptr) {
+        stats_.Add(*file);
+      }
+      timer.Start(Phase::Run);
+      return run_vm(program, *file, deadline_, out_, err_);
+    }
+  }
+
+  StringInterner interner;
+  ASTContext ctx;
+  auto lexer = std::make_unique<Lexer>(std::move(file), interner);
+  const SourceBuffer &source = lexer->Source();
+
+  // Lexing a very large file is split across threads before parsing
+  // starts. Anything smaller is lexed as the parser goes.
+  std::vector<Token> tokens;
+  size_t threads =
+      opts_.jobs != 0 ? opts_.jobs : std::thread::hardware_concurrency();
+  if (threads > 1 && !source.IsStream() &&
+      source.Size() >= PARALLEL_LEX_MIN_SIZE) {
+    timer.Start(Phase::Lex);
+    WorkPool pool = WorkPool(threads);
+    tokens = lexer->LexAll(pool);
+  } else {
+    tokens = lex_for_stats(*lexer, timer, stats());
+  }
+  timer.Start(Phase::Parse);
+  Parser parser = Parser(std::move(lexer), std::move(tokens),
+                         std::make_unique<SymbolTable>(), ctx);
 
   auto result = parser.Parse();
-  assert(result.contains_error_ == false);
-  assert(result.ast_ != nullptr);
-  assert(result.ast_.GetKind() == ASTKind::Program);
-  std::cout << "Parsing successful\n";
+  add_counts(stats(), parser, ctx);
+  if (result.contains_error_) {
+    for (ParseError &err : result.errors_) {
+      err.Emit(err_);
+    }
+    return 1;
+  }
+
+  timer.Start(Phase::Fold);
+  ConstantFolder folder = ConstantFolder(ctx);
+  folder.Fold(result.ast_);
+
+  if (opts_.use_vm || opts_.use_cache) {
+    timer.Start(Phase::Compile);
+    BytecodeProgram program;
+    Compiler compiler = Compiler(source, interner);
+    if (compiler.Compile(result.ast_, program)) {
+      // Caching is best effort: a failed write only costs the next run a
+      // compile.
+      if (cache.has_value()) {
+        cache->Store(source, program);
+      }
+      timer.Start(Phase::Run);
+      return run_vm(program, source, deadline_, out_, err_);
+    }
+
+    // A program too large for the bytecode runs on the tree walker.
+    CompileError error = compiler.Error().value();
+    if (!error.IsLimit()) {
+      error.Emit(err_);
+      return 1;
+    }
+  }
+
+  timer.Start(Phase::Run);
+  Interpreter interpreter = Interpreter(source, interner, out_);
+  interpreter.SetDeadline(deadline_);
+  if (!interpreter.Run(result.ast_)) {
+    interpreter.Error().value().Emit(err_);
+    return 1;
+  }
+  return 0;
+}
+
+// A program the cache already holds is not parsed again, and programs the
+// cache parses count no tokens, nodes or lookups.
+int Driver::run_cached(std::unique_ptr<SourceBuffer> file, PhaseTimer &timer) {
+  if (stats() != nullptr) {
+    stats_.Add(*file);
+  }
+  timer.Start(Phase::Parse);
+  std::shared_ptr<CachedProgram> program = cache_->Get(std::move(file));
+  if (program->Program() == nullptr) {
+    for (ParseError err : program->Errors()) {
+      err.Emit(err_);
+    }
+    return 1;
+  }
+
+  if (opts_.use_vm || opts_.use_cache) {
+    timer.Start(Phase::Compile);
+    const BytecodeProgram *bytecode = program->Bytecode();
+    if (bytecode != nullptr) {
+      timer.Start(Phase::Run);
+      return run_vm(*bytecode, program->Source(), deadline_, out_, err_);
+    }
+
+    CompileError error = program->CompileErr().value();
+    if (!error.IsLimit()) {
+      error.Emit(err_);
+      return 1;
+    }
+  }
+
+  timer.Start(Phase::Run);
+  Interpreter interpreter =
+      Interpreter(program->Source(), program->Interner(), out_);
+  interpreter.SetDeadline(deadline_);
+  if (!interpreter.Run(program->Program())) {
+    interpreter.Error().value().Emit(err_);
+    return 1;
+  }
+  return 0;
+}
+
+std::string Driver::resolve(const std::string &path) const {
+  if (dir_.empty() || path.empty() || path[0] == '/') {
+    return path;
+  }
+  return dir_ + "/" + path;
 }
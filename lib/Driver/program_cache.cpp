@@ -0,0 +1,91 @@
+#include "sif/Driver/program_cache.h"
+#include "sif/Parser/constant_folder.h"
+#include "sif/Parser/lexer.h"
+#include "sif/Parser/symbol_table.h"
+#include "sif/VM/bytecode_cache.h"
+#include "sif/VM/compiler.h"
+#include <cassert>
+#include <string>
+
+using namespace sif;
+
+CachedProgram::CachedProgram(std::unique_ptr<SourceBuffer> source) {
+  // Another process can change a mapped file under us, so keep a copy.
+  if (source->IsMapped()) {
+    source = SourceBuffer::FromString(std::string(source->Text()));
+  }
+
+  // The line index and the names of the standard functions are filled in
+  // on first use. Doing it now means threads running the program later
+  // only ever read them.
+  source->Locate(0);
+  interner_.Intern("print");
+  interner_.Intern("range");
+
+  parser_ = std::make_unique<Parser>(
+      std::make_unique<Lexer>(std::move(source), interner_),
+      std::make_unique<SymbolTable>(), ctx_);
+  auto result = parser_->Parse();
+  program_ = nullptr;
+  if (result.contains_error_) {
+    errors_ = std::move(result.errors_);
+    return;
+  }
+
+  ConstantFolder folder = ConstantFolder(ctx_);
+  folder.Fold(result.ast_);
+  program_ = result.ast_;
+}
+
+const BytecodeProgram *CachedProgram::Bytecode() {
+  assert(program_ != nullptr && "a program with errors cannot be compiled");
+  std::call_once(compiled_, [this]() {
+    auto bytecode = std::make_unique<BytecodeProgram>();
+    Compiler compiler = Compiler(Source(), interner_);
+    if (compiler.Compile(program_, *bytecode)) {
+      bytecode_ = std::move(bytecode);
+    } else {
+      compile_error_ = compiler.Error();
+    }
+  });
+  return bytecode_.get();
+}
+
+std::shared_ptr<CachedProgram>
+ProgramCache::Get(std::unique_ptr<SourceBuffer> source) {
+  uint64_t hash = BytecodeCache::Hash(source->Text());
+  {
+    std::lock_guard<std::mutex> lock(mu_);
+    auto it = by_hash_.find(hash);
+    if (it != by_hash_.end() &&
+        it->second->program->Source().Text() == source->Text()) {
+      entries_.splice(entries_.begin(), entries_, it->second);
+      return it->second->program;
+    }
+  }
+
+  // Parse without holding the lock, so requests for other programs are
+  // not held up. Two requests for the same new text may both parse it, in
+  // which case the later one replaces the earlier.
+  auto program = std::make_shared<CachedProgram>(std::move(source));
+
+  std::lock_guard<std::mutex> lock(mu_);
+  auto it = by_hash_.find(hash);
+  if (it != by_hash_.end()) {
+    bytes_ -= it->second->program->Bytes();
+    entries_.erase(it->second);
+    by_hash_.erase(it);
+  }
+  entries_.push_front(Entry{hash, program});
+  by_hash_[hash] = entries_.begin();
+  bytes_ += program->Bytes();
+
+  // The program just added is kept even if it is over budget on its own.
+  while (bytes_ > max_bytes_ && entries_.size() > 1) {
+    const Entry &oldest = entries_.back();
+    bytes_ -= oldest.program->Bytes();
+    by_hash_.erase(oldest.hash);
+    entries_.pop_back();
+  }
+  return program;
+}
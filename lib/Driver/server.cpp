@@ -0,0 +1,289 @@
+#include "sif/Driver/server.h"
+#include "sif/Driver/driver.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <sstream>
+#include <streambuf>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+
+using namespace sif;
+
+namespace {
+// Keeps the first max bytes written to it and drops the rest, so a program
+// that prints without end can not use up the server's memory.
+class CappedBuf : public std::streambuf {
+public:
+  CappedBuf(size_t max) {
+    max_ = max;
+    truncated_ = false;
+  }
+
+  const std::string &Text() const { return text_; }
+  bool Truncated() const { return truncated_; }
+
+protected:
+  int_type overflow(int_type ch) override {
+    if (ch != traits_type::eof()) {
+      char c = traits_type::to_char_type(ch);
+      xsputn(&c, 1);
+    }
+    return traits_type::not_eof(ch);
+  }
+
+  // Everything counts as written, so the program runs on as it would
+  // anywhere else.
+  std::streamsize xsputn(const char *s, std::streamsize n) override {
+    size_t kept = std::min(static_cast<size_t>(n), max_ - text_.size());
+    text_.append(s, kept);
+    truncated_ = truncated_ || kept < static_cast<size_t>(n);
+    return n;
+  }
+
+private:
+  std::string text_;
+  size_t max_;
+  bool truncated_;
+};
+
+// Returns false if path is too long for a socket address.
+bool make_address(const std::string &path, sockaddr_un &addr) {
+  std::memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (path.size() >= sizeof(addr.sun_path)) {
+    return false;
+  }
+  std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+  return true;
+}
+
+int connect_to(const std::string &path) {
+  sockaddr_un addr;
+  if (!make_address(path, addr)) {
+    return -1;
+  }
+  int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd < 0) {
+    return -1;
+  }
+  if (connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+bool write_all(int fd, std::string_view data) {
+  while (!data.empty()) {
+    // A peer that has gone away must not kill the whole process.
+    ssize_t n = send(fd, data.data(), data.size(), MSG_NOSIGNAL);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      return false;
+    }
+    data.remove_prefix(static_cast<size_t>(n));
+  }
+  return true;
+}
+
+// Reads until the peer stops writing. Returns false on an error or once
+// more than max bytes have arrived.
+bool read_all(int fd, std::string &out, size_t max) {
+  char buf[4096];
+  for (;;) {
+    ssize_t n = recv(fd, buf, sizeof(buf), 0);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n < 0) {
+      return false;
+    }
+    if (n == 0) {
+      return true;
+    }
+    out.append(buf, static_cast<size_t>(n));
+    if (out.size() > max) {
+      return false;
+    }
+  }
+}
+} // namespace
+
+Server::Server(std::string socket_path, size_t num_threads)
+    : cache_(CACHE_BYTES) {
+  socket_path_ = socket_path;
+  num_threads_ = num_threads;
+  if (num_threads_ == 0) {
+    num_threads_ = std::thread::hardware_concurrency();
+  }
+  if (num_threads_ == 0) {
+    num_threads_ = 1;
+  }
+}
+
+int Server::Run() {
+  sockaddr_un addr;
+  if (!make_address(socket_path_, addr)) {
+    std::cerr << "sif: socket path '" << socket_path_ << "' is too long\n";
+    return 1;
+  }
+
+  // A socket left behind by a server that has exited would make bind fail,
+  // so it is removed, but one that a server still answers on is not.
+  int live = connect_to(socket_path_);
+  if (live >= 0) {
+    close(live);
+    std::cerr << "sif: a server is already listening on '" << socket_path_
+              << "'\n";
+    return 1;
+  }
+  std::error_code ec;
+  if (std::filesystem::is_socket(socket_path_, ec)) {
+    unlink(socket_path_.c_str());
+  }
+
+  int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd < 0 ||
+      bind(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0 ||
+      listen(fd, SOMAXCONN) != 0) {
+    std::cerr << "sif: cannot listen on '" << socket_path_
+              << "': " << std::strerror(errno) << "\n";
+    if (fd >= 0) {
+      close(fd);
+    }
+    return 1;
+  }
+
+  std::vector<std::thread> workers;
+  for (size_t i = 0; i < num_threads_; i++) {
+    workers.emplace_back([this, fd]() { serve(fd); });
+  }
+  for (std::thread &worker : workers) {
+    worker.join();
+  }
+  close(fd);
+  return 1;
+}
+
+void Server::serve(int listen_fd) {
+  for (;;) {
+    int fd = accept4(listen_fd, nullptr, nullptr, SOCK_CLOEXEC);
+    if (fd >= 0) {
+      handle(fd);
+      close(fd);
+    } else if (errno != EINTR && errno != ECONNABORTED) {
+      std::cerr << "sif: cannot accept on '" << socket_path_
+                << "': " << std::strerror(errno) << "\n";
+      return;
+    }
+  }
+}
+
+void Server::handle(int fd) {
+  // A client that stops sending or reading must not hold the thread
+  // forever. A timed out read or write fails like any other.
+  timeval timeout = timeval{IO_TIMEOUT_SECONDS, 0};
+  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+  setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+  // A request that cannot be read has nobody to reply to.
+  std::string request;
+  if (!read_all(fd, request, MAX_REQUEST_BYTES)) {
+    return;
+  }
+
+  std::vector<std::string> fields;
+  size_t start = 0;
+  for (size_t end = request.find('\0'); end != std::string::npos;
+       end = request.find('\0', start)) {
+    fields.push_back(request.substr(start, end - start));
+    start = end + 1;
+  }
+
+  CappedBuf out_buf = CappedBuf(MAX_OUTPUT_BYTES);
+  CappedBuf err_buf = CappedBuf(MAX_OUTPUT_BYTES);
+  std::ostream out(&out_buf);
+  std::ostream err(&err_buf);
+  int status = 1;
+  std::vector<std::string> paths;
+  DriverOptions opts;
+  if (fields.empty() ||
+      !ParseArgs(std::vector<std::string>(fields.begin() + 1, fields.end()),
+                 paths, opts)) {
+    err << "sif: invalid request\n";
+  } else {
+    // Requests are already served in parallel, so each one keeps to the
+    // thread it arrived on, for no longer than the server allows.
+    opts.jobs = 1;
+    if (opts.timeout_seconds == 0 ||
+        opts.timeout_seconds > RUN_TIMEOUT_SECONDS) {
+      opts.timeout_seconds = RUN_TIMEOUT_SECONDS;
+    }
+    Driver driver = Driver(paths, opts, out, err, fields[0], &cache_);
+    status = driver.run();
+  }
+
+  if (out_buf.Truncated() || err_buf.Truncated()) {
+    status = 1;
+    err << "sif: output cut off after " << MAX_OUTPUT_BYTES << " bytes\n";
+  }
+
+  const std::string &out_text = out_buf.Text();
+  const std::string &err_text = err_buf.Text();
+  std::string header = std::to_string(status) + " " +
+                       std::to_string(out_text.size()) + " " +
+                       std::to_string(err_text.size()) + "\n";
+  // If the client has gone away there is nobody left to tell.
+  if (write_all(fd, header) && write_all(fd, out_text)) {
+    write_all(fd, err_text);
+  }
+}
+
+int sif::SendRequest(const std::string &socket_path,
+                     const std::vector<std::string> &args) {
+  int fd = connect_to(socket_path);
+  if (fd < 0) {
+    std::cerr << "sif: cannot connect to '" << socket_path << "'\n";
+    return 1;
+  }
+
+  std::error_code ec;
+  std::string request = std::filesystem::current_path(ec).string();
+  request.push_back('\0');
+  for (const std::string &arg : args) {
+    request.append(arg);
+    request.push_back('\0');
+  }
+
+  std::string reply;
+  bool ok = write_all(fd, request) && shutdown(fd, SHUT_WR) == 0 &&
+            read_all(fd, reply, SIZE_MAX);
+  close(fd);
+
+  size_t newline = reply.find('\n');
+  int status = 1;
+  size_t out_size = 0;
+  size_t err_size = 0;
+  if (ok && newline != std::string::npos) {
+    std::istringstream header = std::istringstream(reply.substr(0, newline));
+    ok = static_cast<bool>(header >> status >> out_size >> err_size) &&
+         reply.size() - newline - 1 == out_size + err_size;
+  }
+  if (!ok || newline == std::string::npos) {
+    std::cerr << "sif: no reply from '" << socket_path << "'\n";
+    return 1;
+  }
+
+  std::cout.write(reply.data() + newline + 1, out_size);
+  std::cerr.write(reply.data() + newline + 1 + out_size, err_size);
+  return status;
+}
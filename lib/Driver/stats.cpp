@@ -0,0 +1,211 @@
+#include "sif/Driver/stats.h"
+#include "sif/Support/counters.h"
+#include <algorithm>
+#include <iomanip>
+#include <iterator>
+#include <sys/resource.h>
+
+using namespace sif;
+
+namespace {
+const char *const TOKEN_KIND_NAMES[] = {
+    "LeftParen", "RightParen", "LeftBrace", "RightBrace", "LeftBracket",
+    "RightBracket", "Semicolon", "Equal", "LessThan", "GreaterThan", "Period",
+    "Comma", "Bang", "Plus", "Minus", "Star", "Slash", "Percent", "Ampersand",
+    "Pipe", "At", "EqualEqual", "LessThanEqual", "GreaterThanEqual",
+    "EqualArrow", "BangEqual", "DoubleAmpersand", "DoublePipe",
+    "DoubleLeftBracket", "DoubleRightBracket", "Identifier", "StringLiteral",
+    "NumberLiteral", "Eof", "If", "ElIf", "Else", "Var", "Fn", "Ret", "Table",
+    "Array", "For", "In", "True", "False"};
+static_assert(std::size(TOKEN_KIND_NAMES) == NUM_TOKEN_KINDS,
+              "every token kind needs a name");
+
+const char *const AST_KIND_NAMES[] = {
+    "Program", "Block", "IfStmt", "ElifStmt", "ForStmt", "ReturnStmt",
+    "ExprStmt", "VarDecl", "FnDecl", "FnParams", "IdentPair", "ItemList",
+    "TableItem", "Table", "TableAccess", "Array", "ArrayItems", "ArrayAccess",
+    "ArrayMutExpr", "FnCallExpr", "VarAssignExpr", "BinaryExpr", "UnaryExpr",
+    "LiteralExpr", "Empty"};
+static_assert(std::size(AST_KIND_NAMES) == NUM_AST_KINDS,
+              "every AST kind needs a name");
+
+const char *const PHASE_NAMES[] = {"read", "lex",     "parse",
+                                   "fold", "compile", "run"};
+static_assert(std::size(PHASE_NAMES) == NUM_PHASES, "every phase needs a name");
+
+template <size_t N> uint64_t total(const std::array<uint64_t, N> &counts) {
+  uint64_t sum = 0;
+  for (uint64_t count : counts) {
+    sum += count;
+  }
+  return sum;
+}
+
+// Lists the kinds that were counted at least once, as name and count rows.
+template <size_t N>
+void print_counts(std::ostream &out, const char *title,
+                  const std::array<uint64_t, N> &counts,
+                  const char *const (&names)[N]) {
+  out << "  " << std::left << std::setw(20) << title << total(counts)
+      << "\n";
+  for (size_t i = 0; i < N; i++) {
+    if (counts[i] != 0) {
+      out << "    " << std::setw(18) << names[i] << counts[i] << "\n";
+    }
+  }
+}
+
+template <size_t N>
+void print_json_counts(std::ostream &out, const std::array<uint64_t, N> &counts,
+                       const char *const (&names)[N]) {
+  out << "{";
+  for (size_t i = 0; i < N; i++) {
+    out << (i == 0 ? "" : ", ") << "\"" << names[i] << "\": " << counts[i];
+  }
+  out << "}";
+}
+} // namespace
+
+Stats::Stats() {
+  bytes_read = 0;
+  tokens.fill(0);
+  nodes.fill(0);
+  phase_seconds.fill(0);
+  wall_seconds = 0;
+  peak_rss_bytes = 0;
+}
+
+void Stats::Add(const SourceBuffer &source) {
+  // A stream's window ends wherever it has been read up to.
+  bytes_read += source.Base() + source.Size();
+}
+
+void Stats::Add(const Lexer &lexer) {
+  for (size_t i = 0; i < NUM_TOKEN_KINDS; i++) {
+    tokens[i] += lexer.TokenCounts()[i];
+  }
+}
+
+void Stats::Add(const ASTContext &ctx) {
+  for (size_t i = 0; i < NUM_AST_KINDS; i++) {
+    nodes[i] += ctx.NodeCounts()[i];
+  }
+}
+
+void Stats::Add(const SymbolTable &symtab) {
+  const std::vector<SymbolTable::LookupCount> &counts = symtab.LookupCounts();
+  if (lookups.size() < counts.size()) {
+    lookups.resize(counts.size(), SymbolTable::LookupCount{0, 0});
+  }
+  for (size_t level = 0; level < counts.size(); level++) {
+    lookups[level].probes += counts[level].probes;
+    lookups[level].hits += counts[level].hits;
+  }
+}
+
+void Stats::Add(const Stats &other) {
+  bytes_read += other.bytes_read;
+  for (size_t i = 0; i < NUM_TOKEN_KINDS; i++) {
+    tokens[i] += other.tokens[i];
+  }
+  for (size_t i = 0; i < NUM_AST_KINDS; i++) {
+    nodes[i] += other.nodes[i];
+  }
+  if (lookups.size() < other.lookups.size()) {
+    lookups.resize(other.lookups.size(), SymbolTable::LookupCount{0, 0});
+  }
+  for (size_t level = 0; level < other.lookups.size(); level++) {
+    lookups[level].probes += other.lookups[level].probes;
+    lookups[level].hits += other.lookups[level].hits;
+  }
+  for (size_t i = 0; i < NUM_PHASES; i++) {
+    phase_seconds[i] += other.phase_seconds[i];
+  }
+  wall_seconds += other.wall_seconds;
+  peak_rss_bytes = std::max(peak_rss_bytes, other.peak_rss_bytes);
+}
+
+void Stats::SamplePeakRss() {
+  rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) == 0) {
+    // Linux reports kilobytes.
+    peak_rss_bytes = static_cast<uint64_t>(usage.ru_maxrss) * 1024;
+  }
+}
+
+void Stats::PrintText(std::ostream &out) const {
+  std::ios_base::fmtflags flags = out.flags();
+  out << std::fixed << std::setprecision(3);
+  out << "sif stats\n";
+  out << "  " << std::left << std::setw(20) << "bytes read" << bytes_read
+      << "\n";
+  out << "  " << std::setw(20) << "peak rss (MiB)"
+      << static_cast<double>(peak_rss_bytes) / (1 << 20) << "\n";
+  out << "  " << std::setw(20) << "wall time (ms)" << wall_seconds * 1000
+      << "\n";
+  for (size_t i = 0; i < NUM_PHASES; i++) {
+    out << "    " << std::setw(18) << PHASE_NAMES[i]
+        << phase_seconds[i] * 1000 << "\n";
+  }
+
+  if (!COUNTERS_ENABLED) {
+    out << "  counters were compiled out\n";
+    out.flags(flags);
+    return;
+  }
+  print_counts(out, "tokens", tokens, TOKEN_KIND_NAMES);
+  print_counts(out, "ast nodes", nodes, AST_KIND_NAMES);
+  out << "  symbol lookups     probes    hits\n";
+  for (size_t level = 0; level < lookups.size(); level++) {
+    out << "    depth " << std::setw(12) << level << std::setw(10)
+        << lookups[level].probes << lookups[level].hits << "\n";
+  }
+  out.flags(flags);
+}
+
+void Stats::PrintJson(std::ostream &out) const {
+  std::ios_base::fmtflags flags = out.flags();
+  out << std::fixed << std::setprecision(6);
+  out << "{\"bytes_read\": " << bytes_read
+      << ", \"peak_rss_bytes\": " << peak_rss_bytes
+      << ", \"wall_seconds\": " << wall_seconds << ", \"phase_seconds\": {";
+  for (size_t i = 0; i < NUM_PHASES; i++) {
+    out << (i == 0 ? "" : ", ") << "\"" << PHASE_NAMES[i]
+        << "\": " << phase_seconds[i];
+  }
+  out << "}, \"counters_enabled\": " << (COUNTERS_ENABLED ? "true" : "false")
+      << ", \"tokens\": ";
+  print_json_counts(out, tokens, TOKEN_KIND_NAMES);
+  out << ", \"ast_nodes\": ";
+  print_json_counts(out, nodes, AST_KIND_NAMES);
+  out << ", \"symbol_lookups\": [";
+  for (size_t level = 0; level < lookups.size(); level++) {
+    out << (level == 0 ? "" : ", ") << "{\"depth\": " << level
+        << ", \"probes\": " << lookups[level].probes
+        << ", \"hits\": " << lookups[level].hits << "}";
+  }
+  out << "]}\n";
+  out.flags(flags);
+}
+
+PhaseTimer::PhaseTimer(Stats *stats, Phase phase) {
+  stats_ = stats;
+  phase_ = phase;
+  start_ = std::chrono::steady_clock::now();
+}
+
+void PhaseTimer::Start(Phase phase) {
+  stop();
+  phase_ = phase;
+  start_ = std::chrono::steady_clock::now();
+}
+
+void PhaseTimer::stop() {
+  if (stats_ == nullptr) {
+    return;
+  }
+  auto now = std::chrono::steady_clock::now();
+  stats_->phase_seconds[static_cast<size_t>(phase_)] +=
+      std::chrono::duration<double>(now - start_).count();
+  start_ = now;
+}
@@ -0,0 +1,108 @@
+#include "sif/Interpreter/environment.h"
+
+using namespace sif;
+
+Environment::Environment() {
+  slots_.resize(INITIAL_SLOTS, Slot{NO_BINDING, NO_BINDING});
+  used_slots_ = 0;
+  frame_ = 0;
+}
+
+void Environment::PopScope() {
+  if (scope_marks_.empty()) {
+    return;
+  }
+
+  uint32_t mark = scope_marks_.back();
+  scope_marks_.pop_back();
+
+  while (bindings_.size() > mark) {
+    const Binding &binding = bindings_.back();
+    slots_[find_slot(binding.key)].head = binding.shadowed;
+    bindings_.pop_back();
+  }
+}
+
+void Environment::Define(Symbol key, Value val) {
+  size_t idx = find_slot(key);
+  Slot &slot = slots_[idx];
+  uint32_t scope = static_cast<uint32_t>(scope_marks_.size());
+
+  if (slot.head != NO_BINDING && bindings_[slot.head].scope == scope) {
+    *value_of(bindings_[slot.head]) = val;
+    return;
+  }
+
+  if (slot.key == NO_BINDING) {
+    slot.key = key;
+    used_slots_++;
+  }
+
+  bindings_.push_back(Binding{val, nullptr, key, slot.head, scope, frame_});
+  slot.head = static_cast<uint32_t>(bindings_.size() - 1);
+
+  if (used_slots_ * 2 > slots_.size()) {
+    grow();
+  }
+}
+
+Value *Environment::Lookup(Symbol key, bool &is_local) {
+  uint32_t idx = slots_[find_slot(key)].head;
+
+  // Skip over locals belonging to callers further down the stack, and to
+  // the blocks of the top level code.
+  while (idx != NO_BINDING) {
+    Binding &binding = bindings_[idx];
+    if (binding.frame == frame_ || (binding.frame == 0 && binding.scope == 0)) {
+      is_local = binding.frame == frame_;
+      return value_of(binding);
+    }
+    idx = binding.shadowed;
+  }
+  is_local = false;
+  return nullptr;
+}
+
+Upvalue *Environment::Capture(Symbol key, ClosureArena &arena) {
+  Binding *binding = find_local(key);
+  if (binding == nullptr) {
+    return nullptr;
+  }
+  if (binding->cell == nullptr) {
+    binding->cell = arena.NewUpvalue(binding->val);
+  }
+  return binding->cell;
+}
+
+Environment::Binding *Environment::find_local(Symbol key) {
+  uint32_t idx = slots_[find_slot(key)].head;
+  while (idx != NO_BINDING) {
+    Binding &binding = bindings_[idx];
+    if (binding.frame == frame_) {
+      return &binding;
+    }
+    idx = binding.shadowed;
+  }
+  return nullptr;
+}
+
+size_t Environment::find_slot(Symbol key) const {
+  size_t mask = slots_.size() - 1;
+  size_t idx = hash(key) & mask;
+
+  while (slots_[idx].key != key && slots_[idx].key != NO_BINDING) {
+    idx = (idx + 1) & mask;
+  }
+  return idx;
+}
+
+void Environment::grow() {
+  std::vector<Slot> old = std::move(slots_);
+  slots_.assign(old.size() * 2, Slot{NO_BINDING, NO_BINDING});
+
+  for (const Slot &slot : old) {
+    if (slot.key != NO_BINDING) {
+      slots_[find_slot(slot.key)] = slot;
+    }
+  }
+}
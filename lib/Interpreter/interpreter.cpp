@@ -0,0 +1,542 @@
+#include "sif/Interpreter/interpreter.h"
+#include <cmath>
+
+using namespace sif;
+
+Interpreter::Interpreter(const SourceBuffer &source, StringInterner &interner,
+                         std::ostream &out)
+    : source_(source), interner_(interner), out_(out) {
+  call_depth_ = 0;
+  stack_base_ = 0;
+  error_ = std::nullopt;
+  closure_ = nullptr;
+  print_sym_ = interner_.Intern("print");
+  range_sym_ = interner_.Intern("range");
+}
+
+bool Interpreter::Run(const ProgramAST *program) {
+  char marker;
+  stack_base_ = reinterpret_cast<uintptr_t>(&marker);
+  for (const ASTNode *decl : program->blocks_) {
+    ExecStatus status = exec(decl);
+    if (status == ExecStatus::Error) {
+      return false;
+    } else if (status == ExecStatus::Return) {
+      // A top level return ends the program.
+      break;
+    }
+  }
+  return true;
+}
+
+Interpreter::ExecStatus Interpreter::exec(const ASTNode *node) {
+  switch (node->GetKind()) {
+  case ASTKind::Block: {
+    auto ast = static_cast<const BlockAST *>(node);
+    env_.PushScope();
+    ExecStatus status = exec_list(ast->decls_);
+    env_.PopScope();
+    return status;
+  }
+  case ASTKind::VarDecl: {
+    auto ast = static_cast<const VarDeclAST *>(node);
+    Value val;
+    if (ast->rhs_ != nullptr && !eval(ast->rhs_, val)) {
+      return ExecStatus::Error;
+    }
+    env_.Define(ast->ident_token_.GetSymbol(), val);
+    return ExecStatus::Normal;
+  }
+  case ASTKind::FnDecl:
+    exec_fn_decl(static_cast<const FnDeclAST *>(node));
+    return ExecStatus::Normal;
+  case ASTKind::IfStmt:
+    return exec_if(static_cast<const IfStmtAST *>(node));
+  case ASTKind::ForStmt:
+    return exec_for(static_cast<const ForStmtAST *>(node));
+  case ASTKind::ReturnStmt: {
+    auto ast = static_cast<const ReturnStmtAST *>(node);
+    ret_val_ = Value();
+    if (ast->ret_expr_ != nullptr && !eval(ast->ret_expr_, ret_val_)) {
+      return ExecStatus::Error;
+    }
+    return ExecStatus::Return;
+  }
+  case ASTKind::ExprStmt: {
+    auto ast = static_cast<const ExprStmtAST *>(node);
+    Value val;
+    return eval(ast->expr_, val) ? ExecStatus::Normal : ExecStatus::Error;
+  }
+  default: {
+    Value val;
+    return eval(node, val) ? ExecStatus::Normal : ExecStatus::Error;
+  }
+  }
+}
+
+Interpreter::ExecStatus Interpreter::exec_list(ASTList stmts) {
+  for (const ASTNode *stmt : stmts) {
+    ExecStatus status = exec(stmt);
+    if (status != ExecStatus::Normal) {
+      return status;
+    }
+  }
+  return ExecStatus::Normal;
+}
+
+void Interpreter::exec_fn_decl(const FnDeclAST *ast) {
+  Symbol sym = ast->ident_token_.GetSymbol();
+  ASTList captures = static_cast<const ParamListAST *>(ast->captures_)->params_;
+  if (captures.empty()) {
+    env_.Define(sym, Value::FromFn(ast));
+    return;
+  }
+
+  // Bind the name first, so that a function can capture itself.
+  env_.Define(sym, Value());
+  Closure *closure = closures_.NewClosure(ast, 0, captures.size());
+  for (size_t i = 0; i < captures.size(); i++) {
+    auto capture_ast = static_cast<const LiteralExprAST *>(captures[i]);
+    closure->upvals[i] = capture(capture_ast->lit_tkn_.GetSymbol());
+  }
+  *lookup(sym) = Value::FromClosure(closure);
+}
+
+Interpreter::ExecStatus Interpreter::exec_if(const IfStmtAST *ast) {
+  Value cond;
+  if (!eval(ast->cond_expr, cond)) {
+    return ExecStatus::Error;
+  }
+  if (cond.IsTruthy()) {
+    return exec(ast->if_stmts);
+  }
+
+  for (const ASTNode *node : ast->elif_exprs) {
+    auto elif = static_cast<const ElifStmtAST *>(node);
+    if (!eval(elif->cond_expr_, cond)) {
+      return ExecStatus::Error;
+    }
+    if (cond.IsTruthy()) {
+      return exec(elif->stmts_);
+    }
+  }
+
+  return exec_list(ast->else_stmts);
+}
+
+Interpreter::ExecStatus Interpreter::exec_for(const ForStmtAST *ast) {
+  ASTList vars = static_cast<const ParamListAST *>(ast->var_list_)->params_;
+  Token val_tkn = static_cast<const LiteralExprAST *>(vars.back())->lit_tkn_;
+  bool has_idx = vars.size() == 2;
+  Symbol idx_sym = 0;
+  if (has_idx) {
+    auto idx_ast = static_cast<const LiteralExprAST *>(vars[0]);
+    idx_sym = idx_ast->lit_tkn_.GetSymbol();
+  }
+
+  // The body's declarations run directly in the per-iteration scope that
+  // holds the loop variables, rather than in a second nested one.
+  ASTList body = static_cast<const BlockAST *>(ast->stmts_)->decls_;
+
+  // Iterate over a copy, so reassigning the iterated variable inside the
+  // loop does not change what is being iterated.
+  Value iterable;
+  if (!eval(ast->in_expr_list_, iterable)) {
+    return ExecStatus::Error;
+  }
+
+  double count = 0;
+  switch (iterable.Kind()) {
+  case ValueKind::Range: {
+    for (double i = iterable.RangeStart(); i < iterable.RangeEnd(); i++) {
+      env_.PushScope();
+      if (has_idx) {
+        env_.Define(idx_sym, Value::FromNumber(count));
+      }
+      env_.Define(val_tkn.GetSymbol(), Value::FromNumber(i));
+      ExecStatus status = exec_list(body);
+      if (status == ExecStatus::Normal && !deadline_.Check()) {
+        fail(RuntimeErrorKind::TimedOut, val_tkn);
+        status = ExecStatus::Error;
+      }
+      env_.PopScope();
+
+      if (status != ExecStatus::Normal) {
+        return status;
+      }
+      count++;
+    }
+    return ExecStatus::Normal;
+  }
+  case ValueKind::String: {
+    std::string_view str = iterable.GetString();
+    for (size_t i = 0; i < str.size(); i++) {
+      env_.PushScope();
+      if (has_idx) {
+        env_.Define(idx_sym, Value::FromNumber(count));
+      }
+      env_.Define(val_tkn.GetSymbol(), Value::FromString(str.substr(i, 1)));
+      ExecStatus status = exec_list(body);
+      if (status == ExecStatus::Normal && !deadline_.Check()) {
+        fail(RuntimeErrorKind::TimedOut, val_tkn);
+        status = ExecStatus::Error;
+      }
+      env_.PopScope();
+
+      if (status != ExecStatus::Normal) {
+        return status;
+      }
+      count++;
+    }
+    return ExecStatus::Normal;
+  }
+  default:
+    fail(RuntimeErrorKind::NotIterable, val_tkn);
+    return ExecStatus::Error;
+  }
+}
+
+bool Interpreter::eval(const ASTNode *node, Value &result) {
+  switch (node->GetKind()) {
+  case ASTKind::LiteralExpr:
+    return eval_literal(static_cast<const LiteralExprAST *>(node), result);
+  case ASTKind::BinaryExpr:
+    return eval_binary(static_cast<const BinaryExprAST *>(node), result);
+  case ASTKind::UnaryExpr:
+    return eval_unary(static_cast<const UnaryExprAST *>(node), result);
+  case ASTKind::VarAssignExpr:
+    return eval_assign(static_cast<const VarAssignAST *>(node), result);
+  case ASTKind::FnCallExpr:
+    return eval_call(static_cast<const FnCallExprAST *>(node), result);
+  case ASTKind::TableAccess:
+    return fail(RuntimeErrorKind::UnsupportedExpr,
+                static_cast<const TableAccessAST *>(node)->table_tkn_);
+  case ASTKind::ArrayAccess:
+    return fail(RuntimeErrorKind::UnsupportedExpr,
+                static_cast<const ArrayAccessAST *>(node)->array_tkn_);
+  case ASTKind::ArrayMutExpr:
+    return fail(RuntimeErrorKind::UnsupportedExpr,
+                static_cast<const ArrayMutExprAST *>(node)->array_tkn_);
+  default:
+    // Table and array literals carry no token to point at.
+    return fail(RuntimeErrorKind::UnsupportedExpr, Token());
+  }
+}
+
+bool Interpreter::eval_literal(const LiteralExprAST *ast, Value &result) {
+  Token tkn = ast->lit_tkn_;
+
+  switch (tkn.GetKind()) {
+  case TokenKind::NumberLiteral:
+    result = Value::FromNumber(ast->GetNumber());
+    return true;
+  case TokenKind::StringLiteral:
+    // Long literals point straight into the interner, which outlives us.
+    result = Value::FromString(interner_.Lookup(tkn.GetSymbol()));
+    return true;
+  case TokenKind::True:
+    result = Value::FromBool(true);
+    return true;
+  case TokenKind::False:
+    result = Value::FromBool(false);
+    return true;
+  case TokenKind::Identifier: {
+    Value *val = lookup(tkn.GetSymbol());
+    if (val == nullptr) {
+      return fail(RuntimeErrorKind::UndefinedSymbol, tkn);
+    }
+    result = *val;
+    return true;
+  }
+  default:
+    result = Value();
+    return true;
+  }
+}
+
+bool Interpreter::eval_binary(const BinaryExprAST *ast, Value &result) {
+  TokenKind op = ast->op_tkn_.GetKind();
+
+  Value lhs;
+  if (!eval(ast->lhs_, lhs)) {
+    return false;
+  }
+
+  // && and || short circuit, and always produce a bool.
+  if (op == TokenKind::DoubleAmpersand || op == TokenKind::DoublePipe) {
+    bool lhs_truthy = lhs.IsTruthy();
+    if (lhs_truthy == (op == TokenKind::DoublePipe)) {
+      result = Value::FromBool(lhs_truthy);
+      return true;
+    }
+
+    Value rhs;
+    if (!eval(ast->rhs_, rhs)) {
+      return false;
+    }
+    result = Value::FromBool(rhs.IsTruthy());
+    return true;
+  }
+
+  Value rhs;
+  if (!eval(ast->rhs_, rhs)) {
+    return false;
+  }
+
+  if (op == TokenKind::EqualEqual || op == TokenKind::BangEqual) {
+    result = Value::FromBool(lhs.Equals(rhs) == (op == TokenKind::EqualEqual));
+    return true;
+  }
+
+  if (lhs.Kind() == ValueKind::String && rhs.Kind() == ValueKind::String) {
+    std::string_view l = lhs.GetString();
+    std::string_view r = rhs.GetString();
+    switch (op) {
+    case TokenKind::Plus:
+      result = strings_.Concat(l, r);
+      return true;
+    case TokenKind::LessThan:
+      result = Value::FromBool(l < r);
+      return true;
+    case TokenKind::LessThanEqual:
+      result = Value::FromBool(l <= r);
+      return true;
+    case TokenKind::GreaterThan:
+      result = Value::FromBool(l > r);
+      return true;
+    case TokenKind::GreaterThanEqual:
+      result = Value::FromBool(l >= r);
+      return true;
+    default:
+      return fail(RuntimeErrorKind::TypeMismatch, ast->op_tkn_);
+    }
+  }
+
+  if (lhs.Kind() != ValueKind::Number || rhs.Kind() != ValueKind::Number) {
+    return fail(RuntimeErrorKind::TypeMismatch, ast->op_tkn_);
+  }
+
+  double l = lhs.GetNumber();
+  double r = rhs.GetNumber();
+  switch (op) {
+  case TokenKind::Plus:
+    result = Value::FromNumber(l + r);
+    return true;
+  case TokenKind::Minus:
+    result = Value::FromNumber(l - r);
+    return true;
+  case TokenKind::Star:
+    result = Value::FromNumber(l * r);
+    return true;
+  case TokenKind::Slash:
+    result = Value::FromNumber(l / r);
+    return true;
+  case TokenKind::Percent:
+    result = Value::FromNumber(std::fmod(l, r));
+    return true;
+  case TokenKind::LessThan:
+    result = Value::FromBool(l < r);
+    return true;
+  case TokenKind::LessThanEqual:
+    result = Value::FromBool(l <= r);
+    return true;
+  case TokenKind::GreaterThan:
+    result = Value::FromBool(l > r);
+    return true;
+  case TokenKind::GreaterThanEqual:
+    result = Value::FromBool(l >= r);
+    return true;
+  default:
+    return fail(RuntimeErrorKind::TypeMismatch, ast->op_tkn_);
+  }
+}
+
+bool Interpreter::eval_unary(const UnaryExprAST *ast, Value &result) {
+  Value rhs;
+  if (!eval(ast->rhs_, rhs)) {
+    return false;
+  }
+
+  if (ast->op_tkn_.GetKind() == TokenKind::Bang) {
+    result = Value::FromBool(!rhs.IsTruthy());
+    return true;
+  }
+
+  if (rhs.Kind() != ValueKind::Number) {
+    return fail(RuntimeErrorKind::TypeMismatch, ast->op_tkn_);
+  }
+  result = Value::FromNumber(-rhs.GetNumber());
+  return true;
+}
+
+bool Interpreter::eval_assign(const VarAssignAST *ast, Value &result) {
+  if (!eval(ast->rhs_, result)) {
+    return false;
+  }
+
+  // Look the variable up only after evaluating the rhs, which may define
+  // bindings of its own and invalidate the pointer.
+  Value *val = lookup(ast->ident_tkn_.GetSymbol());
+  if (val == nullptr) {
+    return fail(RuntimeErrorKind::UndefinedSymbol, ast->ident_tkn_);
+  }
+  *val = result;
+  return true;
+}
+
+bool Interpreter::eval_call(const FnCallExprAST *ast, Value &result) {
+  if (ast->is_std_) {
+    return eval_std_call(ast, result);
+  }
+
+  // As on the VM, the callee is looked up before the arguments are
+  // evaluated, but only checked after.
+  Value *found = lookup(ast->fn_ident_tkn_.GetSymbol());
+  if (found == nullptr) {
+    return fail(RuntimeErrorKind::UndefinedSymbol, ast->fn_ident_tkn_);
+  }
+  Value callee = *found;
+
+  size_t base = args_.size();
+  if (!eval_args(ast->fn_params_)) {
+    return false;
+  }
+  const Closure *closure = nullptr;
+  const FnDeclAST *fn;
+  if (callee.Kind() == ValueKind::Fn) {
+    fn = callee.GetFn();
+  } else if (callee.Kind() == ValueKind::Closure) {
+    closure = callee.GetClosure();
+    fn = closure->fn;
+  } else {
+    return fail(RuntimeErrorKind::NotCallable, ast->fn_ident_tkn_);
+  }
+  ASTList params = static_cast<const ParamListAST *>(fn->params_)->params_;
+  if (params.size() != ast->fn_params_.size()) {
+    return fail(RuntimeErrorKind::WrongArgCount, ast->fn_ident_tkn_);
+  }
+  // The stack grows down on every platform sif runs on.
+  char marker;
+  size_t stack_used = stack_base_ - reinterpret_cast<uintptr_t>(&marker);
+  if (call_depth_ == MAX_CALL_DEPTH || stack_used > MAX_STACK_BYTES) {
+    return fail(RuntimeErrorKind::StackOverflow, ast->fn_ident_tkn_);
+  }
+  if (!deadline_.Check()) {
+    return fail(RuntimeErrorKind::TimedOut, ast->fn_ident_tkn_);
+  }
+
+  call_depth_++;
+  const Closure *caller_closure = closure_;
+  closure_ = closure;
+  env_.PushFrame();
+  for (size_t i = 0; i < params.size(); i++) {
+    auto param = static_cast<const LiteralExprAST *>(params[i]);
+    env_.Define(param->lit_tkn_.GetSymbol(), args_[base + i]);
+  }
+  args_.resize(base);
+
+  ExecStatus status = exec(fn->body_);
+  env_.PopFrame();
+  closure_ = caller_closure;
+  call_depth_--;
+
+  if (status == ExecStatus::Error) {
+    return false;
+  }
+  result = status == ExecStatus::Return ? ret_val_ : Value();
+  return true;
+}
+
+bool Interpreter::eval_std_call(const FnCallExprAST *ast, Value &result) {
+  Symbol sym = ast->fn_ident_tkn_.GetSymbol();
+  size_t base = args_.size();
+  size_t count = ast->fn_params_.size();
+  if (!eval_args(ast->fn_params_)) {
+    return false;
+  }
+
+  result = Value();
+  if (sym == print_sym_) {
+    for (size_t i = 0; i < count; i++) {
+      if (i != 0) {
+        out_ << ' ';
+      }
+      args_[base + i].Print(out_);
+    }
+    out_ << '\n';
+  } else if (sym == range_sym_) {
+    // range(end) or range(start, end)
+    if (count != 1 && count != 2) {
+      args_.resize(base);
+      return fail(RuntimeErrorKind::WrongArgCount, ast->fn_ident_tkn_);
+    }
+    for (size_t i = 0; i < count; i++) {
+      if (args_[base + i].Kind() != ValueKind::Number) {
+        args_.resize(base);
+        return fail(RuntimeErrorKind::TypeMismatch, ast->fn_ident_tkn_);
+      }
+    }
+
+    double start = count == 2 ? args_[base].GetNumber() : 0;
+    double end = args_[base + count - 1].GetNumber();
+    result = Value::FromRange(start, end);
+  }
+
+  args_.resize(base);
+  return true;
+}
+
+bool Interpreter::eval_args(ASTList args) {
+  size_t base = args_.size();
+  for (const ASTNode *arg : args) {
+    Value val;
+    if (!eval(arg, val)) {
+      args_.resize(base);
+      return false;
+    }
+    args_.push_back(val);
+  }
+  return true;
+}
+
+// The parser has already resolved every name, so a name that is neither a
+// local of the running function nor one it captured is a global.
+Value *Interpreter::lookup(Symbol sym) {
+  bool is_local;
+  Value *val = env_.Lookup(sym, is_local);
+  if (is_local || closure_ == nullptr) {
+    return val;
+  }
+
+  Upvalue *upval = captured(sym);
+  return upval != nullptr ? upval->loc : val;
+}
+
+// A function captures either a local of the code that declares it, or a
+// variable which that code itself captured.
+Upvalue *Interpreter::capture(Symbol sym) {
+  Upvalue *upval = env_.Capture(sym, closures_);
+  return upval != nullptr ? upval : captured(sym);
+}
+
+Upvalue *Interpreter::captured(Symbol sym) {
+  if (closure_ == nullptr) {
+    return nullptr;
+  }
+
+  ASTList captures =
+      static_cast<const ParamListAST *>(closure_->fn->captures_)->params_;
+  for (size_t i = 0; i < captures.size(); i++) {
+    auto capture_ast = static_cast<const LiteralExprAST *>(captures[i]);
+    if (capture_ast->lit_tkn_.GetSymbol() == sym) {
+      return closure_->upvals[i];
+    }
+  }
+  return nullptr;
+}
+
+bool Interpreter::fail(RuntimeErrorKind kind, Token tkn) {
+  auto loc = source_.Locate(tkn.GetOffset());
+  error_ = RuntimeError(kind, loc.line, loc.col);
+  return false;
+}
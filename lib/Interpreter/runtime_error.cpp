@@ -0,0 +1,38 @@
+#include "sif/Interpreter/runtime_error.h"
+#include <string>
+
+using namespace sif;
+
+std::string RuntimeError::error_to_msg() {
+  std::string msg;
+  switch (kind_) {
+  case RuntimeErrorKind::UndefinedSymbol:
+    msg = "undefined symbol";
+    break;
+  case RuntimeErrorKind::TypeMismatch:
+    msg = "operand has the wrong type";
+    break;
+  case RuntimeErrorKind::NotCallable:
+    msg = "value is not a function";
+    break;
+  case RuntimeErrorKind::WrongArgCount:
+    msg = "wrong number of arguments";
+    break;
+  case RuntimeErrorKind::NotIterable:
+    msg = "value cannot be iterated over";
+    break;
+  case RuntimeErrorKind::StackOverflow:
+    msg = "calls are nested too deeply";
+    break;
+  case RuntimeErrorKind::TimedOut:
+    msg = "program ran for too long";
+    break;
+  case RuntimeErrorKind::UnsupportedExpr:
+    msg = "tables and arrays are not supported";
+    break;
+  }
+
+  // Lines and columns are stored zero based.
+  return msg + " at line " + std::to_string(line_ + 1) + ", column " +
+         std::to_string(pos_ + 1);
+}
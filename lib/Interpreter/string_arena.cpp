@@ -0,0 +1,47 @@
+#include "sif/Interpreter/string_arena.h"
+#include <algorithm>
+#include <cstring>
+
+using namespace sif;
+
+namespace {
+const size_t CHUNK_SIZE = 64 * 1024;
+} // namespace
+
+Value StringArena::Concat(std::string_view lhs, std::string_view rhs) {
+  size_t size = lhs.size() + rhs.size();
+  if (size <= Value::SMALL_STRING_MAX) {
+    char buf[Value::SMALL_STRING_MAX];
+    std::memcpy(buf, lhs.data(), lhs.size());
+    std::memcpy(buf + lhs.size(), rhs.data(), rhs.size());
+    return Value::FromString(std::string_view(buf, size));
+  }
+
+  size_t avail = static_cast<size_t>(chunk_end_ - chunk_curr_);
+
+  // Building a string up in a loop appends to the string made last. When
+  // lhs ends exactly where the current chunk's free space starts, extend
+  // it in place instead of copying it again. Values carry their own
+  // length, so anything still holding the shorter string is unaffected.
+  if (!chunks_.empty() && lhs.data() >= chunks_.back().get() &&
+      lhs.data() + lhs.size() == chunk_curr_ && avail >= rhs.size()) {
+    std::memcpy(chunk_curr_, rhs.data(), rhs.size());
+    chunk_curr_ += rhs.size();
+    return Value::FromString(std::string_view(lhs.data(), size));
+  }
+
+  if (avail < size) {
+    // Leave room to keep appending, so repeated concatenation stays
+    // linear overall.
+    size_t chunk_size = std::max(CHUNK_SIZE, size * 2);
+    chunks_.push_back(std::unique_ptr<char[]>(new char[chunk_size]));
+    chunk_curr_ = chunks_.back().get();
+    chunk_end_ = chunk_curr_ + chunk_size;
+  }
+
+  char *dest = chunk_curr_;
+  std::memcpy(dest, lhs.data(), lhs.size());
+  std::memcpy(dest + lhs.size(), rhs.data(), rhs.size());
+  chunk_curr_ += size;
+  return Value::FromString(std::string_view(dest, size));
+}
@@ -0,0 +1,78 @@
+#include "sif/Interpreter/value.h"
+#include <cmath>
+#include <cstring>
+
+using namespace sif;
+
+Value Value::FromString(std::string_view str) {
+  Value val;
+  val.kind_ = ValueKind::String;
+
+  if (str.size() <= SMALL_STRING_MAX) {
+    std::memcpy(val.small_, str.data(), str.size());
+    val.small_len_ = static_cast<uint8_t>(str.size());
+    if (str.empty()) {
+      val.str_ = StringRef{nullptr, 0};
+    }
+  } else {
+    val.str_ = StringRef{str.data(), str.size()};
+  }
+  return val;
+}
+
+bool Value::Equals(const Value &other) const {
+  if (kind_ != other.kind_) {
+    return false;
+  }
+
+  switch (kind_) {
+  case ValueKind::Nil:
+    return true;
+  case ValueKind::Bool:
+    return bool_ == other.bool_;
+  case ValueKind::Number:
+    return num_ == other.num_;
+  case ValueKind::String:
+    return GetString() == other.GetString();
+  case ValueKind::Fn:
+    return fn_ == other.fn_;
+  case ValueKind::CompiledFn:
+    return proto_ == other.proto_;
+  case ValueKind::Closure:
+    return closure_ == other.closure_;
+  case ValueKind::Range:
+    return range_.start == other.range_.start &&
+           range_.end == other.range_.end;
+  }
+  return false;
+}
+
+void Value::Print(std::ostream &out) const {
+  switch (kind_) {
+  case ValueKind::Nil:
+    out << "nil";
+    break;
+  case ValueKind::Bool:
+    out << (bool_ ? "true" : "false");
+    break;
+  case ValueKind::Number:
+    // Print whole numbers without a fractional part or exponent.
+    if (std::trunc(num_) == num_ && std::fabs(num_) < 9007199254740992.0) {
+      out << static_cast<int64_t>(num_);
+    } else {
+      out << num_;
+    }
+    break;
+  case ValueKind::String:
+    out << GetString();
+    break;
+  case ValueKind::Fn:
+  case ValueKind::CompiledFn:
+  case ValueKind::Closure:
+    out << "<fn>";
+    break;
+  case ValueKind::Range:
+    out << "<range>";
+    break;
+  }
+}
@@ -0,0 +1,62 @@
+#include "sif/Parser/ast_context.h"
+#include <cstdint>
+#include <cstdlib>
+
+using namespace sif;
+
+namespace {
+uintptr_t align_up(const char *ptr, size_t align) {
+  uintptr_t addr = reinterpret_cast<uintptr_t>(ptr);
+  return (addr + align - 1) & ~(static_cast<uintptr_t>(align) - 1);
+}
+} // namespace
+
+void *ASTContext::allocate(size_t size, size_t align) {
+  uintptr_t aligned = align_up(curr_, align);
+
+  if (curr_ == nullptr || aligned + size > reinterpret_cast<uintptr_t>(end_)) {
+    // Slabs double in size so a large tree needs only a handful of them.
+    size_t slab_size = next_slab_size_;
+    while (slab_size < size + align) {
+      slab_size *= 2;
+    }
+    if (next_slab_size_ < MAX_SLAB_SIZE) {
+      next_slab_size_ *= 2;
+    }
+
+    char *slab = static_cast<char *>(std::malloc(slab_size));
+    if (slab == nullptr) {
+      throw std::bad_alloc();
+    }
+    slabs_.push_back(slab);
+    curr_ = slab;
+    end_ = slab + slab_size;
+    aligned = align_up(curr_, align);
+  }
+
+  curr_ = reinterpret_cast<char *>(aligned + size);
+  allocated_ += size;
+  return reinterpret_cast<void *>(aligned);
+}
+
+void ASTContext::Reset() {
+  if (slabs_.empty()) {
+    return;
+  }
+
+  // Keep the most recent slab, which is also the largest, so parsing the
+  // same program again does not go back to malloc.
+  char *keep = slabs_.back();
+  slabs_.pop_back();
+  release();
+  slabs_.push_back(keep);
+  curr_ = keep;
+  allocated_ = 0;
+}
+
+void ASTContext::release() {
+  for (char *slab : slabs_) {
+    std::free(slab);
+  }
+  slabs_.clear();
+}
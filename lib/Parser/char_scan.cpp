@@ -0,0 +1,208 @@
+#include "sif/Parser/char_scan.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define SIF_SCAN_X86 1
+#include <immintrin.h>
+#endif
+
+using namespace sif;
+
+namespace {
+typedef const char *(*ScanFn)(const char *, const char *);
+
+const char *scalar_skip(const char *curr, const char *end, uint8_t cls) {
+  while (curr < end && (char_classes[static_cast<uint8_t>(*curr)] & cls)) {
+    curr++;
+  }
+  return curr;
+}
+
+const char *skip_space_scalar(const char *curr, const char *end) {
+  return scalar_skip(curr, end, CharSpace);
+}
+
+const char *skip_alpha_scalar(const char *curr, const char *end) {
+  return scalar_skip(curr, end, CharAlpha);
+}
+
+template <bool Newline> bool is_code_stop(char c) {
+  return c == '"' || c == '#' || c == '/' || (Newline && c == '\n');
+}
+
+template <bool Newline>
+const char *skip_code_scalar(const char *curr, const char *end) {
+  while (curr < end && !is_code_stop<Newline>(*curr)) {
+    curr++;
+  }
+  return curr;
+}
+
+#ifdef SIF_SCAN_X86
+// The space and alpha kernels use the same trick to test a byte range with
+// signed compares: adding (128 - lo) maps [lo, lo + n) onto [-128, -128 + n),
+// so a single signed less-than tells us whether a byte is in range.
+
+// Matches ' ' and '\t' through '\r'.
+inline __m128i space_mask_sse2(__m128i chunk) {
+  __m128i spaces = _mm_cmpeq_epi8(chunk, _mm_set1_epi8(' '));
+  __m128i shifted = _mm_add_epi8(chunk, _mm_set1_epi8(128 - '\t'));
+  __m128i ctrl = _mm_cmplt_epi8(shifted, _mm_set1_epi8(-128 + 5));
+  return _mm_or_si128(spaces, ctrl);
+}
+
+// Matches 'a' through 'z' after folding upper case letters to lower case.
+inline __m128i alpha_mask_sse2(__m128i chunk) {
+  __m128i lower = _mm_or_si128(chunk, _mm_set1_epi8(0x20));
+  __m128i shifted = _mm_add_epi8(lower, _mm_set1_epi8(128 - 'a'));
+  return _mm_cmplt_epi8(shifted, _mm_set1_epi8(-128 + 26));
+}
+
+// Matches '"', '#' and '/', and '\n' too if Newline.
+template <bool Newline> inline __m128i code_stop_mask_sse2(__m128i chunk) {
+  __m128i stop = _mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8('"')),
+                              _mm_cmpeq_epi8(chunk, _mm_set1_epi8('#')));
+  stop = _mm_or_si128(stop, _mm_cmpeq_epi8(chunk, _mm_set1_epi8('/')));
+  if (Newline) {
+    stop = _mm_or_si128(stop, _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\n')));
+  }
+  return stop;
+}
+
+template <bool Newline>
+const char *skip_code_sse2(const char *curr, const char *end) {
+  while (end - curr >= 16) {
+    __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(curr));
+    unsigned hit = static_cast<unsigned>(
+        _mm_movemask_epi8(code_stop_mask_sse2<Newline>(chunk)));
+    if (hit != 0) {
+      return curr + __builtin_ctz(hit);
+    }
+    curr += 16;
+  }
+  return skip_code_scalar<Newline>(curr, end);
+}
+
+template <__m128i (*Mask)(__m128i), uint8_t Cls>
+const char *skip_sse2(const char *curr, const char *end) {
+  while (end - curr >= 16) {
+    __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(curr));
+    unsigned miss = ~static_cast<unsigned>(_mm_movemask_epi8(Mask(chunk))) &
+                    0xffffu;
+    if (miss != 0) {
+      return curr + __builtin_ctz(miss);
+    }
+    curr += 16;
+  }
+  return scalar_skip(curr, end, Cls);
+}
+
+__attribute__((target("avx2"))) inline __m256i space_mask_avx2(__m256i chunk) {
+  __m256i spaces = _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8(' '));
+  __m256i shifted = _mm256_add_epi8(chunk, _mm256_set1_epi8(128 - '\t'));
+  __m256i ctrl = _mm256_cmpgt_epi8(_mm256_set1_epi8(-128 + 5), shifted);
+  return _mm256_or_si256(spaces, ctrl);
+}
+
+__attribute__((target("avx2"))) inline __m256i alpha_mask_avx2(__m256i chunk) {
+  __m256i lower = _mm256_or_si256(chunk, _mm256_set1_epi8(0x20));
+  __m256i shifted = _mm256_add_epi8(lower, _mm256_set1_epi8(128 - 'a'));
+  return _mm256_cmpgt_epi8(_mm256_set1_epi8(-128 + 26), shifted);
+}
+
+__attribute__((target("avx2"))) const char *
+skip_space_avx2(const char *curr, const char *end) {
+  while (end - curr >= 32) {
+    __m256i chunk =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(curr));
+    unsigned miss =
+        ~static_cast<unsigned>(_mm256_movemask_epi8(space_mask_avx2(chunk)));
+    if (miss != 0) {
+      return curr + __builtin_ctz(miss);
+    }
+    curr += 32;
+  }
+  return skip_sse2<space_mask_sse2, CharSpace>(curr, end);
+}
+
+__attribute__((target("avx2"))) const char *
+skip_alpha_avx2(const char *curr, const char *end) {
+  while (end - curr >= 32) {
+    __m256i chunk =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(curr));
+    unsigned miss =
+        ~static_cast<unsigned>(_mm256_movemask_epi8(alpha_mask_avx2(chunk)));
+    if (miss != 0) {
+      return curr + __builtin_ctz(miss);
+    }
+    curr += 32;
+  }
+  return skip_sse2<alpha_mask_sse2, CharAlpha>(curr, end);
+}
+
+template <bool Newline>
+__attribute__((target("avx2"))) const char *
+skip_code_avx2(const char *curr, const char *end) {
+  while (end - curr >= 32) {
+    __m256i chunk =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(curr));
+    __m256i stop =
+        _mm256_or_si256(_mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('"')),
+                        _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('#')));
+    stop = _mm256_or_si256(stop,
+                           _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('/')));
+    if (Newline) {
+      stop = _mm256_or_si256(
+          stop, _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('\n')));
+    }
+    unsigned hit = static_cast<unsigned>(_mm256_movemask_epi8(stop));
+    if (hit != 0) {
+      return curr + __builtin_ctz(hit);
+    }
+    curr += 32;
+  }
+  return skip_code_sse2<Newline>(curr, end);
+}
+#endif
+
+struct ScanKernels {
+  ScanFn skip_space;
+  ScanFn skip_alpha;
+  ScanFn skip_code;
+  ScanFn skip_code_line;
+};
+
+ScanKernels select_kernels() {
+#ifdef SIF_SCAN_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) {
+    return ScanKernels{skip_space_avx2, skip_alpha_avx2,
+                       skip_code_avx2<false>, skip_code_avx2<true>};
+  }
+  if (__builtin_cpu_supports("sse2")) {
+    return ScanKernels{skip_sse2<space_mask_sse2, CharSpace>,
+                       skip_sse2<alpha_mask_sse2, CharAlpha>,
+                       skip_code_sse2<false>, skip_code_sse2<true>};
+  }
+#endif
+  return ScanKernels{skip_space_scalar, skip_alpha_scalar,
+                     skip_code_scalar<false>, skip_code_scalar<true>};
+}
+
+const ScanKernels kernels = select_kernels();
+} // namespace
+
+const char *sif::skip_space_run(const char *curr, const char *end) {
+  return kernels.skip_space(curr, end);
+}
+
+const char *sif::skip_alpha_run(const char *curr, const char *end) {
+  return kernels.skip_alpha(curr, end);
+}
+
+const char *sif::skip_code_run(const char *curr, const char *end) {
+  return kernels.skip_code(curr, end);
+}
+
+const char *sif::skip_code_line_run(const char *curr, const char *end) {
+  return kernels.skip_code_line(curr, end);
+}
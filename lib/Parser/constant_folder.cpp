@@ -0,0 +1,344 @@
+#include "sif/Parser/constant_folder.h"
+#include <cmath>
+
+using namespace sif;
+
+namespace {
+// Returns the node as a literal value, or null if it is anything else,
+// including an identifier.
+const LiteralExprAST *as_constant(const ASTNode *node) {
+  if (node->GetKind() != ASTKind::LiteralExpr) {
+    return nullptr;
+  }
+  auto ast = static_cast<const LiteralExprAST *>(node);
+  switch (ast->lit_tkn_.GetKind()) {
+  case TokenKind::NumberLiteral:
+  case TokenKind::StringLiteral:
+  case TokenKind::True:
+  case TokenKind::False:
+    return ast;
+  default:
+    return nullptr;
+  }
+}
+
+bool is_number(const LiteralExprAST *ast) {
+  return ast != nullptr && ast->lit_tkn_.GetKind() == TokenKind::NumberLiteral;
+}
+
+// Only nil and false are falsy, and there is no nil literal.
+bool is_truthy(const LiteralExprAST *ast) {
+  return ast->lit_tkn_.GetKind() != TokenKind::False;
+}
+
+// Matches Value::Equals. Equal strings share a symbol.
+bool constants_equal(const LiteralExprAST *lhs, const LiteralExprAST *rhs) {
+  TokenKind kind = lhs->lit_tkn_.GetKind();
+  if (kind != rhs->lit_tkn_.GetKind()) {
+    return false;
+  }
+  switch (kind) {
+  case TokenKind::NumberLiteral:
+    return lhs->num_ == rhs->num_;
+  case TokenKind::StringLiteral:
+    return lhs->lit_tkn_.GetSymbol() == rhs->lit_tkn_.GetSymbol();
+  default:
+    return true;
+  }
+}
+
+// Whether the expression produces a number whenever it produces anything
+// at all, so that it is not changed by adding zero or multiplying by one.
+bool yields_number(const ASTNode *node) {
+  switch (node->GetKind()) {
+  case ASTKind::LiteralExpr:
+    return is_number(static_cast<const LiteralExprAST *>(node));
+  case ASTKind::UnaryExpr:
+    return static_cast<const UnaryExprAST *>(node)->op_tkn_.GetKind() ==
+           TokenKind::Minus;
+  case ASTKind::BinaryExpr: {
+    auto ast = static_cast<const BinaryExprAST *>(node);
+    switch (ast->op_tkn_.GetKind()) {
+    case TokenKind::Minus:
+    case TokenKind::Star:
+    case TokenKind::Slash:
+    case TokenKind::Percent:
+      return true;
+    case TokenKind::Plus:
+      // + also joins strings.
+      return yields_number(ast->lhs_) && yields_number(ast->rhs_);
+    default:
+      return false;
+    }
+  }
+  default:
+    return false;
+  }
+}
+
+// Whether the expression always produces a bool.
+bool yields_bool(const ASTNode *node) {
+  switch (node->GetKind()) {
+  case ASTKind::LiteralExpr: {
+    TokenKind kind =
+        static_cast<const LiteralExprAST *>(node)->lit_tkn_.GetKind();
+    return kind == TokenKind::True || kind == TokenKind::False;
+  }
+  case ASTKind::UnaryExpr:
+    return static_cast<const UnaryExprAST *>(node)->op_tkn_.GetKind() ==
+           TokenKind::Bang;
+  case ASTKind::BinaryExpr:
+    switch (static_cast<const BinaryExprAST *>(node)->op_tkn_.GetKind()) {
+    case TokenKind::EqualEqual:
+    case TokenKind::BangEqual:
+    case TokenKind::LessThan:
+    case TokenKind::LessThanEqual:
+    case TokenKind::GreaterThan:
+    case TokenKind::GreaterThanEqual:
+    case TokenKind::DoubleAmpersand:
+    case TokenKind::DoublePipe:
+      return true;
+    default:
+      return false;
+    }
+  default:
+    return false;
+  }
+}
+} // namespace
+
+void ConstantFolder::Fold(ProgramAST *program) { fold(program); }
+
+ASTNode *ConstantFolder::fold(ASTNode *node) {
+  if (node == nullptr) {
+    return nullptr;
+  }
+
+  switch (node->GetKind()) {
+  case ASTKind::Program:
+    fold_list(static_cast<ProgramAST *>(node)->blocks_);
+    return node;
+  case ASTKind::Block:
+    fold_list(static_cast<BlockAST *>(node)->decls_);
+    return node;
+  case ASTKind::IfStmt: {
+    auto ast = static_cast<IfStmtAST *>(node);
+    ast->cond_expr = fold(ast->cond_expr);
+    ast->if_stmts = fold(ast->if_stmts);
+    fold_list(ast->elif_exprs);
+    fold_list(ast->else_stmts);
+    return node;
+  }
+  case ASTKind::ElifStmt: {
+    auto ast = static_cast<ElifStmtAST *>(node);
+    ast->cond_expr_ = fold(ast->cond_expr_);
+    ast->stmts_ = fold(ast->stmts_);
+    return node;
+  }
+  case ASTKind::ForStmt: {
+    auto ast = static_cast<ForStmtAST *>(node);
+    ast->in_expr_list_ = fold(ast->in_expr_list_);
+    ast->stmts_ = fold(ast->stmts_);
+    return node;
+  }
+  case ASTKind::ReturnStmt: {
+    auto ast = static_cast<ReturnStmtAST *>(node);
+    ast->ret_expr_ = fold(ast->ret_expr_);
+    return node;
+  }
+  case ASTKind::ExprStmt: {
+    auto ast = static_cast<ExprStmtAST *>(node);
+    ast->expr_ = fold(ast->expr_);
+    return node;
+  }
+  case ASTKind::VarDecl: {
+    auto ast = static_cast<VarDeclAST *>(node);
+    ast->rhs_ = fold(ast->rhs_);
+    return node;
+  }
+  case ASTKind::FnDecl: {
+    auto ast = static_cast<FnDeclAST *>(node);
+    ast->body_ = fold(ast->body_);
+    return node;
+  }
+  case ASTKind::FnCallExpr:
+    fold_list(static_cast<FnCallExprAST *>(node)->fn_params_);
+    return node;
+  case ASTKind::VarAssignExpr: {
+    auto ast = static_cast<VarAssignAST *>(node);
+    ast->rhs_ = fold(ast->rhs_);
+    return node;
+  }
+  case ASTKind::TableAccess: {
+    auto ast = static_cast<TableAccessAST *>(node);
+    ast->index_ = fold(ast->index_);
+    return node;
+  }
+  case ASTKind::ArrayAccess: {
+    auto ast = static_cast<ArrayAccessAST *>(node);
+    ast->index_ = fold(ast->index_);
+    return node;
+  }
+  case ASTKind::ArrayMutExpr: {
+    auto ast = static_cast<ArrayMutExprAST *>(node);
+    ast->index_ = fold(ast->index_);
+    ast->rhs_ = fold(ast->rhs_);
+    return node;
+  }
+  case ASTKind::BinaryExpr:
+    return fold_binary(static_cast<BinaryExprAST *>(node));
+  case ASTKind::UnaryExpr:
+    return fold_unary(static_cast<UnaryExprAST *>(node));
+  default:
+    return node;
+  }
+}
+
+void ConstantFolder::fold_list(ASTList list) {
+  for (ASTNode *&node : list) {
+    node = fold(node);
+  }
+}
+
+ASTNode *ConstantFolder::fold_binary(BinaryExprAST *ast) {
+  ast->lhs_ = fold(ast->lhs_);
+  ast->rhs_ = fold(ast->rhs_);
+
+  Token op = ast->op_tkn_;
+  if (op.GetKind() == TokenKind::DoubleAmpersand ||
+      op.GetKind() == TokenKind::DoublePipe) {
+    return fold_logical(ast);
+  }
+
+  const LiteralExprAST *lhs = as_constant(ast->lhs_);
+  const LiteralExprAST *rhs = as_constant(ast->rhs_);
+  if (lhs == nullptr || rhs == nullptr) {
+    return fold_identity(ast);
+  }
+
+  if (op.GetKind() == TokenKind::EqualEqual) {
+    return make_bool(op, constants_equal(lhs, rhs));
+  }
+  if (op.GetKind() == TokenKind::BangEqual) {
+    return make_bool(op, !constants_equal(lhs, rhs));
+  }
+
+  // Everything else on strings, or on mixed kinds, is either a runtime
+  // error or builds a new string, and is left for the program to do.
+  if (!is_number(lhs) || !is_number(rhs)) {
+    return ast;
+  }
+
+  double l = lhs->num_;
+  double r = rhs->num_;
+  switch (op.GetKind()) {
+  case TokenKind::Plus:
+    return make_number(op, l + r);
+  case TokenKind::Minus:
+    return make_number(op, l - r);
+  case TokenKind::Star:
+    return make_number(op, l * r);
+  case TokenKind::Slash:
+    return make_number(op, l / r);
+  case TokenKind::Percent:
+    return make_number(op, std::fmod(l, r));
+  case TokenKind::LessThan:
+    return make_bool(op, l < r);
+  case TokenKind::LessThanEqual:
+    return make_bool(op, l <= r);
+  case TokenKind::GreaterThan:
+    return make_bool(op, l > r);
+  case TokenKind::GreaterThanEqual:
+    return make_bool(op, l >= r);
+  default:
+    return ast;
+  }
+}
+
+ASTNode *ConstantFolder::fold_logical(BinaryExprAST *ast) {
+  // Both operators produce a bool, so an operand can only stand in for the
+  // whole expression if it is a bool already.
+  bool is_and = ast->op_tkn_.GetKind() == TokenKind::DoubleAmpersand;
+  const LiteralExprAST *lhs = as_constant(ast->lhs_);
+  const LiteralExprAST *rhs = as_constant(ast->rhs_);
+
+  if (lhs != nullptr) {
+    // false && e and true || e never evaluate e.
+    if (is_truthy(lhs) != is_and) {
+      return make_bool(ast->op_tkn_, is_truthy(lhs));
+    }
+    if (rhs != nullptr) {
+      return make_bool(ast->op_tkn_, is_truthy(rhs));
+    }
+    if (yields_bool(ast->rhs_)) {
+      folded_++;
+      return ast->rhs_;
+    }
+    return ast;
+  }
+
+  // e && true and e || false are just e, but e && false still has to
+  // evaluate e.
+  if (rhs != nullptr && is_truthy(rhs) == is_and && yields_bool(ast->lhs_)) {
+    folded_++;
+    return ast->lhs_;
+  }
+  return ast;
+}
+
+ASTNode *ConstantFolder::fold_identity(BinaryExprAST *ast) {
+  TokenKind op = ast->op_tkn_.GetKind();
+  const LiteralExprAST *lhs = as_constant(ast->lhs_);
+  const LiteralExprAST *rhs = as_constant(ast->rhs_);
+
+  // Only e + -0 and e - 0 are exactly e. Adding a positive zero turns a
+  // negative zero positive, which 1 / e would show.
+  if (is_number(rhs) && yields_number(ast->lhs_)) {
+    bool is_zero = rhs->num_ == 0 &&
+                   ((op == TokenKind::Plus && std::signbit(rhs->num_)) ||
+                    (op == TokenKind::Minus && !std::signbit(rhs->num_)));
+    bool is_one = rhs->num_ == 1 &&
+                  (op == TokenKind::Star || op == TokenKind::Slash);
+    if (is_zero || is_one) {
+      folded_++;
+      return ast->lhs_;
+    }
+  }
+  if (is_number(lhs) && yields_number(ast->rhs_)) {
+    if ((op == TokenKind::Plus && lhs->num_ == 0 && std::signbit(lhs->num_)) ||
+        (op == TokenKind::Star && lhs->num_ == 1)) {
+      folded_++;
+      return ast->rhs_;
+    }
+  }
+  return ast;
+}
+
+ASTNode *ConstantFolder::fold_unary(UnaryExprAST *ast) {
+  ast->rhs_ = fold(ast->rhs_);
+
+  const LiteralExprAST *rhs = as_constant(ast->rhs_);
+  if (rhs == nullptr) {
+    return ast;
+  }
+  if (ast->op_tkn_.GetKind() == TokenKind::Bang) {
+    return make_bool(ast->op_tkn_, !is_truthy(rhs));
+  }
+  if (is_number(rhs)) {
+    return make_number(ast->op_tkn_, -rhs->num_);
+  }
+  return ast;
+}
+
+ASTNode *ConstantFolder::make_number(Token at, double num) {
+  folded_++;
+  Token tkn = Token(TokenKind::NumberLiteral, at.GetOffset(), at.GetLength());
+  return ctx_.Create<LiteralExprAST>(tkn, num);
+}
+
+ASTNode *ConstantFolder::make_bool(Token at, bool b) {
+  folded_++;
+  TokenKind kind = b ? TokenKind::True : TokenKind::False;
+  return ctx_.Create<LiteralExprAST>(
+      Token(kind, at.GetOffset(), at.GetLength()));
+}
@@ -0,0 +1,285 @@
+#include "sif/Parser/flat_ast.h"
+#include <cassert>
+
+using namespace sif;
+
+FlatAST FlatAST::FromTree(const ASTNode *root) {
+  FlatAST flat;
+  flat.flatten(root);
+  return flat;
+}
+
+ASTNode *FlatAST::ToTree(ASTContext &ctx) const {
+  if (kinds_.empty()) {
+    return nullptr;
+  }
+  return rebuild(Root(), ctx);
+}
+
+bool FlatAST::operator==(const FlatAST &other) const {
+  if (tokens_.size() != other.tokens_.size()) {
+    return false;
+  }
+  for (size_t i = 0; i < tokens_.size(); i++) {
+    Token lhs = tokens_[i];
+    Token rhs = other.tokens_[i];
+    if (lhs.GetKind() != rhs.GetKind() ||
+        lhs.GetOffset() != rhs.GetOffset() ||
+        lhs.GetLength() != rhs.GetLength() ||
+        lhs.GetSymbol() != rhs.GetSymbol()) {
+      return false;
+    }
+  }
+  return kinds_ == other.kinds_ && data_ == other.data_ &&
+         child_begin_ == other.child_begin_ &&
+         child_count_ == other.child_count_ &&
+         subtree_end_ == other.subtree_end_ &&
+         children_ == other.children_ && numbers_ == other.numbers_;
+}
+
+NodeId FlatAST::add_node(ASTKind kind, Token tkn, uint32_t data,
+                         size_t children) {
+  NodeId id = static_cast<NodeId>(kinds_.size());
+  kinds_.push_back(kind);
+  tokens_.push_back(tkn);
+  data_.push_back(data);
+  child_begin_.push_back(static_cast<uint32_t>(children_.size()));
+  child_count_.push_back(static_cast<uint32_t>(children));
+  subtree_end_.push_back(id + 1);
+
+  // The child range is reserved up front and filled in as each child is
+  // flattened, so a node's children stay contiguous in the side array.
+  children_.resize(children_.size() + children, NO_NODE);
+  return id;
+}
+
+NodeId FlatAST::flatten(const ASTNode *node) {
+  NodeId id;
+
+  switch (node->GetKind()) {
+  case ASTKind::Program: {
+    auto ast = static_cast<const ProgramAST *>(node);
+    id = add_node(ASTKind::Program, Token(), 0, ast->blocks_.size());
+    flatten_list(id, 0, ast->blocks_);
+    break;
+  }
+  case ASTKind::Block: {
+    auto ast = static_cast<const BlockAST *>(node);
+    id = add_node(ASTKind::Block, Token(), ast->scope_, ast->decls_.size());
+    flatten_list(id, 0, ast->decls_);
+    break;
+  }
+  case ASTKind::IfStmt: {
+    auto ast = static_cast<const IfStmtAST *>(node);
+    size_t elifs = ast->elif_exprs.size();
+    id = add_node(ASTKind::IfStmt, Token(), elifs,
+                  2 + elifs + ast->else_stmts.size());
+    flatten_child(id, 0, ast->cond_expr);
+    flatten_child(id, 1, ast->if_stmts);
+    flatten_list(id, 2, ast->elif_exprs);
+    flatten_list(id, 2 + elifs, ast->else_stmts);
+    break;
+  }
+  case ASTKind::ElifStmt: {
+    auto ast = static_cast<const ElifStmtAST *>(node);
+    id = add_node(ASTKind::ElifStmt, Token(), 0, 2);
+    flatten_child(id, 0, ast->cond_expr_);
+    flatten_child(id, 1, ast->stmts_);
+    break;
+  }
+  case ASTKind::ForStmt: {
+    auto ast = static_cast<const ForStmtAST *>(node);
+    id = add_node(ASTKind::ForStmt, Token(), 0, 3);
+    flatten_child(id, 0, ast->var_list_);
+    flatten_child(id, 1, ast->in_expr_list_);
+    flatten_child(id, 2, ast->stmts_);
+    break;
+  }
+  case ASTKind::ReturnStmt: {
+    auto ast = static_cast<const ReturnStmtAST *>(node);
+    id = add_node(ASTKind::ReturnStmt, Token(), 0, 1);
+    flatten_child(id, 0, ast->ret_expr_);
+    break;
+  }
+  case ASTKind::ExprStmt: {
+    auto ast = static_cast<const ExprStmtAST *>(node);
+    id = add_node(ASTKind::ExprStmt, Token(), 0, 1);
+    flatten_child(id, 0, ast->expr_);
+    break;
+  }
+  case ASTKind::VarDecl: {
+    auto ast = static_cast<const VarDeclAST *>(node);
+    id = add_node(ASTKind::VarDecl, ast->ident_token_, ast->is_global_, 1);
+    flatten_child(id, 0, ast->rhs_);
+    break;
+  }
+  case ASTKind::FnDecl: {
+    auto ast = static_cast<const FnDeclAST *>(node);
+    id = add_node(ASTKind::FnDecl, ast->ident_token_, ast->scope_, 3);
+    flatten_child(id, 0, ast->params_);
+    flatten_child(id, 1, ast->body_);
+    flatten_child(id, 2, ast->captures_);
+    break;
+  }
+  case ASTKind::FnParams: {
+    auto ast = static_cast<const ParamListAST *>(node);
+    id = add_node(ASTKind::FnParams, Token(), 0, ast->params_.size());
+    flatten_list(id, 0, ast->params_);
+    break;
+  }
+  case ASTKind::FnCallExpr: {
+    auto ast = static_cast<const FnCallExprAST *>(node);
+    id = add_node(ASTKind::FnCallExpr, ast->fn_ident_tkn_, ast->is_std_,
+                  ast->fn_params_.size());
+    flatten_list(id, 0, ast->fn_params_);
+    break;
+  }
+  case ASTKind::VarAssignExpr: {
+    auto ast = static_cast<const VarAssignAST *>(node);
+    id = add_node(ASTKind::VarAssignExpr, ast->ident_tkn_, ast->is_global_,
+                  1);
+    flatten_child(id, 0, ast->rhs_);
+    break;
+  }
+  case ASTKind::TableAccess: {
+    auto ast = static_cast<const TableAccessAST *>(node);
+    id = add_node(ASTKind::TableAccess, ast->table_tkn_, 0, 1);
+    flatten_child(id, 0, ast->index_);
+    break;
+  }
+  case ASTKind::ArrayAccess: {
+    auto ast = static_cast<const ArrayAccessAST *>(node);
+    id = add_node(ASTKind::ArrayAccess, ast->array_tkn_, 0, 1);
+    flatten_child(id, 0, ast->index_);
+    break;
+  }
+  case ASTKind::ArrayMutExpr: {
+    auto ast = static_cast<const ArrayMutExprAST *>(node);
+    id = add_node(ASTKind::ArrayMutExpr, ast->array_tkn_, 0, 2);
+    flatten_child(id, 0, ast->index_);
+    flatten_child(id, 1, ast->rhs_);
+    break;
+  }
+  case ASTKind::BinaryExpr: {
+    auto ast = static_cast<const BinaryExprAST *>(node);
+    id = add_node(ASTKind::BinaryExpr, ast->op_tkn_, 0, 2);
+    flatten_child(id, 0, ast->lhs_);
+    flatten_child(id, 1, ast->rhs_);
+    break;
+  }
+  case ASTKind::UnaryExpr: {
+    auto ast = static_cast<const UnaryExprAST *>(node);
+    id = add_node(ASTKind::UnaryExpr, ast->op_tkn_, 0, 1);
+    flatten_child(id, 0, ast->rhs_);
+    break;
+  }
+  case ASTKind::LiteralExpr: {
+    auto ast = static_cast<const LiteralExprAST *>(node);
+    uint32_t data = 0;
+    if (ast->lit_tkn_.GetKind() == TokenKind::NumberLiteral) {
+      numbers_.push_back(ast->num_);
+      data = static_cast<uint32_t>(numbers_.size());
+    }
+    id = add_node(ASTKind::LiteralExpr, ast->lit_tkn_, data, 0);
+    break;
+  }
+  default:
+    // Kinds without a node class in ast.h, and Empty, are kept as leaves.
+    id = add_node(node->GetKind(), Token(), 0, 0);
+    break;
+  }
+
+  subtree_end_[id] = static_cast<NodeId>(kinds_.size());
+  return id;
+}
+
+void FlatAST::flatten_child(NodeId parent, size_t idx, const ASTNode *child) {
+  assert(idx < child_count_[parent] && "child index out of range");
+  NodeId child_id = child == nullptr ? NO_NODE : flatten(child);
+  children_[child_begin_[parent] + idx] = child_id;
+}
+
+void FlatAST::flatten_list(NodeId parent, size_t first, ASTList list) {
+  for (size_t i = 0; i < list.size(); i++) {
+    flatten_child(parent, first + i, list[i]);
+  }
+}
+
+ASTNode *FlatAST::rebuild(NodeId id, ASTContext &ctx) const {
+  Token tkn = tokens_[id];
+  uint32_t data = data_[id];
+  size_t count = child_count_[id];
+
+  switch (kinds_[id]) {
+  case ASTKind::Program:
+    return ctx.Create<ProgramAST>(rebuild_list(id, 0, count, ctx));
+  case ASTKind::Block:
+    return ctx.Create<BlockAST>(rebuild_list(id, 0, count, ctx), data);
+  case ASTKind::IfStmt:
+    return ctx.Create<IfStmtAST>(rebuild_child(id, 0, ctx),
+                                 rebuild_child(id, 1, ctx),
+                                 rebuild_list(id, 2, data, ctx),
+                                 rebuild_list(id, 2 + data, count - 2 - data,
+                                              ctx));
+  case ASTKind::ElifStmt:
+    return ctx.Create<ElifStmtAST>(rebuild_child(id, 0, ctx),
+                                   rebuild_child(id, 1, ctx));
+  case ASTKind::ForStmt:
+    return ctx.Create<ForStmtAST>(rebuild_child(id, 0, ctx),
+                                  rebuild_child(id, 1, ctx),
+                                  rebuild_child(id, 2, ctx));
+  case ASTKind::ReturnStmt:
+    return ctx.Create<ReturnStmtAST>(rebuild_child(id, 0, ctx));
+  case ASTKind::ExprStmt:
+    return ctx.Create<ExprStmtAST>(rebuild_child(id, 0, ctx));
+  case ASTKind::VarDecl:
+    return ctx.Create<VarDeclAST>(tkn, data != 0, rebuild_child(id, 0, ctx));
+  case ASTKind::FnDecl:
+    return ctx.Create<FnDeclAST>(tkn, rebuild_child(id, 0, ctx),
+                                 rebuild_child(id, 1, ctx),
+                                 rebuild_child(id, 2, ctx), data);
+  case ASTKind::FnParams:
+    return ctx.Create<ParamListAST>(rebuild_list(id, 0, count, ctx));
+  case ASTKind::FnCallExpr:
+    return ctx.Create<FnCallExprAST>(tkn, rebuild_list(id, 0, count, ctx),
+                                     data != 0);
+  case ASTKind::VarAssignExpr:
+    return ctx.Create<VarAssignAST>(tkn, data != 0,
+                                    rebuild_child(id, 0, ctx));
+  case ASTKind::TableAccess:
+    return ctx.Create<TableAccessAST>(tkn, rebuild_child(id, 0, ctx));
+  case ASTKind::ArrayAccess:
+    return ctx.Create<ArrayAccessAST>(tkn, rebuild_child(id, 0, ctx));
+  case ASTKind::ArrayMutExpr:
+    return ctx.Create<ArrayMutExprAST>(tkn, rebuild_child(id, 0, ctx),
+                                       rebuild_child(id, 1, ctx));
+  case ASTKind::BinaryExpr:
+    return ctx.Create<BinaryExprAST>(tkn, rebuild_child(id, 0, ctx),
+                                     rebuild_child(id, 1, ctx));
+  case ASTKind::UnaryExpr:
+    return ctx.Create<UnaryExprAST>(tkn, rebuild_child(id, 0, ctx));
+  case ASTKind::LiteralExpr:
+    if (data != 0) {
+      return ctx.Create<LiteralExprAST>(tkn, numbers_[data - 1]);
+    }
+    return ctx.Create<LiteralExprAST>(tkn);
+  default:
+    return ctx.Create<EmptyAST>();
+  }
+}
+
+ASTNode *FlatAST::rebuild_child(NodeId id, size_t idx,
+                                ASTContext &ctx) const {
+  NodeId child_id = children_[child_begin_[id] + idx];
+  return child_id == NO_NODE ? nullptr : rebuild(child_id, ctx);
+}
+
+ASTList FlatAST::rebuild_list(NodeId id, size_t first, size_t count,
+                              ASTContext &ctx) const {
+  std::vector<ASTNode *> nodes;
+  nodes.reserve(count);
+  for (size_t i = 0; i < count; i++) {
+    nodes.push_back(rebuild_child(id, first + i, ctx));
+  }
+  return ctx.CreateList(nodes);
+}
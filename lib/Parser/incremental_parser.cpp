@@ -0,0 +1,666 @@
+#include "sif/Parser/incremental_parser.h"
+#include "sif/Parser/lexer.h"
+#include "sif/Parser/parse_result.h"
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <utility>
+
+using namespace sif;
+
+namespace {
+void shift_tokens(ASTNode *node, int64_t shift);
+
+void shift_token(Token &tkn, int64_t shift) {
+  tkn.SetOffset(static_cast<uint32_t>(tkn.GetOffset() + shift));
+}
+
+void shift_list(ASTList list, int64_t shift) {
+  for (ASTNode *node : list) {
+    shift_tokens(node, shift);
+  }
+}
+
+// Moves every token in the tree by shift bytes.
+void shift_tokens(ASTNode *node, int64_t shift) {
+  if (node == nullptr) {
+    return;
+  }
+
+  switch (node->GetKind()) {
+  case ASTKind::Block:
+    shift_list(static_cast<BlockAST *>(node)->decls_, shift);
+    break;
+  case ASTKind::IfStmt: {
+    auto ast = static_cast<IfStmtAST *>(node);
+    shift_tokens(ast->cond_expr, shift);
+    shift_tokens(ast->if_stmts, shift);
+    shift_list(ast->elif_exprs, shift);
+    shift_list(ast->else_stmts, shift);
+    break;
+  }
+  case ASTKind::ElifStmt: {
+    auto ast = static_cast<ElifStmtAST *>(node);
+    shift_tokens(ast->cond_expr_, shift);
+    shift_tokens(ast->stmts_, shift);
+    break;
+  }
+  case ASTKind::ForStmt: {
+    auto ast = static_cast<ForStmtAST *>(node);
+    shift_tokens(ast->var_list_, shift);
+    shift_tokens(ast->in_expr_list_, shift);
+    shift_tokens(ast->stmts_, shift);
+    break;
+  }
+  case ASTKind::ReturnStmt:
+    shift_tokens(static_cast<ReturnStmtAST *>(node)->ret_expr_, shift);
+    break;
+  case ASTKind::ExprStmt:
+    shift_tokens(static_cast<ExprStmtAST *>(node)->expr_, shift);
+    break;
+  case ASTKind::VarDecl: {
+    auto ast = static_cast<VarDeclAST *>(node);
+    shift_token(ast->ident_token_, shift);
+    shift_tokens(ast->rhs_, shift);
+    break;
+  }
+  case ASTKind::FnDecl: {
+    auto ast = static_cast<FnDeclAST *>(node);
+    shift_token(ast->ident_token_, shift);
+    shift_tokens(ast->params_, shift);
+    shift_tokens(ast->body_, shift);
+    shift_tokens(ast->captures_, shift);
+    break;
+  }
+  case ASTKind::FnParams:
+    shift_list(static_cast<ParamListAST *>(node)->params_, shift);
+    break;
+  case ASTKind::FnCallExpr: {
+    auto ast = static_cast<FnCallExprAST *>(node);
+    shift_token(ast->fn_ident_tkn_, shift);
+    shift_list(ast->fn_params_, shift);
+    break;
+  }
+  case ASTKind::VarAssignExpr: {
+    auto ast = static_cast<VarAssignAST *>(node);
+    shift_token(ast->ident_tkn_, shift);
+    shift_tokens(ast->rhs_, shift);
+    break;
+  }
+  case ASTKind::TableAccess: {
+    auto ast = static_cast<TableAccessAST *>(node);
+    shift_token(ast->table_tkn_, shift);
+    shift_tokens(ast->index_, shift);
+    break;
+  }
+  case ASTKind::ArrayAccess: {
+    auto ast = static_cast<ArrayAccessAST *>(node);
+    shift_token(ast->array_tkn_, shift);
+    shift_tokens(ast->index_, shift);
+    break;
+  }
+  case ASTKind::ArrayMutExpr: {
+    auto ast = static_cast<ArrayMutExprAST *>(node);
+    shift_token(ast->array_tkn_, shift);
+    shift_tokens(ast->index_, shift);
+    shift_tokens(ast->rhs_, shift);
+    break;
+  }
+  case ASTKind::BinaryExpr: {
+    auto ast = static_cast<BinaryExprAST *>(node);
+    shift_token(ast->op_tkn_, shift);
+    shift_tokens(ast->lhs_, shift);
+    shift_tokens(ast->rhs_, shift);
+    break;
+  }
+  case ASTKind::UnaryExpr: {
+    auto ast = static_cast<UnaryExprAST *>(node);
+    shift_token(ast->op_tkn_, shift);
+    shift_tokens(ast->rhs_, shift);
+    break;
+  }
+  case ASTKind::LiteralExpr:
+    shift_token(static_cast<LiteralExprAST *>(node)->lit_tkn_, shift);
+    break;
+  default:
+    // Program is never inside a declaration, and the other kinds have no
+    // tokens or children.
+    break;
+  }
+}
+
+// Whether two tokens are spelled the same and sit at the same distance
+// from their anchors.
+bool same_token(const SourceBuffer &old_source, Token old_tkn,
+                uint32_t old_anchor, const SourceBuffer &source, Token tkn,
+                uint32_t anchor) {
+  if (old_tkn.GetKind() != tkn.GetKind() ||
+      old_tkn.GetLength() != tkn.GetLength() ||
+      old_tkn.GetOffset() - old_anchor != tkn.GetOffset() - anchor) {
+    return false;
+  }
+  return std::memcmp(old_source.Text().data() + old_tkn.GetOffset(),
+                     source.Text().data() + tkn.GetOffset(),
+                     tkn.GetLength()) == 0;
+}
+
+bool continues_if(TokenKind kind) {
+  return kind == TokenKind::ElIf || kind == TokenKind::Else;
+}
+
+bool same_stores(const std::vector<SymbolEvent> &lhs,
+                 const std::vector<SymbolEvent> &rhs) {
+  return std::equal(lhs.begin(), lhs.end(), rhs.begin(), rhs.end(),
+                    [](const SymbolEvent &a, const SymbolEvent &b) {
+                      return a.key == b.key && a.kind == b.kind &&
+                             a.arity == b.arity;
+                    });
+}
+
+void add_stores(const std::vector<SymbolEvent> &events,
+                std::vector<SymbolEvent> &stores) {
+  for (const SymbolEvent &event : events) {
+    if (event.is_store) {
+      stores.push_back(event);
+    }
+  }
+}
+} // namespace
+
+IncrementalParser::IncrementalParser(StringInterner &interner)
+    : interner_(interner) {
+  program_ = nullptr;
+  live_bytes_ = 0;
+  parsed_decls_ = 0;
+  Parse(std::string());
+}
+
+void IncrementalParser::Parse(std::string text) {
+  decls_.clear();
+  lookups_.clear();
+  symbols_ = std::make_unique<SymbolTable>();
+  applied_ = 0;
+  errors_.clear();
+  program_ = nullptr;
+  live_bytes_ = 0;
+  ctx_.Reset();
+  reparse(SourceBuffer::FromString(std::move(text)), 0, 0, 0);
+}
+
+void IncrementalParser::Edit(size_t offset, size_t removed,
+                             std::string_view inserted) {
+  assert(offset + removed <= Source().Size() && "edit is out of range");
+  reparse(SourceBuffer::FromEdit(Source(), offset, removed, inserted), offset,
+          removed, inserted.size());
+  collect_garbage();
+}
+
+ProgramAST *IncrementalParser::Program() {
+  if (program_ != nullptr) {
+    return program_;
+  }
+
+  std::vector<ASTNode *> blocks;
+  blocks.reserve(decls_.size());
+  for (Decl &decl : decls_) {
+    if (decl.node == nullptr) {
+      continue;
+    }
+    if (decl.shift != 0) {
+      shift_tokens(decl.node, decl.shift);
+      decl.shift = 0;
+    }
+    blocks.push_back(decl.node);
+  }
+
+  program_ = ctx_.Create<ProgramAST>(ctx_.CreateList(blocks));
+  return program_;
+}
+
+void IncrementalParser::reparse(std::unique_ptr<SourceBuffer> source,
+                                size_t offset, size_t removed,
+                                size_t inserted) {
+  uint32_t edit_end = static_cast<uint32_t>(offset + removed);
+  int64_t delta =
+      static_cast<int64_t>(inserted) - static_cast<int64_t>(removed);
+  uint32_t size = static_cast<uint32_t>(source->Size());
+
+  // Declarations that never looked as far as the edit parse just as before.
+  // How far each one looked grows with its end, so they are a prefix.
+  auto affected = std::lower_bound(
+      decls_.begin(), decls_.end(), offset,
+      [](const Decl &decl, size_t offset) { return decl.end < offset; });
+  size_t first = static_cast<size_t>(affected - decls_.begin());
+  while (first > 0 && decls_[first - 1].lexed_end >= offset) {
+    first--;
+  }
+
+  // The new parse binds its symbols over those of the declarations before
+  // it, leaving them as they are for the next edit.
+  apply_symbols(first);
+  auto parser = std::make_unique<Parser>(
+      std::make_unique<Lexer>(std::move(source), interner_),
+      std::make_unique<SymbolTable>(symbols_.get()), ctx_);
+  SymbolTable &symtab = parser->Symbols();
+  uint32_t restart = first > 0 ? decls_[first - 1].end : 0;
+  parser->Seek(restart);
+
+  // The global declarations made since first by the old declarations passed
+  // over and by the new ones. While they are the same, the rest of the old
+  // parse is still valid. Once they differ, only the symbols in dirty may
+  // be bound differently from before.
+  std::vector<SymbolEvent> old_stores;
+  std::vector<SymbolEvent> new_stores;
+  std::vector<bool> dirty;
+  bool is_dirty = false;
+
+  // What replaces the old declarations from first up to next.
+  std::vector<Decl> region;
+  std::vector<size_t> parsed;
+  size_t next = first;
+  bool reached_end = true;
+  while (!parser->AtEnd()) {
+    uint32_t pos = parser->DeclOffset();
+
+    // Drop the old declarations that the new parse has gone past. Those
+    // that started inside the removed text are gone whatever happens.
+    Decl *candidate = nullptr;
+    while (next < decls_.size()) {
+      Decl &old = decls_[next];
+      int64_t begin = -1;
+      if (old.begin < offset) {
+        begin = old.begin;
+      } else if (old.begin >= edit_end) {
+        begin = old.begin + delta;
+      }
+      if (begin == pos) {
+        candidate = &old;
+        break;
+      }
+      if (begin > pos) {
+        break;
+      }
+
+      drop_decl(old);
+      if (is_dirty) {
+        mark_stores(old.symbols, dirty);
+      } else {
+        add_stores(old.symbols, old_stores);
+      }
+      next++;
+    }
+
+    if (candidate != nullptr) {
+      // Text from after the edit is unchanged, so a declaration there
+      // parses the same way if the symbols it looks up are the same.
+      bool moved = candidate->begin >= edit_end;
+      if (moved && !is_dirty) {
+        // A symbol that nothing looks up can be declared differently
+        // without changing how anything parses.
+        if (same_stores(old_stores, new_stores) ||
+            mark_stores(old_stores, dirty) + mark_stores(new_stores, dirty) ==
+                0) {
+          reached_end = false;
+          break;
+        }
+        is_dirty = true;
+      }
+
+      DeclSpan span;
+      bool same;
+      if (moved) {
+        span = DeclSpan{static_cast<uint32_t>(candidate->end + delta),
+                        static_cast<uint32_t>(candidate->lexed_end + delta)};
+        same = true;
+      } else {
+        same = same_tokens(parser_->GetLexer().Source(), *candidate,
+                           parser->GetLexer().Source(), pos, interner_,
+                           span);
+      }
+
+      if (same &&
+          symbols_match(*candidate, symtab, is_dirty ? &dirty : nullptr)) {
+        Decl decl = std::move(*candidate);
+        next++;
+        decl.shift += pos - static_cast<int64_t>(decl.begin);
+        decl.begin = pos;
+        decl.end = span.end;
+        decl.lexed_end = span.lexed_end;
+        replay_symbols(decl, symtab);
+        region.push_back(std::move(decl));
+        parser->Seek(span.end);
+        continue;
+      }
+    }
+
+    parse_decl(*parser, region);
+    parsed.push_back(region.size() - 1);
+    if (is_dirty) {
+      mark_stores(region.back().symbols, dirty);
+    } else {
+      add_stores(region.back().symbols, new_stores);
+    }
+  }
+
+  size_t last = next;
+  if (reached_end) {
+    for (; last < decls_.size(); last++) {
+      drop_decl(decls_[last]);
+    }
+
+    // Lexing stops at the first Eof, which may be short of the end of the
+    // text, such as at a string that is never closed. Whatever comes after
+    // decides where that is.
+    uint32_t eof = parser->DeclOffset();
+    for (Decl &decl : region) {
+      if (decl.lexed_end >= eof) {
+        decl.lexed_end = size;
+      }
+    }
+  }
+
+  // Malformed tokens are recorded by the lexer as it goes, including in
+  // declarations that were then skipped. Only those in the declarations
+  // just parsed are new.
+  std::vector<ParseError> lex_errors = parser->GetLexer().Errors();
+  size_t err = 0;
+  for (size_t idx : parsed) {
+    Decl &decl = region[idx];
+    while (err < lex_errors.size() && lex_errors[err].Offset() < decl.begin) {
+      err++;
+    }
+    for (; err < lex_errors.size() && lex_errors[err].Offset() < decl.end;
+         err++) {
+      decl.errors.push_back(DeclError{lex_errors[err].Kind(),
+                                      lex_errors[err].Offset() - decl.begin,
+                                      false});
+    }
+  }
+
+  parser_ = std::move(parser);
+  splice_errors(first, last, region, restart, delta);
+
+  // Everything after the region is unchanged but for where it is.
+  for (size_t i = last; i < decls_.size(); i++) {
+    Decl &decl = decls_[i];
+    decl.begin += delta;
+    decl.end += delta;
+    decl.lexed_end += delta;
+    decl.shift += delta;
+  }
+
+  size_t kept = std::min(last - first, region.size());
+  std::move(region.begin(), region.begin() + kept, decls_.begin() + first);
+  if (kept < region.size()) {
+    decls_.insert(decls_.begin() + first + kept,
+                  std::make_move_iterator(region.begin() + kept),
+                  std::make_move_iterator(region.end()));
+  } else {
+    decls_.erase(decls_.begin() + first + kept, decls_.begin() + last);
+  }
+
+  program_ = nullptr;
+  parsed_decls_ = parsed.size();
+}
+
+void IncrementalParser::parse_decl(Parser &parser, std::vector<Decl> &decls) {
+  Decl decl;
+  decl.begin = parser.DeclOffset();
+  decl.shift = 0;
+  size_t first_error = parser.Errors().size();
+  size_t bytes = ctx_.BytesAllocated();
+
+  parser.Symbols().SetLog(&decl.symbols);
+  ParseCallResult result = parser.ParseDecl();
+  parser.Symbols().SetLog(nullptr);
+
+  decl.end = parser.DeclOffset();
+  decl.lexed_end = static_cast<uint32_t>(parser.GetLexer().Offset());
+  decl.node = result.ast();
+  decl.node_bytes = ctx_.BytesAllocated() - bytes;
+  live_bytes_ += decl.node_bytes;
+  for (const SymbolEvent &event : decl.symbols) {
+    if (!event.is_store) {
+      if (event.key >= lookups_.size()) {
+        lookups_.resize(event.key + 1);
+      }
+      lookups_[event.key]++;
+    }
+  }
+
+  const std::vector<ParseError> &errors = parser.Errors();
+  for (size_t i = first_error; i < errors.size(); i++) {
+    uint32_t offset = errors[i].Offset();
+    if (offset < decl.end) {
+      decl.errors.push_back(
+          DeclError{errors[i].Kind(), offset - decl.begin, false});
+    } else {
+      decl.errors.push_back(
+          DeclError{errors[i].Kind(), offset - decl.end, true});
+    }
+  }
+  decls.push_back(std::move(decl));
+}
+
+void IncrementalParser::drop_decl(const Decl &decl) {
+  live_bytes_ -= decl.node_bytes;
+  for (const SymbolEvent &event : decl.symbols) {
+    if (!event.is_store) {
+      lookups_[event.key]--;
+    }
+  }
+}
+
+// Marks the symbols declared in events that some declaration looks up,
+// returning how many were not marked already.
+size_t IncrementalParser::mark_stores(const std::vector<SymbolEvent> &events,
+                                      std::vector<bool> &dirty) const {
+  size_t marked = 0;
+  for (const SymbolEvent &event : events) {
+    if (!event.is_store || event.key >= lookups_.size() ||
+        lookups_[event.key] == 0) {
+      continue;
+    }
+    if (event.key >= dirty.size()) {
+      dirty.resize(event.key + 1);
+    }
+    marked += !dirty[event.key];
+    dirty[event.key] = true;
+  }
+  return marked;
+}
+
+void IncrementalParser::splice_errors(size_t first, size_t last,
+                                      const std::vector<Decl> &region,
+                                      uint32_t restart, int64_t delta) {
+  // Errors are in source order, and Parser::Parse puts those of earlier
+  // declarations first where they share a place, as does this. So the
+  // errors of the declarations before first end at restart, after any that
+  // the one just before it found at its end.
+  size_t prefix_end = 0;
+  if (first > 0) {
+    prefix_end = static_cast<size_t>(
+        std::lower_bound(errors_.begin(), errors_.end(), restart,
+                         [](const ParseError &err, uint32_t offset) {
+                           return err.Offset() < offset;
+                         }) -
+        errors_.begin());
+    for (const DeclError &err : decls_[first - 1].errors) {
+      prefix_end += err.after_end && err.offset == 0;
+    }
+  }
+
+  // Likewise the errors of the declarations from last on start at its
+  // begin, after any that the one before it found there.
+  size_t suffix_begin = errors_.size();
+  if (last < decls_.size()) {
+    uint32_t begin = decls_[last].begin;
+    suffix_begin = static_cast<size_t>(
+        std::upper_bound(errors_.begin(), errors_.end(), begin,
+                         [](uint32_t offset, const ParseError &err) {
+                           return offset < err.Offset();
+                         }) -
+        errors_.begin());
+    for (const DeclError &err : decls_[last].errors) {
+      suffix_begin -= !err.after_end && err.offset == 0;
+    }
+  }
+
+  std::vector<std::pair<uint32_t, ParseErrorKind>> found;
+  for (const Decl &decl : region) {
+    for (const DeclError &err : decl.errors) {
+      uint32_t anchor = err.after_end ? decl.end : decl.begin;
+      found.push_back(std::make_pair(anchor + err.offset, err.kind));
+    }
+  }
+  std::stable_sort(found.begin(), found.end(),
+                   [](const std::pair<uint32_t, ParseErrorKind> &a,
+                      const std::pair<uint32_t, ParseErrorKind> &b) {
+                     return a.first < b.first;
+                   });
+
+  const SourceBuffer &source = Source();
+  std::vector<ParseError> errors;
+  errors.reserve(prefix_end + found.size() + errors_.size() - suffix_begin);
+  errors.insert(errors.end(), errors_.begin(), errors_.begin() + prefix_end);
+  for (const auto &[offset, kind] : found) {
+    auto loc = source.Locate(offset);
+    errors.push_back(ParseError(kind, offset, loc.line, loc.col));
+  }
+  for (size_t i = suffix_begin; i < errors_.size(); i++) {
+    uint32_t offset = static_cast<uint32_t>(errors_[i].Offset() + delta);
+    auto loc = source.Locate(offset);
+    errors.push_back(ParseError(errors_[i].Kind(), offset, loc.line, loc.col));
+  }
+  errors_ = std::move(errors);
+}
+
+void IncrementalParser::collect_garbage() {
+  size_t garbage = ctx_.BytesAllocated() - live_bytes_;
+  if (garbage < MIN_GARBAGE_BYTES || garbage < live_bytes_) {
+    return;
+  }
+  Parse(std::string(Source().Text()));
+}
+
+void IncrementalParser::apply_symbols(size_t count) {
+  for (; applied_ < count; applied_++) {
+    Decl &decl = decls_[applied_];
+    decl.shadowed.clear();
+    for (const SymbolEvent &event : decl.symbols) {
+      if (!event.is_store) {
+        continue;
+      }
+      const SymbolRecord *record = symbols_->Retrieve(event.key);
+      if (record == nullptr) {
+        decl.shadowed.push_back(SymbolEvent{event.key, true, false,
+                                            SymbolKind::Var, 0, nullptr});
+      } else {
+        decl.shadowed.push_back(SymbolEvent{event.key, true, true,
+                                            record->kind, record->arity,
+                                            record->node});
+      }
+      symbols_->Store(event.key, event.kind, event.arity, event.node);
+    }
+  }
+
+  // Undo the declarations past count newest first, so each symbol ends up
+  // as it was before the first of them.
+  for (; applied_ > count; applied_--) {
+    const Decl &decl = decls_[applied_ - 1];
+    for (auto it = decl.shadowed.rbegin(); it != decl.shadowed.rend(); ++it) {
+      if (it->found) {
+        symbols_->Store(it->key, it->kind, it->arity, it->node);
+      } else {
+        symbols_->Unbind(it->key);
+      }
+    }
+  }
+}
+
+bool IncrementalParser::same_tokens(const SourceBuffer &old_source,
+                                    const Decl &decl,
+                                    const SourceBuffer &source,
+                                    uint32_t begin, StringInterner &interner,
+                                    DeclSpan &span) {
+  const char *old_text = old_source.Text().data();
+  const char *text = source.Text().data();
+  Lexer old_lexer = Lexer(old_text, old_text + decl.begin,
+                          old_text + old_source.Size(), interner);
+  Lexer lexer = Lexer(text, text + begin, text + source.Size(), interner);
+
+  Token old_tkn = old_lexer.Lex();
+  Token tkn = lexer.Lex();
+  while (old_tkn.GetOffset() < decl.end) {
+    if (!same_token(old_source, old_tkn, decl.begin, source, tkn, begin)) {
+      return false;
+    }
+    old_tkn = old_lexer.Lex();
+    tkn = lexer.Lex();
+  }
+  span.end = tkn.GetOffset();
+
+  if (decl.node != nullptr) {
+    // A declaration that parsed only looked past its end to see whether an
+    // if statement carried on.
+    if (continues_if(old_tkn.GetKind()) != continues_if(tkn.GetKind())) {
+      return false;
+    }
+  } else {
+    // One that failed may have stopped at any token it looked at.
+    for (;;) {
+      if (!same_token(old_source, old_tkn, decl.end, source, tkn, span.end)) {
+        return false;
+      }
+      if (old_tkn.GetKind() == TokenKind::Eof ||
+          old_lexer.Offset() >= decl.lexed_end) {
+        break;
+      }
+      old_tkn = old_lexer.Lex();
+      tkn = lexer.Lex();
+    }
+  }
+
+  span.lexed_end = tkn.GetKind() == TokenKind::Eof
+                       ? static_cast<uint32_t>(source.Size())
+                       : static_cast<uint32_t>(lexer.Offset());
+  return true;
+}
+
+bool IncrementalParser::symbols_match(const Decl &decl, SymbolTable &symtab,
+                                      const std::vector<bool> *dirty) {
+  // A lookup of a symbol the declaration has already bound itself finds
+  // that binding whatever came before.
+  std::vector<Symbol> stored;
+  for (const SymbolEvent &event : decl.symbols) {
+    if (event.is_store) {
+      stored.push_back(event.key);
+      continue;
+    }
+    if (std::find(stored.begin(), stored.end(), event.key) != stored.end()) {
+      continue;
+    }
+    if (dirty != nullptr &&
+        (event.key >= dirty->size() || !(*dirty)[event.key])) {
+      continue;
+    }
+
+    const SymbolRecord *record = symtab.Retrieve(event.key);
+    if ((record != nullptr) != event.found) {
+      return false;
+    }
+    if (record != nullptr &&
+        (record->kind != event.kind || record->arity != event.arity)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void IncrementalParser::replay_symbols(const Decl &decl, SymbolTable &symtab) {
+  for (const SymbolEvent &event : decl.symbols) {
+    if (event.is_store) {
+      symtab.Store(event.key, event.kind, event.arity, event.node);
+    }
+  }
+}
@@ -1,317 +1,527 @@
 #include "sif/Parser/lexer.h"
+#include "sif/Parser/char_scan.h"
 #include "sif/Parser/reserved.h"
 #include "sif/Parser/token.h"
+#include <algorithm>
 #include <cassert>
-#include <cctype>
-#include <fstream>
-#include <iostream>
-#include <optional>
-#include <string>
-#include <vector>
+#include <charconv>
+#include <cstring>
+#include <string_view>
 
 using namespace sif;
 
-Lexer::Lexer(std::string filename) {
-  std::ifstream infile;
-  infile.open(filename);
+Lexer::Lexer(std::string filename, StringInterner &interner)
+    : Lexer(SourceBuffer::FromFile(filename), interner) {}
 
-  assert(infile.is_open() && "Failed to open file!");
+Lexer::Lexer(std::unique_ptr<SourceBuffer> source, StringInterner &interner)
+    : interner_(interner) {
+  assert(source != nullptr && "Failed to open file!");
 
-  std::vector<std::string> buffer;
-  std::string line;
-  while (getline(infile, line)) {
-    buffer.push_back(line.append("\n"));
-  }
-
-  infile.close();
-
-  buffer_ = buffer;
-  curr_char_ = std::optional<char>{buffer[0][0]};
-  curr_pos_ = 0;
-  curr_line_ = 0;
-  reserved_words_ = get_reserved_words();
+  source_ = std::move(source);
+  buf_start_ = source_->Text().data();
+  cur_ = buf_start_;
+  end_ = buf_start_ + source_->Size();
+  base_ = source_->Base();
+  streaming_ = source_->IsStream();
+  refillable_ = streaming_;
+  numbers_base_ = 0;
+  token_counts_.fill(0);
 };
 
+Lexer::Lexer(const char *buf_start, const char *begin, const char *end,
+             StringInterner &interner)
+    : interner_(interner) {
+  buf_start_ = buf_start;
+  cur_ = begin;
+  end_ = end;
+  base_ = 0;
+  streaming_ = false;
+  refillable_ = false;
+  numbers_base_ = 0;
+  token_counts_.fill(0);
+}
+
 Token Lexer::Lex() {
-  if (!curr_char_.has_value()) {
-    return Token(TokenKind::Eof, curr_pos_, curr_line_);
+  if (refillable_) {
+    return lex_streamed();
   }
+  return lex_token();
+}
 
-  skip_whitespace();
-  if (!curr_char_.has_value()) {
-    return Token(TokenKind::Eof, curr_pos_, curr_line_);
+void Lexer::Seek(size_t offset) {
+  assert(!streaming_ && "cannot seek in a stream");
+  cur_ = buf_start_ + offset;
+  while (!errors_.empty() && errors_.back().offset >= offset) {
+    errors_.pop_back();
   }
+}
 
-  while (curr_char_ == '#') {
-    // to handle comments, we move to the next line and advance
-    // the current char
-    next_line();
-    advance();
-    if (!curr_char_.has_value()) {
-      return Token(TokenKind::Eof, curr_pos_, curr_line_);
+size_t Lexer::LexBatch(Token *out, size_t max) {
+  size_t count = 0;
+  while (count < max) {
+    Token tkn = refillable_ ? lex_streamed() : lex_token();
+    out[count++] = tkn;
+    if (tkn.GetKind() == TokenKind::Eof) {
+      break;
     }
   }
+  return count;
+}
 
-  assert(curr_char_.has_value() &&
-         "Error: current character should have value");
+Token Lexer::lex_token() {
+  for (;;) {
+    skip_whitespace();
+    if (cur_ >= end_) {
+      return make_token(TokenKind::Eof, end_, end_);
+    }
 
-  char curr = curr_char_.value();
-  if (isdigit(curr)) {
+    // Comments run to the end of the line and may be followed by more
+    // whitespace or comments.
+    if (*cur_ == '#' || (*cur_ == '/' && cur_[1] == '/')) {
+      skip_line();
+    } else {
+      break;
+    }
+  }
+
+  char curr = *cur_;
+  if (is_digit(curr)) {
     return lex_num_lit();
-  } else if (isalpha(curr)) {
+  } else if (is_alpha(curr)) {
     return lex_ident();
   }
 
+  // Every case below may read one character past the current one. This is
+  // safe even at the last character because of the NUL sentinel.
   switch (curr) {
+  case '\0':
+    // Either the sentinel at the end of the buffer or a stray NUL, neither
+    // of which can start a token.
+    return make_token(TokenKind::Eof, cur_, cur_);
   case '(':
-    return consume(TokenKind::LeftParen);
+    return consume(TokenKind::LeftParen, 1);
   case ')':
-    return consume(TokenKind::RightParen);
+    return consume(TokenKind::RightParen, 1);
   case '{':
-    return consume(TokenKind::LeftBrace);
+    return consume(TokenKind::LeftBrace, 1);
   case '}':
-    return consume(TokenKind::RightBrace);
-  case '[': {
-    std::optional<char> next = peek();
-    if (next.has_value() && next.value() == '[') {
-      Token result = consume(TokenKind::DoubleLeftBracket);
-      advance();
-      return result;
-    } else {
-      return consume(TokenKind::LeftBracket);
+    return consume(TokenKind::RightBrace, 1);
+  case '[':
+    if (cur_[1] == '[') {
+      return consume(TokenKind::DoubleLeftBracket, 2);
     }
-  }
-  case ']': {
-    std::optional<char> next = peek();
-    if (next.has_value() && next.value() == ']') {
-      Token result = consume(TokenKind::DoubleRightBracket);
-      advance();
-      return result;
-    } else {
-      return consume(TokenKind::RightBracket);
+    return consume(TokenKind::LeftBracket, 1);
+  case ']':
+    if (cur_[1] == ']') {
+      return consume(TokenKind::DoubleRightBracket, 2);
     }
-  }
+    return consume(TokenKind::RightBracket, 1);
   case ';':
-    return consume(TokenKind::Semicolon);
+    return consume(TokenKind::Semicolon, 1);
   case '.':
-    return consume(TokenKind::Period);
+    return consume(TokenKind::Period, 1);
   case ',':
-    return consume(TokenKind::Comma);
+    return consume(TokenKind::Comma, 1);
   case '+':
-    return consume(TokenKind::Plus);
+    return consume(TokenKind::Plus, 1);
   case '-':
-    return consume(TokenKind::Minus);
+    return consume(TokenKind::Minus, 1);
   case '*':
-    return consume(TokenKind::Star);
+    return consume(TokenKind::Star, 1);
   case '%':
-    return consume(TokenKind::Percent);
+    return consume(TokenKind::Percent, 1);
   case '@':
-    return consume(TokenKind::At);
-  case '/': {
-    std::optional<char> next = peek();
-    if (next.has_value() && next.value() == '/') {
-      while (curr_char_.value() != '\n') {
-        advance();
-      }
-      return Lex();
-    } else {
-      return consume(TokenKind::Slash);
+    return consume(TokenKind::At, 1);
+  case '/':
+    return consume(TokenKind::Slash, 1);
+  case '=':
+    if (cur_[1] == '=') {
+      return consume(TokenKind::EqualEqual, 2);
+    } else if (cur_[1] == '>') {
+      return consume(TokenKind::EqualArrow, 2);
     }
-  }
-  case '=': {
-    std::optional<char> next = peek();
-    if (next.has_value() && next.value() == '=') {
-      Token result = consume(TokenKind::EqualEqual);
-      advance();
-      return result;
-    } else if (next.has_value() && next.value() == '>') {
-      Token result = consume(TokenKind::EqualArrow);
-      advance();
-      return result;
-    } else {
-      return consume(TokenKind::Equal);
-    }
-  }
-  case '<': {
-    std::optional<char> next = peek();
-    if (next.has_value() && next.value() == '=') {
-      Token result = consume(TokenKind::LessThanEqual);
-      advance();
-      return result;
-    } else {
-      return consume(TokenKind::LessThan);
+    return consume(TokenKind::Equal, 1);
+  case '<':
+    if (cur_[1] == '=') {
+      return consume(TokenKind::LessThanEqual, 2);
     }
-  }
-  case '>': {
-    std::optional<char> next = peek();
-    if (next.has_value() && next.value() == '=') {
-      Token result = consume(TokenKind::GreaterThanEqual);
-      advance();
-      return result;
-    } else {
-      return consume(TokenKind::GreaterThan);
+    return consume(TokenKind::LessThan, 1);
+  case '>':
+    if (cur_[1] == '=') {
+      return consume(TokenKind::GreaterThanEqual, 2);
     }
-  }
-  case '!': {
-    std::optional<char> next = peek();
-    if (next.has_value() && next.value() == '=') {
-      Token result = consume(TokenKind::BangEqual);
-      advance();
-      return result;
-    } else {
-      return consume(TokenKind::Bang);
+    return consume(TokenKind::GreaterThan, 1);
+  case '!':
+    if (cur_[1] == '=') {
+      return consume(TokenKind::BangEqual, 2);
     }
-  }
-  case '&': {
-    std::optional<char> next = peek();
-    if (next.has_value() && next.value() == '&') {
-      Token result = consume(TokenKind::DoubleAmpersand);
-      advance();
-      return result;
-    } else {
-      return consume(TokenKind::Ampersand);
+    return consume(TokenKind::Bang, 1);
+  case '&':
+    if (cur_[1] == '&') {
+      return consume(TokenKind::DoubleAmpersand, 2);
     }
-  }
-  case '|': {
-    std::optional<char> next = peek();
-    if (next.has_value() && next.value() == '|') {
-      Token result = consume(TokenKind::DoublePipe);
-      advance();
-      return result;
-    } else {
-      return consume(TokenKind::Pipe);
+    return consume(TokenKind::Ampersand, 1);
+  case '|':
+    if (cur_[1] == '|') {
+      return consume(TokenKind::DoublePipe, 2);
     }
-  }
+    return consume(TokenKind::Pipe, 1);
   case '"':
     return lex_str_lit();
   default:
-    return Token(TokenKind::Eof, 0, 0);
+    return make_token(TokenKind::Eof, cur_, cur_);
   }
 }
 
 Token Lexer::lex_str_lit() {
-  std::string literal;
-  int str_start = curr_pos_;
-  int str_line = curr_line_;
-
-  advance();
-
-  while (!finished()) {
-    // TODO: if no value here we need to return an error.
-    assert(curr_char_.has_value() && "current char should have a value!");
-    switch (curr_char_.value()) {
-    case '"': {
-      Token next = consume_str_lit(literal, str_start, str_line);
-      return next;
+  const char *start = cur_;
+  const char *lit_start = cur_ + 1;
+
+  auto close = static_cast<const char *>(
+      std::memchr(lit_start, '"', static_cast<size_t>(end_ - lit_start)));
+  if (close == nullptr) {
+    // We have no characters left to lex but the string literal is
+    // unterminated, which is reported at its opening quote.
+    add_error(ParseErrorKind::UnterminatedString, start);
+    cur_ = end_;
+    return make_token(TokenKind::Eof, cur_, cur_);
+  }
+
+  cur_ = close + 1;
+  Token tkn = make_token(TokenKind::StringLiteral, start, cur_);
+  tkn.SetSymbol(interner_.Intern(
+      std::string_view(lit_start, static_cast<size_t>(close - lit_start))));
+  return tkn;
+}
+
+// A token that runs up to the end of the window, or the Eof found there,
+// may only be the start of what is in the stream, so the window is moved up
+// to the token and refilled, and the token is lexed again. Anything lexing
+// it recorded is undone first.
+Token Lexer::lex_streamed() {
+  for (;;) {
+    const char *start = cur_;
+    size_t num_errors = errors_.size();
+    size_t num_numbers = numbers_.size();
+    Token tkn = lex_token();
+    if (cur_ < end_ || !refillable_) {
+      return tkn;
+    }
+    errors_.resize(num_errors);
+    numbers_.resize(num_numbers);
+    number_offsets_.resize(num_numbers);
+    SIF_COUNT(token_counts_[static_cast<size_t>(tkn.GetKind())]--);
+    refill(start);
+  }
+}
+
+// Moves the window up to keep and lexes on from there. Once the stream has
+// run out, what is left in the window is lexed as it is.
+void Lexer::refill(const char *keep) {
+  size_t keep_from = static_cast<size_t>(keep - buf_start_) + base_;
+  refillable_ = source_->Refill(keep_from);
+  buf_start_ = source_->Text().data();
+  base_ = source_->Base();
+  cur_ = buf_start_;
+  end_ = buf_start_ + source_->Size();
+}
+
+std::vector<Token> Lexer::LexAll(WorkPool &pool) {
+  assert(!streaming_ && "cannot lex a stream ahead");
+  size_t size = static_cast<size_t>(end_ - cur_);
+  size_t num_chunks = std::min(pool.Size() * 4, size / MIN_CHUNK_SIZE);
+  if (pool.Size() == 1 || num_chunks <= 1) {
+    return lex_chunk();
+  }
+
+  // Each chunk interns into its own interner and numbers into its own
+  // table, so the chunks share nothing while they are lexed.
+  std::vector<const char *> bounds = split_chunks(num_chunks);
+  num_chunks = bounds.size() - 1;
+  std::vector<std::unique_ptr<StringInterner>> interners(num_chunks);
+  std::vector<std::unique_ptr<Lexer>> lexers(num_chunks);
+  std::vector<std::vector<Token>> chunks(num_chunks);
+  pool.ForEach(num_chunks, [&](size_t i) {
+    interners[i] = std::make_unique<StringInterner>();
+    lexers[i] = std::unique_ptr<Lexer>(
+        new Lexer(buf_start_, bounds[i], bounds[i + 1], *interners[i]));
+    chunks[i] = lexers[i]->lex_chunk();
+  });
+
+  // Lexing one token at a time stops at the first Eof, which comes before
+  // the end of a chunk if it held a stray NUL or an unknown character.
+  // Nothing after that chunk is used.
+  size_t used = 0;
+  std::vector<size_t> out_at(num_chunks);
+  size_t total = 0;
+  while (used < num_chunks) {
+    out_at[used] = total;
+    total += chunks[used].size() - 1;
+    Token eof = chunks[used].back();
+    used++;
+    if (buf_start_ + eof.GetOffset() < bounds[used]) {
+      break;
     }
-    default: {
-      literal += curr_char_.value();
-      advance();
+  }
+
+  // Interning the chunks' strings in chunk order assigns every symbol the
+  // same value as lexing in one pass would, as each string is first seen
+  // in the same place.
+  std::vector<std::vector<Symbol>> remaps(used);
+  std::vector<uint32_t> number_base(used);
+  for (size_t i = 0; i < used; i++) {
+    const StringInterner &local = *interners[i];
+    remaps[i].resize(local.Size());
+    for (Symbol sym = 0; sym < local.Size(); sym++) {
+      remaps[i][sym] = interner_.Intern(local.Lookup(sym));
     }
+
+    const Lexer &lexer = *lexers[i];
+    number_base[i] = static_cast<uint32_t>(numbers_.size());
+    numbers_.insert(numbers_.end(), lexer.numbers_.begin(),
+                    lexer.numbers_.end());
+    errors_.insert(errors_.end(), lexer.errors_.begin(), lexer.errors_.end());
+    for (size_t kind = 0; kind < NUM_TOKEN_KINDS; kind++) {
+      token_counts_[kind] += lexer.token_counts_[kind];
     }
   }
+  // Only the last chunk's Eof is returned.
+  SIF_COUNT(token_counts_[static_cast<size_t>(TokenKind::Eof)] -= used - 1);
+
+  std::vector<Token> tokens(total + 1);
+  pool.ForEach(used, [&](size_t i) {
+    Token *out = tokens.data() + out_at[i];
+    for (size_t t = 0; t + 1 < chunks[i].size(); t++) {
+      Token tkn = chunks[i][t];
+      switch (tkn.GetKind()) {
+      case TokenKind::Identifier:
+      case TokenKind::StringLiteral:
+        tkn.SetSymbol(remaps[i][tkn.GetSymbol()]);
+        break;
+      case TokenKind::NumberLiteral:
+        if (tkn.GetNumberBits() & NUMBER_IN_TABLE) {
+          tkn.SetNumberBits(tkn.GetNumberBits() + number_base[i]);
+        }
+        break;
+      default:
+        break;
+      }
+      out[t] = tkn;
+    }
+  });
 
-  // if we get here, we have no characters left to lex
-  // but the string literal is unterminated.
-  // TODO: collect and emit an error here
-  return Token(TokenKind::Eof, 0, 0);
+  tokens[total] = chunks[used - 1].back();
+  cur_ = buf_start_ + tokens[total].GetOffset();
+  return tokens;
 }
 
-Token Lexer::lex_num_lit() {
-  std::string literal;
-  int num_start = curr_pos_;
-  int num_line = curr_line_;
-
-  bool dot_allowed = true;
-  while (!finished() && curr_char_.has_value() &&
-         (isdigit(curr_char_.value()) || curr_char_.value() == '.')) {
-    if (curr_char_.value() == '.') {
-      if (!dot_allowed) {
-        // TODO: proper error here
-        assert(false && "incorrectly formatted number!");
+std::vector<Token> Lexer::LexAll() {
+  assert(!streaming_ && "cannot lex a stream ahead");
+  return lex_chunk();
+}
+
+std::vector<Token> Lexer::lex_chunk() {
+  // Typical source has a token every four or five bytes. Reserving for
+  // that saves regrowing a large array several times over.
+  std::vector<Token> tokens;
+  tokens.reserve(static_cast<size_t>(end_ - cur_) / 4 + 1);
+  for (;;) {
+    tokens.push_back(lex_token());
+    if (tokens.back().GetKind() == TokenKind::Eof) {
+      return tokens;
+    }
+  }
+}
+
+// Splits the rest of the input into about num_chunks pieces of similar
+// size, returning their bounds. Every piece but the last ends just after a
+// newline that the lexer would skip as whitespace or as the end of a
+// comment, found by tracking string literals and comments in a quick pass
+// over the text.
+std::vector<const char *> Lexer::split_chunks(size_t num_chunks) const {
+  size_t chunk_size = static_cast<size_t>(end_ - cur_) / num_chunks;
+  std::vector<const char *> bounds = {cur_};
+  const char *next = cur_ + chunk_size;
+  const char *p = cur_;
+  while (p < end_ && bounds.size() < num_chunks) {
+    // Newlines only matter once the chunk is long enough. Neither scan goes
+    // past where it can stop, and at end_ the buffer's NUL terminator is
+    // simply stepped over.
+    if (p < next) {
+      p = skip_code_run(p, next);
+    } else {
+      p = skip_code_line_run(p, end_);
+    }
+    char c = *p;
+    if (c == '"') {
+      auto close = static_cast<const char *>(
+          std::memchr(p + 1, '"', static_cast<size_t>(end_ - p - 1)));
+      if (close == nullptr) {
+        break;
+      }
+      p = close + 1;
+    } else if (c == '#' || (c == '/' && p[1] == '/')) {
+      // Stop on the newline itself, which may then end the chunk.
+      auto nl = static_cast<const char *>(
+          std::memchr(p, '\n', static_cast<size_t>(end_ - p)));
+      if (nl == nullptr) {
+        break;
       }
-      dot_allowed = false;
+      p = nl;
+    } else {
+      if (c == '\n' && p + 1 < end_) {
+        bounds.push_back(p + 1);
+        next = p + 1 + chunk_size;
+      }
+      p++;
     }
-    literal += curr_char_.value();
-    advance();
   }
+  bounds.push_back(end_);
+  return bounds;
+}
 
-  return consume_num_lit(literal, num_start, num_line);
+double Lexer::GetNumber(Token tkn) const {
+  uint32_t bits = tkn.GetNumberBits();
+  if (bits & NUMBER_IN_TABLE) {
+    return numbers_[(bits & ~NUMBER_IN_TABLE) - numbers_base_];
+  }
+  return bits;
 }
 
-Token Lexer::lex_ident() {
-  std::string literal;
-  int ident_start = curr_pos_;
-  int ident_line = curr_line_;
-
-  while (!finished() && curr_char_.has_value() &&
-         std::isalpha(curr_char_.value())) {
-    literal += curr_char_.value();
-    advance();
+Token Lexer::lex_num_lit() {
+  const char *start = cur_;
+
+  // Most literals are small whole numbers, which are accumulated as they
+  // are scanned. Nine digits can never overflow.
+  uint32_t whole = 0;
+  while (is_digit(*cur_)) {
+    whole = whole * 10 + static_cast<uint32_t>(*cur_ - '0');
+    cur_++;
+  }
+
+  size_t num_dots = 0;
+  while (is_digit(*cur_) || *cur_ == '.') {
+    num_dots += *cur_ == '.';
+    cur_++;
+  }
+
+  Token tkn = make_token(TokenKind::NumberLiteral, start, cur_);
+  if (num_dots == 0 && cur_ - start <= 9) {
+    tkn.SetNumberBits(whole);
+    return tkn;
   }
 
-  if (reserved_words_.contains(literal)) {
-    TokenKind curr_type = reserved_words_[literal];
-    Token next = Token(curr_type, ident_start, ident_line);
-    next.SetIdentLit(literal);
-    return next;
+  double num = 0;
+  auto [ptr, ec] = std::from_chars(start, cur_, num);
+  if (num_dots > 1 || ec != std::errc() || ptr != cur_) {
+    // Covers forms like 1.2.3 and numbers too large for a double. The
+    // whole run becomes one token so the parser sees a single bad operand.
+    add_error(ParseErrorKind::InvalidNumber, start);
+    return tkn;
+  }
+
+  if (num < NUMBER_IN_TABLE && num == static_cast<uint32_t>(num)) {
+    tkn.SetNumberBits(static_cast<uint32_t>(num));
   } else {
-    Token next = Token(TokenKind::Identifier, ident_start, ident_line);
-    next.SetIdentLit(literal);
-    return next;
+    tkn.SetNumberBits(static_cast<uint32_t>(numbers_base_ + numbers_.size()) |
+                      NUMBER_IN_TABLE);
+    numbers_.push_back(num);
+    if (streaming_) {
+      number_offsets_.push_back(tkn.GetOffset());
+    }
   }
+  return tkn;
 }
 
-Token Lexer::consume_str_lit(std::string str, int pos, int line) {
-  Token tkn = Token(TokenKind::StringLiteral, pos, line);
-  tkn.SetStringLit(str);
-  advance();
+Token Lexer::lex_ident() {
+  const char *start = cur_;
+  cur_ = skip_alpha_run(cur_ + 1, end_);
+
+  std::string_view literal(start, static_cast<size_t>(cur_ - start));
+  TokenKind kind = get_reserved_word(literal);
+  Token tkn = make_token(kind, start, cur_);
+  // An identifier at the end of a window is lexed again once it has been
+  // refilled, and what has been read of it so far must not be interned.
+  if (cur_ == end_ && refillable_) {
+    return tkn;
+  }
+  if (kind == TokenKind::Identifier) {
+    tkn.SetSymbol(interner_.Intern(literal));
+  }
   return tkn;
 }
 
-Token Lexer::consume_num_lit(std::string num, int pos, int line) {
-  Token tkn = Token(TokenKind::NumberLiteral, pos, line);
-  tkn.SetNumberLit(num);
-  advance();
-  return tkn;
+Token Lexer::consume(TokenKind kind, size_t len) {
+  const char *start = cur_;
+  cur_ += len;
+  return make_token(kind, start, cur_);
 }
 
-Token Lexer::consume(TokenKind kind) {
-  Token tkn = Token(kind, curr_pos_, curr_line_);
-  advance();
-  return tkn;
+Token Lexer::make_token(TokenKind kind, const char *start, const char *end) {
+  SIF_COUNT(token_counts_[static_cast<size_t>(kind)]++);
+  return Token(kind, static_cast<uint32_t>(start - buf_start_ + base_),
+               static_cast<uint32_t>(end - start));
 }
 
-std::optional<char> Lexer::peek() {
-  if (curr_pos_ >= buffer_[curr_line_].size() - 1) {
-    return std::nullopt;
+std::vector<ParseError> Lexer::Errors() const {
+  std::vector<ParseError> errors;
+  for (const PendingError &err : errors_) {
+    auto loc = source_->Locate(err.offset);
+    errors.push_back(ParseError(err.kind, err.offset, loc.line, loc.col));
   }
+  return errors;
+}
 
-  return std::optional<char>{buffer_[curr_line_][curr_pos_ + 1]};
+std::vector<ParseError> Lexer::TakeErrors(size_t offset) {
+  // Errors are found in source order.
+  size_t count = 0;
+  std::vector<ParseError> errors;
+  for (; count < errors_.size() && errors_[count].offset < offset; count++) {
+    const PendingError &err = errors_[count];
+    auto loc = source_->Locate(err.offset);
+    errors.push_back(ParseError(err.kind, err.offset, loc.line, loc.col));
+  }
+  errors_.erase(errors_.begin(), errors_.begin() + count);
+  return errors;
 }
 
-void Lexer::advance() {
-  bool on_new_line = curr_char_ == '\n';
-  if (curr_pos_ == buffer_[curr_line_].size() - 1 || on_new_line) {
-    next_line();
-  } else {
-    curr_pos_++;
+void Lexer::Release(size_t offset) {
+  assert((errors_.empty() || errors_.front().offset >= offset) &&
+         "errors must be taken before they are released");
+  if (!streaming_) {
+    return;
   }
+  source_->Release(offset);
 
-  if (finished()) {
-    curr_char_ = std::nullopt;
-  } else {
-    curr_char_ = std::optional<char>{buffer_[curr_line_][curr_pos_]};
+  size_t count = 0;
+  while (count < number_offsets_.size() && number_offsets_[count] < offset) {
+    count++;
   }
+  numbers_.erase(numbers_.begin(), numbers_.begin() + count);
+  number_offsets_.erase(number_offsets_.begin(),
+                        number_offsets_.begin() + count);
+  numbers_base_ += count;
 }
 
-void Lexer::next_line() {
-  curr_line_++;
-  curr_pos_ = 0;
+void Lexer::add_error(ParseErrorKind kind, const char *at) {
+  errors_.push_back(
+      PendingError{kind, static_cast<uint32_t>(at - buf_start_ + base_)});
+}
+
+void Lexer::skip_line() {
+  auto nl = static_cast<const char *>(
+      std::memchr(cur_, '\n', static_cast<size_t>(end_ - cur_)));
+  cur_ = nl == nullptr ? end_ : nl + 1;
 }
 
 void Lexer::skip_whitespace() {
-  while (curr_char_.has_value() && std::isspace(curr_char_.value())) {
-    advance();
+  // Most tokens are separated by a single space, so only hand off to the
+  // bulk kernel once we know we are looking at a longer run such as
+  // indentation or blank lines.
+  if (is_space(*cur_)) {
+    cur_++;
+    if (is_space(*cur_)) {
+      cur_ = skip_space_run(cur_, end_);
+    }
   }
 }
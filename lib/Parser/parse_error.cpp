@@ -0,0 +1,56 @@
+#include "sif/Parser/parse_error.h"
+#include <string>
+
+using namespace sif;
+
+std::string ParseError::error_to_msg() {
+  std::string msg;
+  switch (kind_) {
+  case ParseErrorKind::InvalidIdent:
+    msg = "invalid identifier";
+    break;
+  case ParseErrorKind::InvalidToken:
+    msg = "unexpected token";
+    break;
+  case ParseErrorKind::InvalidAssign:
+    msg = "invalid assignment target";
+    break;
+  case ParseErrorKind::InvalidForStmt:
+    msg = "invalid for statement";
+    break;
+  case ParseErrorKind::InvalidIfStmt:
+    msg = "invalid if statement";
+    break;
+  case ParseErrorKind::TokenMismatch:
+    msg = "unexpected token";
+    break;
+  case ParseErrorKind::FnParamCountExceeded:
+    msg = "too many function parameters";
+    break;
+  case ParseErrorKind::WrongFnParamCount:
+    msg = "wrong number of arguments in function call";
+    break;
+  case ParseErrorKind::UndeclaredSymbol:
+    msg = "undeclared symbol";
+    break;
+  case ParseErrorKind::UnassignedVar:
+    msg = "variable used before assignment";
+    break;
+  case ParseErrorKind::ExpectedIdent:
+    msg = "expected an identifier";
+    break;
+  case ParseErrorKind::InvalidNumber:
+    msg = "malformed number";
+    break;
+  case ParseErrorKind::UnterminatedString:
+    msg = "unterminated string";
+    break;
+  case ParseErrorKind::UnsupportedExpression:
+    msg = "tables and arrays are not supported";
+    break;
+  }
+
+  // Lines and columns are stored zero based.
+  return msg + " at line " + std::to_string(line_ + 1) + ", column " +
+         std::to_string(pos_ + 1);
+}
@@ -2,36 +2,84 @@
 #include "sif/Parser/parse_result.h"
 #include "sif/Parser/reserved.h"
 #include "sif/Parser/token.h"
+#include <algorithm>
+#include <array>
 #include <cassert>
+#include <cstdint>
 #include <memory>
 #include <optional>
 
 using namespace sif;
 
+namespace {
+// Binding power of every binary operator, indexed by TokenKind. Higher
+// powers bind tighter, and zero marks a token that is not a binary operator.
+constexpr std::array<uint8_t, NUM_TOKEN_KINDS> make_binding_powers() {
+  std::array<uint8_t, NUM_TOKEN_KINDS> powers{};
+  powers[static_cast<size_t>(TokenKind::DoublePipe)] = 1;
+  powers[static_cast<size_t>(TokenKind::DoubleAmpersand)] = 2;
+  powers[static_cast<size_t>(TokenKind::EqualEqual)] = 3;
+  powers[static_cast<size_t>(TokenKind::BangEqual)] = 3;
+  powers[static_cast<size_t>(TokenKind::LessThan)] = 4;
+  powers[static_cast<size_t>(TokenKind::LessThanEqual)] = 4;
+  powers[static_cast<size_t>(TokenKind::GreaterThan)] = 4;
+  powers[static_cast<size_t>(TokenKind::GreaterThanEqual)] = 4;
+  powers[static_cast<size_t>(TokenKind::Plus)] = 5;
+  powers[static_cast<size_t>(TokenKind::Minus)] = 5;
+  powers[static_cast<size_t>(TokenKind::Star)] = 6;
+  powers[static_cast<size_t>(TokenKind::Slash)] = 6;
+  powers[static_cast<size_t>(TokenKind::Percent)] = 7;
+  return powers;
+}
+
+constexpr std::array<uint8_t, NUM_TOKEN_KINDS> BINDING_POWERS =
+    make_binding_powers();
+
+uint8_t binding_power(TokenKind kind) {
+  return BINDING_POWERS[static_cast<size_t>(kind)];
+}
+
+// Tokens that turn a preceding literal into a call or an access.
+bool is_postfix_op(TokenKind kind) {
+  return kind == TokenKind::LeftParen || kind == TokenKind::Period ||
+         kind == TokenKind::LeftBracket;
+}
+} // namespace
+
 ParseFullResult Parser::Parse() {
-  std::vector<ASTPtr> blocks;
+  std::vector<ASTNode *> blocks;
   bool found_error = false;
 
   while (curr_tkn_.GetKind() != TokenKind::Eof) {
     auto result = decl();
-    if (result->has_ast()) {
-      assert(result->has_error() == false &&
+    if (result.has_ast()) {
+      assert(result.has_error() == false &&
              "AST found, so result should not have any errors.");
 
-      blocks.push_back(std::move(result->ast()));
+      blocks.push_back(result.ast());
     } else {
       found_error = true;
-      auto error = result->error();
-      // TODO: emit errors
-      // error.emit();
     }
   }
 
-  ProgramAST program = ProgramAST(std::move(blocks));
-  return ParseFullResult(std::make_unique<ASTNode>(program), found_error);
+  // Report malformed tokens alongside the parse errors, in source order.
+  std::vector<ParseError> lex_errors = lexer_->Errors();
+  errors_.insert(errors_.end(), lex_errors.begin(), lex_errors.end());
+  std::stable_sort(errors_.begin(), errors_.end(),
+                   [](const ParseError &a, const ParseError &b) {
+                     if (a.Line() != b.Line()) {
+                       return a.Line() < b.Line();
+                     }
+                     return a.Pos() < b.Pos();
+                   });
+
+  ProgramAST *program = ctx_.Create<ProgramAST>(ctx_.CreateList(blocks));
+  ParseFullResult full_result(program, found_error || !errors_.empty());
+  full_result.errors_ = errors_;
+  return full_result;
 }
 
-ParseCallResultPtr Parser::decl() {
+ParseCallResult Parser::decl() {
   switch (curr_tkn_.GetKind()) {
   case TokenKind::Var:
     return var_decl();
@@ -42,7 +90,7 @@ ParseCallResultPtr Parser::decl() {
   }
 }
 
-ParseCallResultPtr Parser::stmt() {
+ParseCallResult Parser::stmt() {
   switch (curr_tkn_.GetKind()) {
   case TokenKind::If:
     return if_stmt();
@@ -57,23 +105,20 @@ ParseCallResultPtr Parser::stmt() {
   }
 }
 
-ParseCallResultPtr Parser::block(OptionalBlockBindings bindings) {
+ParseCallResult Parser::block(OptionalBlockBindings bindings) {
   auto lb = match(TokenKind::LeftBrace);
   if (lb.has_value()) {
-    return std::make_unique<ParseCallResult>(lb.value());
+    return lb.value();
   }
 
-  std::vector<ASTPtr> decls;
+  std::vector<ASTNode *> decls;
 
   symtab_->InitScope();
   if (bindings.has_value()) {
-    auto bindings_val = std::move(bindings.value());
-
-    for (int i = 0; i < bindings_val.size(); i++) {
-      auto node = std::move(bindings_val[i]);
+    for (ASTNode *node : bindings.value()) {
       if (node->GetKind() == ASTKind::LiteralExpr) {
-        auto pe = dynamic_cast<LiteralExprAST *>(node.get());
-        symtab_->Store(pe->lit_tkn_.GetName(), *node);
+        auto pe = static_cast<LiteralExprAST *>(node);
+        symtab_->Store(pe->lit_tkn_.GetSymbol(), SymbolKind::Var, 0, node);
       }
     }
   }
@@ -85,35 +130,37 @@ ParseCallResultPtr Parser::block(OptionalBlockBindings bindings) {
       break;
     } else {
       auto result = decl();
-      if (result->has_ast()) {
-        decls.push_back(std::move(result->ast()));
-      } else {
-        errors_.push_back(result->error());
+      // Errors are already recorded in errors_, so a failed decl is
+      // simply dropped from the block.
+      if (result.has_ast()) {
+        decls.push_back(result.ast());
       }
     }
   }
 
+  // Close the scope before checking for the brace so an unterminated block
+  // does not leave its bindings visible to the rest of the program.
+  int lvl = symtab_->Level();
+  symtab_->CloseScope();
+
   auto rb = match(TokenKind::RightBrace);
   if (rb.has_value()) {
-    return std::make_unique<ParseCallResult>(rb.value());
+    return rb.value();
   }
 
-  int lvl = symtab_->Level();
-  symtab_->CloseScope();
-  BlockAST block = BlockAST(std::move(decls), lvl);
-  return std::make_unique<ParseCallResult>(std::make_unique<ASTNode>(block));
+  ASTNode *block = ctx_.Create<BlockAST>(ctx_.CreateList(decls), lvl);
+  return ParseResultFactory::from_ast(block);
 }
 
-ParseCallResultPtr Parser::var_decl() {
-  std::optional<ParseError> next_var = match(TokenKind::Var);
+ParseCallResult Parser::var_decl() {
+  auto next_var = match(TokenKind::Var);
   if (next_var.has_value()) {
-    return std::make_unique<ParseCallResult>(next_var.value());
+    return next_var.value();
   }
 
   std::optional<Token> maybe_ident_tkn = match_ident();
   if (!maybe_ident_tkn.has_value()) {
-    auto ident_err = add_error(ParseErrorKind::ExpectedIdent);
-    return std::make_unique<ParseCallResult>(ident_err);
+    return add_error(ParseErrorKind::ExpectedIdent);
   }
 
   auto ident_tkn = maybe_ident_tkn.value();
@@ -122,132 +169,135 @@ ParseCallResultPtr Parser::var_decl() {
   case TokenKind::Equal: {
     auto eq = match(TokenKind::Equal);
     if (eq.has_value()) {
-      return std::make_unique<ParseCallResult>(eq.value());
+      return eq.value();
     }
 
-    ASTPtr rhs = nullptr;
+    ASTNode *rhs = nullptr;
     if (curr_tkn_.GetKind() == TokenKind::LeftBracket) {
-      rhs = std::move(array_decl(ident_tkn)->ast());
+      auto array_result = array_decl(ident_tkn);
+      if (array_result.has_error()) {
+        return array_result;
+      }
+      rhs = array_result.ast();
     } else if (curr_tkn_.GetKind() == TokenKind::DoubleLeftBracket) {
-      rhs = std::move(table_decl(ident_tkn)->ast());
+      auto table_result = table_decl(ident_tkn);
+      if (table_result.has_error()) {
+        return table_result;
+      }
+      rhs = table_result.ast();
     } else {
       auto assign_result = expr();
-      auto sc = match(TokenKind::Semicolon);
+      if (assign_result.has_error()) {
+        return assign_result;
+      }
 
+      auto sc = match(TokenKind::Semicolon);
       if (sc.has_value()) {
-        return std::make_unique<ParseCallResult>(sc.value());
-      } else {
-        rhs = std::move(assign_result->ast());
+        return sc.value();
       }
+      rhs = assign_result.ast();
     }
 
-    ASTPtr node = std::make_unique<VarDeclAST>(
-        std::make_unique<Token>(ident_tkn), symtab_->IsGlobal(),
-        std::make_optional(std::move(rhs)));
+    ASTNode *node =
+        ctx_.Create<VarDeclAST>(ident_tkn, symtab_->IsGlobal(), rhs);
 
-    symtab_->Store(ident_tkn.GetName(), *node.get());
-    return std::make_unique<ParseCallResult>(std::move(node));
+    symtab_->Store(ident_tkn.GetSymbol(), SymbolKind::Var, 0, node);
+    return ParseResultFactory::from_ast(node);
   }
   case TokenKind::Semicolon: {
-    std::optional<ParseError> sc = match(TokenKind::Semicolon);
+    auto sc = match(TokenKind::Semicolon);
     if (sc.has_value()) {
-      return std::make_unique<ParseCallResult>(sc.value());
+      return sc.value();
     }
 
-    ASTPtr node = std::make_unique<VarDeclAST>(
-        std::make_unique<Token>(ident_tkn), symtab_->IsGlobal(), std::nullopt);
-    symtab_->Store(ident_tkn.GetName(), *node.get());
+    ASTNode *node =
+        ctx_.Create<VarDeclAST>(ident_tkn, symtab_->IsGlobal(), nullptr);
+    symtab_->Store(ident_tkn.GetSymbol(), SymbolKind::Var, 0, node);
 
-    return std::make_unique<ParseCallResult>(std::move(node));
+    return ParseResultFactory::from_ast(node);
   }
   default:
-    auto err = add_error(ParseErrorKind::InvalidToken);
-    return std::make_unique<ParseCallResult>(err);
+    return add_error(ParseErrorKind::InvalidToken);
   }
 }
 
-ParseCallResultPtr Parser::fn_decl() {
+ParseCallResult Parser::fn_decl() {
   auto is_fn = match(TokenKind::Fn);
   if (is_fn.has_value()) {
-    return ParseResultFactory::from_err(is_fn.value());
+    return is_fn.value();
   }
 
   auto maybe_ident_tkn = match_ident();
   if (!maybe_ident_tkn.has_value()) {
-    auto err = add_error(ParseErrorKind::ExpectedIdent);
-    return ParseResultFactory::from_err(err);
+    return add_error(ParseErrorKind::ExpectedIdent);
   }
 
   auto ident_tkn = maybe_ident_tkn.value();
 
-  // Placeholder to ensure recursive calls will parse correctly.
-  symtab_->Store(ident_tkn.GetName(), EmptyAST());
-
   auto is_lparen = match(TokenKind::LeftParen);
   if (is_lparen.has_value()) {
-    return ParseResultFactory::from_err(is_lparen.value());
+    return is_lparen.value();
   }
 
   auto params_result = param_list(false);
-  if (params_result->has_error()) {
-    return ParseResultFactory::from_err(params_result->error());
+  if (params_result.has_error()) {
+    return params_result;
   }
 
   auto is_rparen = match(TokenKind::RightParen);
   if (is_rparen.has_value()) {
-    return ParseResultFactory::from_err(is_rparen.value());
+    return is_rparen.value();
   }
 
-  auto params_ast = params_result->ast();
-  ParamListAST *param_list_ast = dynamic_cast<ParamListAST *>(params_ast.get());
+  auto params_ast = params_result.ast();
+  ParamListAST *param_list_ast = static_cast<ParamListAST *>(params_ast);
+  uint32_t arity = static_cast<uint32_t>(param_list_ast->params_.size());
 
-  auto bindings = std::make_optional<std::vector<ASTPtr>>(
-      std::move(param_list_ast->params_));
+  // Declare the function before parsing its body so recursive calls
+  // resolve and have their arity checked. The node is filled in below.
+  symtab_->Store(ident_tkn.GetSymbol(), SymbolKind::Fn, arity, nullptr);
 
-  auto body = block(std::move(bindings));
-  if (body->has_error()) {
-    return ParseResultFactory::from_err(body->error());
-  }
+  auto bindings = std::make_optional<ASTList>(param_list_ast->params_);
 
-  auto ast = body->ast();
+  open_fns_.push_back(OpenFn{symtab_->Level(), {}});
+  auto body = block(bindings);
+  std::vector<ASTNode *> captures = std::move(open_fns_.back().captures);
+  open_fns_.pop_back();
+  if (body.has_error()) {
+    return body;
+  }
 
-  BlockAST *body_ast = dynamic_cast<BlockAST *>(ast.get());
-  ASTPtr body_w_ret;
+  // Make sure every function body ends in a return statement, appending
+  // an empty one if the body does not already end with a return.
+  BlockAST *body_ast = static_cast<BlockAST *>(body.ast());
+  ASTNode *body_w_ret = body_ast;
 
-  if (body_ast->decls_.size() == 0) {
-    std::vector<ASTPtr> next_decls;
-    ASTPtr wret = std::make_unique<ReturnStmtAST>(std::nullopt);
-    next_decls.push_back(std::move(wret));
+  if (body_ast->decls_.empty() ||
+      body_ast->decls_.back()->GetKind() != ASTKind::ReturnStmt) {
+    std::vector<ASTNode *> next_decls(body_ast->decls_.begin(),
+                                      body_ast->decls_.end());
+    next_decls.push_back(ctx_.Create<ReturnStmtAST>(nullptr));
     body_w_ret =
-        std::make_unique<BlockAST>(std::move(next_decls), body_ast->scope_);
-  } else {
-    size_t last_idx = body_ast->decls_.size() - 1;
-    auto last_node = std::move(body_ast->decls_[last_idx]);
-
-    switch (last_node->GetKind()) {
-    case ASTKind::ReturnStmt:
-      body_w_ret = std::make_unique<BlockAST>(std::move(body_ast->decls_),
-                                              body_ast->scope_);
-    default: {
-      std::vector<ASTPtr> next_decls;
-      ASTPtr wret = std::make_unique<ReturnStmtAST>(std::nullopt);
-      next_decls.push_back(std::move(wret));
-      body_w_ret =
-          std::make_unique<BlockAST>(std::move(next_decls), body_ast->scope_);
-    }
-    }
+        ctx_.Create<BlockAST>(ctx_.CreateList(next_decls), body_ast->scope_);
   }
 
-  ASTPtr node = std::make_unique<FnDeclAST>(
-      std::make_unique<Token>(ident_tkn), std::move(params_ast),
-      std::move(body_w_ret), symtab_->Level());
+  ASTNode *captures_ast = ctx_.Create<ParamListAST>(ctx_.CreateList(captures));
+  ASTNode *node = ctx_.Create<FnDeclAST>(ident_tkn, params_ast, body_w_ret,
+                                         captures_ast, symtab_->Level());
 
-  symtab_->Store(ident_tkn.GetName(), *node.get());
-  return ParseResultFactory::from_ast(std::move(node));
+  symtab_->Store(ident_tkn.GetSymbol(), SymbolKind::Fn, arity, node);
+  return ParseResultFactory::from_ast(node);
 }
 
-ParseCallResultPtr Parser::table_decl(Token ident_tkn) {}
-ParseCallResultPtr Parser::array_decl(Token ident_tkn) {}
+// Table and array literals have no AST nodes yet, so they are rejected at
+// their opening bracket.
+ParseCallResult Parser::table_decl(Token ident_tkn) {
+  return add_error(ParseErrorKind::UnsupportedExpression);
+}
+
+ParseCallResult Parser::array_decl(Token ident_tkn) {
+  return add_error(ParseErrorKind::UnsupportedExpression);
+}
 
 /**
    Parses an expression. Because the grammar encodes precedence, we must call
@@ -271,462 +321,277 @@ ParseCallResultPtr Parser::array_decl(Token ident_tkn) {}
 
      expr ::= assignexpr ;
  */
-ParseCallResultPtr Parser::expr() { return assign_expr(); }
+ParseCallResult Parser::expr() { return assign_expr(); }
 
-ParseCallResultPtr Parser::assign_expr() {
-  auto ast = or_expr();
-  if (ast->has_error()) {
+ParseCallResult Parser::assign_expr() {
+  auto ast = binary_expr(0);
+  if (ast.has_error() || curr_tkn_.GetKind() != TokenKind::Equal) {
     return ast;
   }
 
-  if (curr_tkn_.GetKind() == TokenKind::Equal) {
-    auto tkn =
-        Token(curr_tkn_.GetKind(), curr_tkn_.GetPos(), curr_tkn_.GetLine());
-
-    auto eq_match = match(TokenKind::Equal);
-    if (eq_match.has_value()) {
-      return std::make_unique<ParseCallResult>(eq_match.value());
-    }
-
-    auto rhs_result = assign_expr();
-    if (rhs_result->has_error()) {
-      return rhs_result;
-    }
-
-    auto rhs = rhs_result->ast();
-    if (rhs->GetKind() == ASTKind::LiteralExpr) {
-      auto primary_expr_ast = dynamic_cast<LiteralExprAST *>(rhs.get());
-      Token tkn = primary_expr_ast->lit_tkn_;
-
-      if (tkn.GetKind() == TokenKind::Identifier) {
-        auto maybe_sym = symtab_->Retrieve(tkn.GetName());
-        if (!maybe_sym.has_value()) {
-          return std::make_unique<ParseCallResult>(
-              add_error(ParseErrorKind::UndeclaredSymbol));
-        }
-        auto variable = maybe_sym.value();
-        ASTPtr node = std::make_unique<VarAssignAST>(tkn, symtab_->IsGlobal(),
-                                                     std::move(rhs));
-        return std::make_unique<ParseCallResult>(std::move(node));
-      } else {
-        return std::make_unique<ParseCallResult>(
-            add_error(ParseErrorKind::InvalidAssign));
-      }
-    } else if (rhs->GetKind() == ASTKind::ArrayAccess) {
-      auto array_access_ast = dynamic_cast<ArrayAccessAST *>(rhs.get());
-      ASTPtr node = std::make_unique<ArrayMutExprAST>(
-          tkn, std::move(array_access_ast->index_), std::move(rhs));
-      return std::make_unique<ParseCallResult>(std::move(node));
-    } else {
-      return std::make_unique<ParseCallResult>(
-          add_error(ParseErrorKind::InvalidAssign));
-    }
-  } else {
-    return std::make_unique<ParseCallResult>(
-        add_error(ParseErrorKind::InvalidAssign));
+  auto eq_match = match(TokenKind::Equal);
+  if (eq_match.has_value()) {
+    return eq_match.value();
   }
-}
 
-ParseCallResultPtr Parser::or_expr() {
-  auto ast = and_expr();
-  if (ast->has_error()) {
-    return ast;
+  auto rhs_result = assign_expr();
+  if (rhs_result.has_error()) {
+    return rhs_result;
   }
 
-  while (true) {
-    if (curr_tkn_.GetKind() == TokenKind::DoublePipe) {
-      auto tkn =
-          Token(curr_tkn_.GetKind(), curr_tkn_.GetPos(), curr_tkn_.GetLine());
-
-      consume();
+  auto lhs = ast.ast();
+  auto rhs = rhs_result.ast();
+  if (lhs->GetKind() == ASTKind::LiteralExpr) {
+    auto primary_expr_ast = static_cast<LiteralExprAST *>(lhs);
+    Token tkn = primary_expr_ast->lit_tkn_;
 
-      auto rhs = and_expr();
-      if (rhs->has_error()) {
-        return rhs;
-      }
-
-      ASTPtr and_ast = ast->ast();
-      ASTPtr or_ast = rhs->ast();
-      ASTPtr node = std::make_unique<BinaryExprAST>(tkn, std::move(and_ast),
-                                                    std::move(or_ast));
-      return std::make_unique<ParseCallResult>(std::move(node));
-    } else {
-      break;
+    if (tkn.GetKind() != TokenKind::Identifier) {
+      return add_error(ParseErrorKind::InvalidAssign);
     }
-  }
-  return ast;
-}
-
-ParseCallResultPtr Parser::and_expr() {
-  auto ast = equality_expr();
-  if (ast->has_error()) {
-    return ast;
-  }
-
-  while (true) {
-    if (curr_tkn_.GetKind() == TokenKind::DoubleAmpersand) {
-      auto tkn =
-          Token(curr_tkn_.GetKind(), curr_tkn_.GetPos(), curr_tkn_.GetLine());
 
-      consume();
-
-      auto rhs = equality_expr();
-      if (rhs->has_error()) {
-        return rhs;
-      }
-
-      ASTPtr eq_ast = ast->ast();
-      ASTPtr and_ast = rhs->ast();
-      ASTPtr node = std::make_unique<BinaryExprAST>(tkn, std::move(eq_ast),
-                                                    std::move(and_ast));
-      return std::make_unique<ParseCallResult>(std::move(node));
-    } else {
-      break;
+    if (!symtab_->Contains(tkn.GetSymbol())) {
+      return add_error(ParseErrorKind::UndeclaredSymbol);
     }
-  }
-  return ast;
-}
 
-ParseCallResultPtr Parser::equality_expr() {
-  auto ast = compare_expr();
-  if (ast->has_error()) {
-    return ast;
+    ASTNode *node = ctx_.Create<VarAssignAST>(tkn, symtab_->IsGlobal(), rhs);
+    return ParseResultFactory::from_ast(node);
+  } else if (lhs->GetKind() == ASTKind::ArrayAccess) {
+    auto array_access_ast = static_cast<ArrayAccessAST *>(lhs);
+    ASTNode *node = ctx_.Create<ArrayMutExprAST>(
+        array_access_ast->array_tkn_, array_access_ast->index_, rhs);
+    return ParseResultFactory::from_ast(node);
   }
 
-  while (true) {
-    if (curr_tkn_.GetKind() == TokenKind::BangEqual ||
-        curr_tkn_.GetKind() == TokenKind::EqualEqual) {
-      auto tkn =
-          Token(curr_tkn_.GetKind(), curr_tkn_.GetPos(), curr_tkn_.GetLine());
-
-      consume();
-
-      auto rhs = compare_expr();
-      if (rhs->has_error()) {
-        return rhs;
-      }
-
-      ASTPtr compare_ast = ast->ast();
-      ASTPtr eq_ast = rhs->ast();
-      ASTPtr node = std::make_unique<BinaryExprAST>(tkn, std::move(compare_ast),
-                                                    std::move(eq_ast));
-      return std::make_unique<ParseCallResult>(std::move(node));
-    } else {
-      break;
-    }
-  }
-  return ast;
+  return add_error(ParseErrorKind::InvalidAssign);
 }
 
-ParseCallResultPtr Parser::compare_expr() {
-  auto ast = add_or_sub_expr();
-  if (ast->has_error()) {
-    return ast;
+ParseCallResult Parser::binary_expr(uint8_t min_power) {
+  auto lhs = unary_expr();
+  if (lhs.has_error()) {
+    return lhs;
   }
 
-  auto curr_kind = curr_tkn_.GetKind();
-  while (true) {
-    if (curr_kind == TokenKind::LessThan ||
-        curr_kind == TokenKind::LessThanEqual ||
-        curr_kind == TokenKind::GreaterThan ||
-        curr_kind == TokenKind::GreaterThanEqual) {
-      auto tkn =
-          Token(curr_tkn_.GetKind(), curr_tkn_.GetPos(), curr_tkn_.GetLine());
-
-      consume();
-
-      auto rhs = add_or_sub_expr();
-      if (rhs->has_error()) {
-        return rhs;
-      }
-
-      ASTPtr addsub_ast = ast->ast();
-      ASTPtr compare_ast = rhs->ast();
-      ASTPtr node = std::make_unique<BinaryExprAST>(tkn, std::move(addsub_ast),
-                                                    std::move(compare_ast));
-      return std::make_unique<ParseCallResult>(std::move(node));
-    } else {
-      break;
-    }
-  }
-  return ast;
-}
-
-ParseCallResultPtr Parser::add_or_sub_expr() {
-  auto ast = mul_or_div_expr();
-  if (ast->has_error()) {
-    return ast;
-  }
-
-  while (true) {
-    if (curr_tkn_.GetKind() == TokenKind::Plus ||
-        curr_tkn_.GetKind() == TokenKind::Minus) {
-      auto tkn =
-          Token(curr_tkn_.GetKind(), curr_tkn_.GetPos(), curr_tkn_.GetLine());
-
-      consume();
-
-      auto rhs = mul_or_div_expr();
-      if (rhs->has_error()) {
-        return rhs;
-      }
-
-      ASTPtr muldiv_ast = ast->ast();
-      ASTPtr addsub_ast = rhs->ast();
-      ASTPtr node = std::make_unique<BinaryExprAST>(tkn, std::move(muldiv_ast),
-                                                    std::move(addsub_ast));
-      return std::make_unique<ParseCallResult>(std::move(node));
-    } else {
+  // Operators that bind tighter than min_power are folded into lhs here;
+  // anything looser is left for the caller. Recursing with the operator's
+  // own power makes equal-precedence chains associate to the left.
+  ASTNode *ast = lhs.ast();
+  for (;;) {
+    uint8_t power = binding_power(curr_tkn_.GetKind());
+    if (power <= min_power) {
       break;
     }
-  }
-  return ast;
-}
-
-ParseCallResultPtr Parser::mul_or_div_expr() {
-  auto ast = modulo_expr();
-  if (ast->has_error()) {
-    return ast;
-  }
 
-  while (true) {
-    if (curr_tkn_.GetKind() == TokenKind::Star ||
-        curr_tkn_.GetKind() == TokenKind::Slash) {
-      auto tkn =
-          Token(curr_tkn_.GetKind(), curr_tkn_.GetPos(), curr_tkn_.GetLine());
-
-      consume();
-
-      auto rhs = modulo_expr();
-      if (rhs->has_error()) {
-        return rhs;
-      }
+    auto tkn = curr_tkn_;
+    consume();
 
-      ASTPtr modulo_ast = ast->ast();
-      ASTPtr muldiv_ast = rhs->ast();
-      ASTPtr node = std::make_unique<BinaryExprAST>(tkn, std::move(modulo_ast),
-                                                    std::move(muldiv_ast));
-      return std::make_unique<ParseCallResult>(std::move(node));
-    } else {
-      break;
+    auto rhs = binary_expr(power);
+    if (rhs.has_error()) {
+      return rhs;
     }
-  }
-  return ast;
-}
 
-ParseCallResultPtr Parser::modulo_expr() {
-  auto ast = unary_expr();
-  if (ast->has_error()) {
-    return ast;
+    ast = ctx_.Create<BinaryExprAST>(tkn, ast, rhs.ast());
   }
 
-  while (true) {
-    if (curr_tkn_.GetKind() == TokenKind::Percent) {
-      auto tkn =
-          Token(curr_tkn_.GetKind(), curr_tkn_.GetPos(), curr_tkn_.GetLine());
-
-      consume();
-
-      auto rhs = unary_expr();
-      if (rhs->has_error()) {
-        return rhs;
-      }
-
-      ASTPtr unary_ast = ast->ast();
-      ASTPtr modulo_ast = rhs->ast();
-      ASTPtr node = std::make_unique<BinaryExprAST>(tkn, std::move(unary_ast),
-                                                    std::move(modulo_ast));
-      return std::make_unique<ParseCallResult>(std::move(node));
-    } else {
-      break;
-    }
-  }
-  return ast;
+  return ParseResultFactory::from_ast(ast);
 }
 
-ParseCallResultPtr Parser::unary_expr() {
+ParseCallResult Parser::unary_expr() {
   switch (curr_tkn_.GetKind()) {
   case TokenKind::Bang:
   case TokenKind::Minus: {
-    auto tkn =
-        Token(curr_tkn_.GetKind(), curr_tkn_.GetPos(), curr_tkn_.GetLine());
+    auto tkn = curr_tkn_;
     consume();
     auto rhs = unary_expr();
-    if (rhs->has_error()) {
+    if (rhs.has_error()) {
       return rhs;
     }
-    ASTPtr unary_ast = rhs->ast();
-    ASTPtr node = std::make_unique<UnaryExprAST>(tkn, std::move(unary_ast));
-    return std::make_unique<ParseCallResult>(std::move(node));
+    ASTNode *unary_ast = rhs.ast();
+    ASTNode *node = ctx_.Create<UnaryExprAST>(tkn, unary_ast);
+    return ParseResultFactory::from_ast(node);
   }
   default:
     return fn_call_expr();
   }
 }
 
-ParseCallResultPtr Parser::fn_call_expr() {
+ParseCallResult Parser::fn_call_expr() {
+  // The common case is an identifier directly followed by (, . or [.
+  // Looking past the identifier handles it without first building a
+  // literal node that would be thrown away.
+  if (curr_tkn_.GetKind() == TokenKind::Identifier &&
+      is_postfix_op(tokens_.Peek(0).GetKind())) {
+    Token ident_tkn = curr_tkn_;
+    bool is_call = tokens_.Peek(0).GetKind() == TokenKind::LeftParen;
+    if (!is_declared(ident_tkn, is_call)) {
+      auto err = add_error(ParseErrorKind::UndeclaredSymbol);
+      consume();
+      return err;
+    }
+    consume();
+    return postfix_expr(ident_tkn);
+  }
+
   auto result = literal_expr();
-  if (result->has_error()) {
+  if (result.has_error() || !is_postfix_op(curr_tkn_.GetKind()) ||
+      result.ast()->GetKind() != ASTKind::LiteralExpr) {
     return result;
   }
 
-  auto ast = result->ast();
-  std::vector<ASTPtr> params;
-  std::optional<Token> maybe_ident_tkn = std::nullopt;
-
-  if (ast->GetKind() == ASTKind::LiteralExpr) {
-    auto lit_ast = dynamic_cast<LiteralExprAST *>(ast.get());
-    maybe_ident_tkn = std::make_optional<Token>(lit_ast->lit_tkn_);
+  // An identifier that came out of parentheses, as in (f)(x). Only an
+  // identifier names something that can be called or indexed, so after
+  // any other literal the bracket is left for the caller to reject.
+  Token lit_tkn = static_cast<LiteralExprAST *>(result.ast())->lit_tkn_;
+  if (lit_tkn.GetKind() != TokenKind::Identifier) {
+    return result;
   }
+  return postfix_expr(lit_tkn);
+}
 
+ParseCallResult Parser::postfix_expr(Token ident_tkn) {
+  ASTList params;
   switch (curr_tkn_.GetKind()) {
   case TokenKind::LeftParen: {
     auto is_lparen = match(TokenKind::LeftParen);
     if (is_lparen.has_value()) {
-      return std::make_unique<ParseCallResult>(is_lparen.value());
+      return is_lparen.value();
     }
 
     auto params_result = param_list(true);
-    if (params_result->has_error()) {
+    if (params_result.has_error()) {
       return params_result;
     }
-    auto param_ast = params_result->ast();
-    auto inner = dynamic_cast<ParamListAST *>(param_ast.get());
-    params = std::move(inner->params_);
 
-    auto ident_name = maybe_ident_tkn.value().GetName();
-    auto maybe_ast = symtab_->Retrieve(ident_name);
-    bool is_std = is_std_lib_fn(ident_name);
+    auto is_rparen = match(TokenKind::RightParen);
+    if (is_rparen.has_value()) {
+      return is_rparen.value();
+    }
+
+    auto param_ast = params_result.ast();
+    auto inner = static_cast<ParamListAST *>(param_ast);
+    params = inner->params_;
 
-    // TODO: check for recursive calls here
+    auto ident_sym = ident_tkn.GetSymbol();
+    const SymbolRecord *record = symtab_->Retrieve(ident_sym);
+    bool is_std = is_std_lib_fn(lexer_->Interner().Lookup(ident_sym));
 
-    // if maybe_ast does not have a value, then we assume that
+    // if there is no declaration, then we assume that
     // the symbol is undeclared, UNLESS it's a builtin function
-    if (!maybe_ast.has_value() && !is_std) {
+    if (record == nullptr && !is_std) {
       auto err = add_error(ParseErrorKind::UndeclaredSymbol);
       consume();
-      return std::make_unique<ParseCallResult>(err);
+      return err;
     }
 
-    FnDeclAST &ast = static_cast<FnDeclAST &>(maybe_ast.value());
-    ParamListAST *declared_params =
-        dynamic_cast<ParamListAST *>(ast.params_.get());
-
-    if (!is_std && (declared_params->params_.size() != params.size())) {
-      auto err = add_error(ParseErrorKind::WrongFnParamCount);
-      return std::make_unique<ParseCallResult>(err);
+    if (!is_std && record->kind == SymbolKind::Fn &&
+        record->arity != params.size()) {
+      return add_error(ParseErrorKind::WrongFnParamCount);
     }
 
-    ASTPtr node = std::make_unique<FnCallExprAST>(maybe_ident_tkn.value(),
-                                                  std::move(params), is_std);
-    return std::make_unique<ParseCallResult>(std::move(node));
+    ASTNode *node = ctx_.Create<FnCallExprAST>(ident_tkn, params, is_std);
+    return ParseResultFactory::from_ast(node);
   }
   case TokenKind::Period: {
     auto is_period = match(TokenKind::Period);
     if (is_period.has_value()) {
-      return std::make_unique<ParseCallResult>(is_period.value());
+      return is_period.value();
     }
 
+    // Restored even on an error, so that it does not carry over into the
+    // next declaration.
     check_symtab_for_ident_ = false;
     auto val = expr();
-    if (val->has_error()) {
-      return std::make_unique<ParseCallResult>(val->error());
-    }
     check_symtab_for_ident_ = true;
+    if (val.has_error()) {
+      return val;
+    }
 
-    ASTPtr node = std::make_unique<TableAccessAST>(maybe_ident_tkn.value(),
-                                                   std::move(val->ast()));
-    return std::make_unique<ParseCallResult>(std::move(node));
+    ASTNode *node = ctx_.Create<TableAccessAST>(ident_tkn, val.ast());
+    return ParseResultFactory::from_ast(node);
   }
   case TokenKind::LeftBracket: {
     auto is_lbrack = match(TokenKind::LeftBracket);
     if (is_lbrack.has_value()) {
-      return std::make_unique<ParseCallResult>(is_lbrack.value());
+      return is_lbrack.value();
     }
 
     auto idx = expr();
-    if (idx->has_error()) {
-      return std::make_unique<ParseCallResult>(idx->error());
+    if (idx.has_error()) {
+      return idx;
     }
 
     auto is_rbrack = match(TokenKind::RightBracket);
     if (is_rbrack.has_value()) {
-      return std::make_unique<ParseCallResult>(is_rbrack.value());
+      return is_rbrack.value();
     }
 
-    ASTPtr node = std::make_unique<ArrayAccessAST>(maybe_ident_tkn.value(),
-                                                   std::move(idx->ast()));
-    return ParseResultFactory::from_ast(std::move(node));
+    ASTNode *node = ctx_.Create<ArrayAccessAST>(ident_tkn, idx.ast());
+    return ParseResultFactory::from_ast(node);
   }
   default:
-    break;
+    assert(false && "postfix_expr called without a postfix operator");
+    return add_error(ParseErrorKind::InvalidToken);
   }
-
-  return std::make_unique<ParseCallResult>(std::move(ast));
 }
 
-ParseCallResultPtr Parser::param_list(bool could_be_expr) {
+ParseCallResult Parser::param_list(bool could_be_expr) {
   if (curr_tkn_.GetKind() == TokenKind::RightParen) {
     // Empty param list
-    ASTPtr node = std::make_unique<ParamListAST>(std::vector<ASTPtr>());
-    return std::make_unique<ParseCallResult>(std::move(node));
+    ASTNode *node = ctx_.Create<ParamListAST>(ASTList());
+    return ParseResultFactory::from_ast(node);
   }
 
-  std::vector<ASTPtr> param_list;
+  std::vector<ASTNode *> param_list;
   while (curr_tkn_.GetKind() != TokenKind::RightParen) {
     if (param_list.size() >= FN_PARAM_MAX_LEN) {
-      auto err = add_error(ParseErrorKind::FnParamCountExceeded);
-      return std::make_unique<ParseCallResult>(err);
+      return add_error(ParseErrorKind::FnParamCountExceeded);
     }
 
     if (curr_tkn_.GetKind() == TokenKind::Eof) {
-      auto err = add_error(ParseErrorKind::InvalidToken);
-      return std::make_unique<ParseCallResult>(err);
+      return add_error(ParseErrorKind::InvalidToken);
     }
 
     if (could_be_expr) {
       // Parsing a call here, so the params could be expressions
       auto param = expr();
-      if (param->has_error()) {
+      if (param.has_error()) {
         return param;
       }
-      param_list.push_back(param->ast());
+      param_list.push_back(param.ast());
     } else {
       // Parsing a declaration here, so params are only identifiers
       auto maybe_ident_tkn = match_ident();
       if (!maybe_ident_tkn.has_value()) {
-        auto err = add_error(ParseErrorKind::ExpectedIdent);
-        return std::make_unique<ParseCallResult>(err);
+        return add_error(ParseErrorKind::ExpectedIdent);
       }
 
       auto ident_tkn = maybe_ident_tkn.value();
-      ASTPtr next_param = std::make_unique<LiteralExprAST>(ident_tkn);
-      param_list.push_back(std::move(next_param));
+      ASTNode *next_param = ctx_.Create<LiteralExprAST>(ident_tkn);
+      param_list.push_back(next_param);
     }
 
     if (curr_tkn_.GetKind() != TokenKind::RightParen) {
       auto is_comma = match(TokenKind::Comma);
       if (is_comma.has_value()) {
-        return std::make_unique<ParseCallResult>(is_comma.value());
+        return is_comma.value();
       }
     }
   }
 
-  ASTPtr node = std::make_unique<ParamListAST>(std::move(param_list));
-  return std::make_unique<ParseCallResult>(std::move(node));
+  ASTNode *node = ctx_.Create<ParamListAST>(ctx_.CreateList(param_list));
+  return ParseResultFactory::from_ast(node);
 }
 
-ParseCallResultPtr Parser::group_expr() {
+ParseCallResult Parser::group_expr() {
   auto has_paren = match(TokenKind::LeftParen);
   if (has_paren.has_value()) {
-    return std::make_unique<ParseCallResult>(has_paren.value());
+    return has_paren.value();
   }
 
   auto result = expr();
 
   has_paren = match(TokenKind::RightParen);
   if (has_paren.has_value()) {
-    return std::make_unique<ParseCallResult>(has_paren.value());
+    return has_paren.value();
   }
 
   return result;
@@ -746,61 +611,35 @@ ParseCallResultPtr Parser::group_expr() {
 //              FALSE  |
 //              IDENT  |
 //              groupexpr ;
-ParseCallResultPtr Parser::literal_expr() {
+ParseCallResult Parser::literal_expr() {
   switch (curr_tkn_.GetKind()) {
-  case TokenKind::StringLiteral: {
-    assert(curr_tkn_.GetStringLit().has_value() &&
-           "Current string literal token should have a value");
-
-    auto tkn = TokenFactory::MakeStringLiteralToken(
-        curr_tkn_.GetPos(), curr_tkn_.GetLine(),
-        curr_tkn_.GetStringLit().value());
-    ASTPtr node = std::make_unique<LiteralExprAST>(tkn);
-    consume();
-    return std::make_unique<ParseCallResult>(std::move(node));
-  }
-
   case TokenKind::NumberLiteral: {
-    assert(curr_tkn_.GetNumberLit().has_value() &&
-           "Current number literal token should have a value");
-
-    auto tkn = TokenFactory::MakeNumberLiteralToken(
-        curr_tkn_.GetPos(), curr_tkn_.GetLine(),
-        curr_tkn_.GetNumberLit().value());
-    ASTPtr node = std::make_unique<LiteralExprAST>(tkn);
+    ASTNode *node =
+        ctx_.Create<LiteralExprAST>(curr_tkn_, lexer_->GetNumber(curr_tkn_));
     consume();
-    return std::make_unique<ParseCallResult>(std::move(node));
+    return ParseResultFactory::from_ast(node);
   }
 
+  case TokenKind::StringLiteral:
   case TokenKind::True:
   case TokenKind::False: {
-    auto tkn =
-        Token(curr_tkn_.GetKind(), curr_tkn_.GetPos(), curr_tkn_.GetLine());
-    ASTPtr node = std::make_unique<LiteralExprAST>(tkn);
+    ASTNode *node = ctx_.Create<LiteralExprAST>(curr_tkn_);
     consume();
-    return std::make_unique<ParseCallResult>(std::move(node));
+    return ParseResultFactory::from_ast(node);
   }
 
   case TokenKind::Identifier: {
-    assert(curr_tkn_.GetIdentLit().has_value() &&
-           "Current identifier token should have a value");
-
-    auto tkn =
-        TokenFactory::MakeIdentToken(curr_tkn_.GetPos(), curr_tkn_.GetLine(),
-                                     curr_tkn_.GetIdentLit().value());
-
-    if (check_symtab_for_ident_) {
-      if (!symtab_->Contains(tkn.GetName())) {
-        // TODO: check for std lib function call here
-        auto err = add_error(ParseErrorKind::UndeclaredSymbol);
-        consume();
-        return std::make_unique<ParseCallResult>(err);
-      }
+    auto tkn = curr_tkn_;
+
+    if (!is_declared(tkn, false)) {
+      auto err = add_error(ParseErrorKind::UndeclaredSymbol);
+      consume();
+      return err;
     }
 
-    ASTPtr node = std::make_unique<LiteralExprAST>(tkn);
+    ASTNode *node = ctx_.Create<LiteralExprAST>(tkn);
     consume();
-    return std::make_unique<ParseCallResult>(std::move(node));
+    return ParseResultFactory::from_ast(node);
   }
 
   case TokenKind::LeftParen:
@@ -809,7 +648,7 @@ ParseCallResultPtr Parser::literal_expr() {
   case TokenKind::At: {
     auto has_at = match(TokenKind::At);
     if (has_at.has_value()) {
-      return std::make_unique<ParseCallResult>(has_at.value());
+      return has_at.value();
     }
     return fn_call_expr();
   }
@@ -817,39 +656,152 @@ ParseCallResultPtr Parser::literal_expr() {
   default: {
     auto err = add_error(ParseErrorKind::InvalidToken);
     consume();
-    return std::make_unique<ParseCallResult>(err);
+    return err;
+  }
+  }
+}
+
+ParseCallResult Parser::if_stmt() {
+  auto is_if = match(TokenKind::If);
+  if (is_if.has_value()) {
+    return is_if.value();
+  }
+
+  auto cond = expr();
+  if (cond.has_error()) {
+    return cond;
+  }
+
+  auto if_block = block(std::nullopt);
+  if (if_block.has_error()) {
+    return if_block;
+  }
+
+  std::vector<ASTNode *> elifs;
+  while (curr_tkn_.GetKind() == TokenKind::ElIf) {
+    consume();
+
+    auto elif_cond = expr();
+    if (elif_cond.has_error()) {
+      return elif_cond;
+    }
+
+    auto elif_block = block(std::nullopt);
+    if (elif_block.has_error()) {
+      return elif_block;
+    }
+
+    elifs.push_back(
+        ctx_.Create<ElifStmtAST>(elif_cond.ast(), elif_block.ast()));
+  }
+
+  // The else branch, if any, is stored as a single block.
+  std::vector<ASTNode *> elses;
+  if (curr_tkn_.GetKind() == TokenKind::Else) {
+    consume();
+
+    auto else_block = block(std::nullopt);
+    if (else_block.has_error()) {
+      return else_block;
+    }
+    elses.push_back(else_block.ast());
+  }
+
+  ASTNode *node =
+      ctx_.Create<IfStmtAST>(cond.ast(), if_block.ast(),
+                             ctx_.CreateList(elifs), ctx_.CreateList(elses));
+  return ParseResultFactory::from_ast(node);
+}
+
+ParseCallResult Parser::for_stmt() {
+  auto is_for = match(TokenKind::For);
+  if (is_for.has_value()) {
+    return is_for.value();
+  }
+
+  // Either `for val in ...` or `for idx, val in ...`
+  std::vector<ASTNode *> vars;
+  for (;;) {
+    auto maybe_ident_tkn = match_ident();
+    if (!maybe_ident_tkn.has_value()) {
+      return add_error(ParseErrorKind::InvalidForStmt);
+    }
+    vars.push_back(ctx_.Create<LiteralExprAST>(maybe_ident_tkn.value()));
+
+    if (curr_tkn_.GetKind() != TokenKind::Comma) {
+      break;
+    }
+    consume();
   }
+
+  if (vars.size() > 2) {
+    return add_error(ParseErrorKind::InvalidForStmt);
+  }
+
+  auto is_in = match(TokenKind::In);
+  if (is_in.has_value()) {
+    return is_in.value();
+  }
+
+  auto in_expr = expr();
+  if (in_expr.has_error()) {
+    return in_expr;
+  }
+
+  ASTList var_list = ctx_.CreateList(vars);
+  auto body = block(std::make_optional<ASTList>(var_list));
+  if (body.has_error()) {
+    return body;
   }
+
+  ASTNode *node = ctx_.Create<ForStmtAST>(ctx_.Create<ParamListAST>(var_list),
+                                          in_expr.ast(), body.ast());
+  return ParseResultFactory::from_ast(node);
 }
 
-ParseCallResultPtr Parser::if_stmt() {}
-ParseCallResultPtr Parser::for_stmt() {}
-ParseCallResultPtr Parser::ret_stmt() {}
-ParseCallResultPtr Parser::expr_stmt() {
+ParseCallResult Parser::ret_stmt() {
+  auto is_ret = match(TokenKind::Ret);
+  if (is_ret.has_value()) {
+    return is_ret.value();
+  }
+
+  ASTNode *ret_expr = nullptr;
+  if (curr_tkn_.GetKind() != TokenKind::Semicolon) {
+    auto result = expr();
+    if (result.has_error()) {
+      return result;
+    }
+    ret_expr = result.ast();
+  }
+
+  auto has_semi = match(TokenKind::Semicolon);
+  if (has_semi.has_value()) {
+    return has_semi.value();
+  }
+
+  ASTNode *node = ctx_.Create<ReturnStmtAST>(ret_expr);
+  return ParseResultFactory::from_ast(node);
+}
+
+ParseCallResult Parser::expr_stmt() {
   auto node = expr();
-  if (node->has_error()) {
+  if (node.has_error()) {
     return node;
   }
 
   auto has_semi = match(TokenKind::Semicolon);
   if (has_semi.has_value()) {
-    return std::make_unique<ParseCallResult>(has_semi.value());
+    return has_semi.value();
   }
 
-  ASTPtr result = std::make_unique<ExprStmtAST>(std::move(node->ast()));
-  return std::make_unique<ParseCallResult>(std::move(result));
+  ASTNode *result = ctx_.Create<ExprStmtAST>(node.ast());
+  return ParseResultFactory::from_ast(result);
 }
 
 std::optional<Token> Parser::match_ident() {
   switch (curr_tkn_.GetKind()) {
   case TokenKind::Identifier: {
-    auto tkn =
-        Token(curr_tkn_.GetKind(), curr_tkn_.GetPos(), curr_tkn_.GetLine());
-
-    assert(curr_tkn_.GetIdentLit().has_value() &&
-           "current identifier token should contain an identifier name!");
-
-    tkn.SetIdentLit(curr_tkn_.GetIdentLit().value());
+    auto tkn = curr_tkn_;
     consume();
     return std::make_optional<Token>(tkn);
   }
@@ -859,22 +811,61 @@ std::optional<Token> Parser::match_ident() {
   }
 }
 
-std::optional<ParseError> Parser::match(TokenKind kind) {
+std::optional<ParseCallResult> Parser::match(TokenKind kind) {
   if (curr_tkn_.GetKind() == kind) {
     consume();
     return std::nullopt;
   }
 
-  // TODO: real errors
-  auto err = ParseError(ParseErrorKind::TokenMismatch, curr_tkn_.GetLine(),
-                        curr_tkn_.GetPos());
-  return std::make_optional<ParseError>(err);
+  return std::make_optional<ParseCallResult>(
+      add_error(ParseErrorKind::TokenMismatch));
+}
+
+ParseCallResult Parser::add_error(ParseErrorKind kind) {
+  uint32_t offset = curr_tkn_.GetOffset();
+  auto loc = lexer_->Source().Locate(offset);
+  errors_.push_back(ParseError(kind, offset, loc.line, loc.col));
+  return ParseResultFactory::from_err(errors_.size() - 1);
+}
+
+// The builtin functions are not values, so their names are only declared
+// where they are called.
+bool Parser::is_declared(Token ident_tkn, bool is_callee) {
+  if (!check_symtab_for_ident_) {
+    return true;
+  }
+  const SymbolRecord *record = symtab_->Retrieve(ident_tkn.GetSymbol());
+  if (record != nullptr) {
+    capture(ident_tkn, record->scope);
+    return true;
+  }
+  return is_callee &&
+         is_std_lib_fn(lexer_->Interner().Lookup(ident_tkn.GetSymbol()));
 }
 
-ParseError Parser::add_error(ParseErrorKind kind) {
-  auto err = ParseError(kind, curr_tkn_.GetLine(), curr_tkn_.GetPos());
-  errors_.push_back(err);
-  return err;
+// Names are resolved here, once and lexically, so neither engine ever has
+// to search the code around a function for a variable. A use of a variable
+// declared at the given scope is a capture by every function being parsed
+// that the declaration is outside of. Globals are never captured, as they
+// stay bound for the rest of the program.
+void Parser::capture(Token ident_tkn, int scope) {
+  if (scope == 0) {
+    return;
+  }
+
+  Symbol sym = ident_tkn.GetSymbol();
+  for (size_t i = open_fns_.size(); i-- > 0 && open_fns_[i].level >= scope;) {
+    std::vector<ASTNode *> &captures = open_fns_[i].captures;
+    bool found = false;
+    for (const ASTNode *node : captures) {
+      auto lit = static_cast<const LiteralExprAST *>(node);
+      found = found || lit->lit_tkn_.GetSymbol() == sym;
+    }
+    if (found) {
+      return;
+    }
+    captures.push_back(ctx_.Create<LiteralExprAST>(ident_tkn));
+  }
 }
 
-void Parser::consume() { curr_tkn_ = lexer_->Lex(); }
+void Parser::consume() { curr_tkn_ = tokens_.Next(); }
@@ -0,0 +1,204 @@
+#include "sif/Parser/source_buffer.h"
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace sif;
+
+SourceBuffer::~SourceBuffer() {
+  if (map_len_ != 0) {
+    munmap(const_cast<char *>(data_), map_len_);
+  }
+}
+
+std::unique_ptr<SourceBuffer>
+SourceBuffer::FromFile(const std::string &filename) {
+  int fd = open(filename.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return nullptr;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+    close(fd);
+    return nullptr;
+  }
+
+  auto buf = std::unique_ptr<SourceBuffer>(new SourceBuffer());
+  size_t size = static_cast<size_t>(st.st_size);
+  if (size == 0) {
+    close(fd);
+    buf->data_ = buf->owned_.data();
+    return buf;
+  }
+
+  // The lexer relies on a NUL byte directly after the last character. The
+  // kernel zero fills the tail of the final page of a mapping, so we only map
+  // files whose size is not an exact multiple of the page size.
+  static const size_t page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+  void *addr = MAP_FAILED;
+  if (size % page_size != 0) {
+    addr = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  }
+
+  if (addr != MAP_FAILED) {
+    close(fd);
+    buf->data_ = static_cast<const char *>(addr);
+    buf->size_ = size;
+    buf->map_len_ = size;
+    return buf;
+  }
+
+  // Mapping failed or was skipped, so fall back to reading the whole file
+  // into one buffer. std::string keeps a NUL after its last character.
+  buf->owned_.resize(size);
+  size_t total = 0;
+  while (total < size) {
+    ssize_t n = read(fd, buf->owned_.data() + total, size - total);
+    if (n <= 0) {
+      break;
+    }
+    total += static_cast<size_t>(n);
+  }
+  close(fd);
+
+  buf->owned_.resize(total);
+  buf->data_ = buf->owned_.data();
+  buf->size_ = total;
+  return buf;
+}
+
+std::unique_ptr<SourceBuffer> SourceBuffer::FromString(std::string contents) {
+  auto buf = std::unique_ptr<SourceBuffer>(new SourceBuffer());
+  buf->owned_ = std::move(contents);
+  buf->data_ = buf->owned_.data();
+  buf->size_ = buf->owned_.size();
+  return buf;
+}
+
+std::unique_ptr<SourceBuffer>
+SourceBuffer::FromEdit(const SourceBuffer &source, size_t offset,
+                       size_t removed, std::string_view inserted) {
+  std::string_view text = source.Text();
+  size_t edit_end = offset + removed;
+  std::string contents;
+  contents.reserve(text.size() - removed + inserted.size());
+  contents.append(text.substr(0, offset));
+  contents.append(inserted);
+  contents.append(text.substr(edit_end));
+  auto buf = FromString(std::move(contents));
+
+  const std::vector<uint32_t> &old_starts = source.line_starts_;
+  if (old_starts.empty()) {
+    return buf;
+  }
+
+  // A line starts after each newline. Those before the edit stay where
+  // they are, those in the removed text go, and those after it move.
+  std::vector<uint32_t> &starts = buf->line_starts_;
+  auto first_removed = std::upper_bound(old_starts.begin(), old_starts.end(),
+                                        static_cast<uint32_t>(offset));
+  auto first_moved = std::upper_bound(first_removed, old_starts.end(),
+                                      static_cast<uint32_t>(edit_end));
+  starts.reserve(old_starts.size() + inserted.size());
+  starts.assign(old_starts.begin(), first_removed);
+  for (size_t i = 0; i < inserted.size(); i++) {
+    if (inserted[i] == '\n') {
+      starts.push_back(static_cast<uint32_t>(offset + i + 1));
+    }
+  }
+  uint32_t delta = static_cast<uint32_t>(inserted.size() - removed);
+  for (auto it = first_moved; it != old_starts.end(); ++it) {
+    starts.push_back(*it + delta);
+  }
+  return buf;
+}
+
+std::unique_ptr<SourceBuffer> SourceBuffer::FromStream(std::istream &in,
+                                                       size_t window_size) {
+  auto buf = std::unique_ptr<SourceBuffer>(new SourceBuffer());
+  buf->stream_ = &in;
+  buf->window_size_ = std::max<size_t>(window_size, 1);
+  buf->line_starts_.push_back(0);
+  buf->Refill(0);
+  return buf;
+}
+
+bool SourceBuffer::Refill(size_t keep_from) {
+  assert(IsStream() && keep_from >= base_ && keep_from <= base_ + size_ &&
+         "can only keep text that is in the window");
+  owned_.erase(0, keep_from - base_);
+  base_ = keep_from;
+  if (owned_.size() > window_size_ / 2) {
+    window_size_ *= 2;
+  }
+
+  // std::string keeps a NUL after its last character, whatever was read.
+  size_t kept = owned_.size();
+  owned_.resize(window_size_);
+  stream_->read(owned_.data() + kept,
+                static_cast<std::streamsize>(window_size_ - kept));
+  owned_.resize(kept + static_cast<size_t>(stream_->gcount()));
+  data_ = owned_.data();
+  size_ = owned_.size();
+  index_lines(kept);
+  return size_ > kept;
+}
+
+void SourceBuffer::Release(size_t offset) {
+  auto it = std::upper_bound(line_starts_.begin(), line_starts_.end(),
+                             static_cast<uint32_t>(offset));
+  // Keep the start of the line that offset is on.
+  it--;
+  released_lines_ += static_cast<size_t>(it - line_starts_.begin());
+  line_starts_.erase(line_starts_.begin(), it);
+}
+
+// Adds the lines that start after the window's bytes from on, as they are
+// read rather than when first located, since the text will be gone by
+// then.
+void SourceBuffer::index_lines(size_t from) {
+  const char *curr = data_ + from;
+  const char *end = data_ + size_;
+  while (curr < end) {
+    auto nl = static_cast<const char *>(std::memchr(curr, '\n', static_cast<size_t>(end - curr)));
+    if (nl == nullptr) {
+      break;
+    }
+    line_starts_.push_back(static_cast<uint32_t>(base_ + (nl + 1 - data_)));
+    curr = nl + 1;
+  }
+}
+
+SourceLocation SourceBuffer::Locate(size_t offset) const {
+  if (line_starts_.empty()) {
+    build_line_index();
+  }
+
+  // Find the last line that starts at or before the offset.
+  auto it = std::upper_bound(line_starts_.begin(), line_starts_.end(),
+                             static_cast<uint32_t>(offset));
+  size_t idx = static_cast<size_t>(it - line_starts_.begin()) - 1;
+  return SourceLocation{static_cast<int>(released_lines_ + idx),
+                        static_cast<int>(offset - line_starts_[idx])};
+}
+
+void SourceBuffer::build_line_index() const {
+  line_starts_.push_back(0);
+
+  const char *start = data_;
+  const char *end = data_ + size_;
+  const char *curr = start;
+  while (curr < end) {
+    auto nl = static_cast<const char *>(std::memchr(curr, '\n', static_cast<size_t>(end - curr)));
+    if (nl == nullptr) {
+      break;
+    }
+    line_starts_.push_back(static_cast<uint32_t>(nl + 1 - start));
+    curr = nl + 1;
+  }
+}
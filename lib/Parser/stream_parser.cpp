@@ -0,0 +1,43 @@
+#include "sif/Parser/stream_parser.h"
+#include "sif/Parser/symbol_table.h"
+#include <algorithm>
+#include <cstdint>
+
+using namespace sif;
+
+StreamParser::StreamParser(std::istream &in, StringInterner &interner,
+                           size_t window_size) {
+  auto lexer = std::make_unique<Lexer>(
+      SourceBuffer::FromStream(in, window_size), interner);
+  lexer_ = lexer.get();
+  parser_ = std::make_unique<Parser>(std::move(lexer),
+                                     std::make_unique<SymbolTable>(), ctx_);
+}
+
+bool StreamParser::Parse(const DeclHandler &handler) {
+  bool found_error = false;
+  while (!parser_->AtEnd()) {
+    auto result = parser_->ParseDecl();
+
+    // Malformed tokens up to the next declaration belong to this one, and
+    // at the end of the stream so does everything left.
+    std::vector<ParseError> errors = parser_->Errors();
+    std::vector<ParseError> lex_errors = lexer_->TakeErrors(
+        parser_->AtEnd() ? SIZE_MAX : parser_->DeclOffset());
+    errors.insert(errors.end(), lex_errors.begin(), lex_errors.end());
+    std::stable_sort(errors.begin(), errors.end(),
+                     [](const ParseError &a, const ParseError &b) {
+                       if (a.Line() != b.Line()) {
+                         return a.Line() < b.Line();
+                       }
+                       return a.Pos() < b.Pos();
+                     });
+    parser_->ClearErrors();
+    found_error = found_error || !result.has_ast() || !errors.empty();
+
+    handler(result.has_ast() ? result.ast() : nullptr, errors);
+    ctx_.Reset();
+    lexer_->Release(parser_->DeclOffset());
+  }
+  return !found_error;
+}
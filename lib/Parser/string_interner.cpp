@@ -0,0 +1,95 @@
+#include "sif/Parser/string_interner.h"
+#include <cstring>
+
+using namespace sif;
+
+namespace {
+const size_t INITIAL_SLOTS = 1024;
+const size_t CHUNK_SIZE = 64 * 1024;
+} // namespace
+
+StringInterner::StringInterner() {
+  slots_.resize(INITIAL_SLOTS, 0);
+  chunk_curr_ = nullptr;
+  chunk_end_ = nullptr;
+}
+
+Symbol StringInterner::Intern(std::string_view str) {
+  uint32_t h = hash(str);
+  size_t mask = slots_.size() - 1;
+  size_t idx = h & mask;
+
+  for (;;) {
+    uint32_t slot = slots_[idx];
+    if (slot == 0) {
+      break;
+    }
+
+    Symbol sym = slot - 1;
+    if (hashes_[sym] == h && strings_[sym] == str) {
+      return sym;
+    }
+    idx = (idx + 1) & mask;
+  }
+
+  Symbol sym = static_cast<Symbol>(strings_.size());
+  strings_.push_back(std::string_view(store(str), str.size()));
+  hashes_.push_back(h);
+  slots_[idx] = sym + 1;
+
+  // Keep the load factor under one half so probe sequences stay short.
+  if (strings_.size() * 2 > slots_.size()) {
+    grow();
+  }
+  return sym;
+}
+
+uint32_t StringInterner::hash(std::string_view str) {
+  // FNV-1a. Identifiers are short, so this beats anything that needs a
+  // setup or finalisation step.
+  uint32_t h = 2166136261u;
+  for (char c : str) {
+    h ^= static_cast<uint8_t>(c);
+    h *= 16777619u;
+  }
+  return h;
+}
+
+const char *StringInterner::store(std::string_view str) {
+  if (str.empty()) {
+    return "";
+  }
+
+  if (static_cast<size_t>(chunk_end_ - chunk_curr_) < str.size()) {
+    // Very long strings get a chunk of their own so they do not waste the
+    // tail of the current one.
+    size_t size = str.size() > CHUNK_SIZE / 4 ? str.size() : CHUNK_SIZE;
+    chunks_.push_back(std::unique_ptr<char[]>(new char[size]));
+    if (size != CHUNK_SIZE) {
+      std::memcpy(chunks_.back().get(), str.data(), str.size());
+      return chunks_.back().get();
+    }
+    chunk_curr_ = chunks_.back().get();
+    chunk_end_ = chunk_curr_ + size;
+  }
+
+  char *dest = chunk_curr_;
+  std::memcpy(dest, str.data(), str.size());
+  chunk_curr_ += str.size();
+  return dest;
+}
+
+void StringInterner::grow() {
+  std::vector<uint32_t> next(slots_.size() * 2, 0);
+  size_t mask = next.size() - 1;
+
+  for (Symbol sym = 0; sym < strings_.size(); sym++) {
+    size_t idx = hashes_[sym] & mask;
+    while (next[idx] != 0) {
+      idx = (idx + 1) & mask;
+    }
+    next[idx] = sym + 1;
+  }
+
+  slots_ = std::move(next);
+}
@@ -1,22 +1,119 @@
 #include "sif/Parser/symbol_table.h"
 #include "sif/Parser/ast.h"
-#include <optional>
-#include <string>
-#include <unordered_map>
+#include <cassert>
 
 using namespace sif;
 
-std::optional<ASTNode> SymbolTable::Retrieve(std::string key) {
-  int curr = curr_level_;
-  for (;;) {
-    if (curr < 0) {
-      return std::nullopt;
+SymbolTable::SymbolTable() : SymbolTable(nullptr) {}
+
+SymbolTable::SymbolTable(const SymbolTable *base) {
+  slots_.resize(INITIAL_SLOTS, Slot{NO_BINDING, NO_BINDING});
+  used_slots_ = 0;
+  base_ = base;
+  log_ = nullptr;
+}
+
+void SymbolTable::CloseScope() {
+  if (scope_marks_.empty()) {
+    return;
+  }
+
+  uint32_t mark = scope_marks_.back();
+  scope_marks_.pop_back();
+
+  // Undo the scope's bindings newest first, so a symbol declared twice in
+  // it ends up pointing at whatever it shadowed on entry.
+  while (bindings_.size() > mark) {
+    const Binding &binding = bindings_.back();
+    slots_[find_slot(binding.key)].head = binding.shadowed;
+    bindings_.pop_back();
+  }
+}
+
+void SymbolTable::Store(Symbol key, SymbolKind kind, uint32_t arity,
+                        ASTNode *node) {
+  size_t idx = find_slot(key);
+  Slot &slot = slots_[idx];
+  SymbolRecord record = SymbolRecord{kind, arity, Level(), node};
+  if (log_ != nullptr && record.scope == 0) {
+    log_->push_back(SymbolEvent{key, true, true, kind, arity, node});
+  }
+
+  if (slot.head != NO_BINDING &&
+      bindings_[slot.head].record.scope == record.scope) {
+    bindings_[slot.head].record = record;
+    return;
+  }
+
+  if (slot.key == NO_BINDING) {
+    slot.key = key;
+    used_slots_++;
+  }
+
+  bindings_.push_back(Binding{record, key, slot.head});
+  slot.head = static_cast<uint32_t>(bindings_.size() - 1);
+
+  // Keep the load factor under one half so probe sequences stay short.
+  if (used_slots_ * 2 > slots_.size()) {
+    grow();
+  }
+}
+
+void SymbolTable::Unbind(Symbol key) {
+  assert(!bindings_.empty() && bindings_.back().key == key &&
+         bindings_.back().record.scope == Level() &&
+         "only the newest binding can be undone");
+  slots_[find_slot(key)].head = bindings_.back().shadowed;
+  bindings_.pop_back();
+}
+
+const SymbolRecord *SymbolTable::Retrieve(Symbol key) const {
+  const Slot &slot = slots_[find_slot(key)];
+  const SymbolRecord *record = nullptr;
+  if (slot.head != NO_BINDING) {
+    record = &bindings_[slot.head].record;
+  } else if (base_ != nullptr) {
+    record = base_->Retrieve(key);
+  }
+  SIF_COUNT(count_lookup(record != nullptr));
+  if (log_ != nullptr) {
+    if (record == nullptr) {
+      log_->push_back(SymbolEvent{key, false, false, SymbolKind::Var, 0,
+                                  nullptr});
+    } else if (record->scope == 0) {
+      log_->push_back(SymbolEvent{key, false, true, record->kind,
+                                  record->arity, record->node});
     }
+  }
+  return record;
+}
+
+size_t SymbolTable::find_slot(Symbol key) const {
+  size_t mask = slots_.size() - 1;
+  size_t idx = hash(key) & mask;
+
+  while (slots_[idx].key != key && slots_[idx].key != NO_BINDING) {
+    idx = (idx + 1) & mask;
+  }
+  return idx;
+}
+
+void SymbolTable::count_lookup(bool hit) const {
+  size_t level = scope_marks_.size();
+  if (level >= lookup_counts_.size()) {
+    lookup_counts_.resize(level + 1, LookupCount{0, 0});
+  }
+  lookup_counts_[level].probes++;
+  lookup_counts_[level].hits += hit;
+}
+
+void SymbolTable::grow() {
+  std::vector<Slot> old = std::move(slots_);
+  slots_.assign(old.size() * 2, Slot{NO_BINDING, NO_BINDING});
 
-    if (table_.at(curr).contains(key)) {
-      return std::make_optional(table_.at(curr)[key]);
-    } else {
-      curr--;
+  for (const Slot &slot : old) {
+    if (slot.key != NO_BINDING) {
+      slots_[find_slot(slot.key)] = slot;
     }
   }
 }
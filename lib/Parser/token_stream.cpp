@@ -0,0 +1,65 @@
+#include "sif/Parser/token_stream.h"
+#include <algorithm>
+#include <cassert>
+
+using namespace sif;
+
+TokenStream::TokenStream(Lexer &lexer, size_t batch_size) : lexer_(lexer) {
+  assert(batch_size > 0 && "batch size must be positive");
+
+  // Room for a full batch after as much lookahead as Peek allows.
+  buf_.resize(batch_size + MAX_LOOKAHEAD);
+  head_ = 0;
+  tail_ = 0;
+  batch_size_ = batch_size;
+  lexed_eof_ = false;
+}
+
+TokenStream::TokenStream(Lexer &lexer, std::vector<Token> tokens)
+    : TokenStream(lexer) {
+  if (!tokens.empty()) {
+    assert(tokens.back().GetKind() == TokenKind::Eof &&
+           "pre-lexed tokens must end with Eof");
+    buf_ = std::move(tokens);
+    tail_ = buf_.size();
+    lexed_eof_ = true;
+    // Seek may go back to lexing into the same buffer.
+    if (tail_ < batch_size_ + MAX_LOOKAHEAD) {
+      buf_.resize(batch_size_ + MAX_LOOKAHEAD);
+    }
+  }
+}
+
+void TokenStream::Seek(size_t offset) {
+  head_ = 0;
+  tail_ = 0;
+  lexed_eof_ = false;
+  lexer_.Seek(offset);
+}
+
+void TokenStream::refill(size_t count) {
+  // Next has just returned the Eof token, which it keeps returning.
+  if (lexed_eof_ && head_ == tail_) {
+    head_--;
+  }
+
+  // Move the tokens that are still to come to the front, then lex after
+  // them. Fewer than count are left, so the buffer never grows.
+  std::copy(buf_.begin() + head_, buf_.begin() + tail_, buf_.begin());
+  tail_ -= head_;
+  head_ = 0;
+
+  if (!lexed_eof_ && tail_ < count) {
+    size_t want = std::max(batch_size_, count - tail_);
+    tail_ += lexer_.LexBatch(&buf_[tail_], want);
+    lexed_eof_ = buf_[tail_ - 1].GetKind() == TokenKind::Eof;
+  }
+
+  // Past the end, padding with Eof lets Peek look as far ahead as it likes
+  // without checking for it.
+  if (lexed_eof_ && tail_ < MAX_LOOKAHEAD) {
+    std::fill(buf_.begin() + tail_, buf_.begin() + MAX_LOOKAHEAD,
+              buf_[tail_ - 1]);
+    tail_ = MAX_LOOKAHEAD;
+  }
+}
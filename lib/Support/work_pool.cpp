@@ -0,0 +1,108 @@
+#include "sif/Support/work_pool.h"
+#include <algorithm>
+
+using namespace sif;
+
+WorkPool::WorkPool(size_t num_threads) {
+  if (num_threads == 0) {
+    num_threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+
+  fn_ = nullptr;
+  pending_ = 0;
+  generation_ = 0;
+  stop_ = false;
+  for (size_t i = 0; i < num_threads; i++) {
+    queues_.push_back(std::make_unique<TaskQueue>());
+  }
+  for (size_t i = 0; i < num_threads; i++) {
+    workers_.emplace_back([this, i] { work(i); });
+  }
+}
+
+WorkPool::~WorkPool() {
+  {
+    std::lock_guard<std::mutex> lock(mu_);
+    stop_ = true;
+  }
+  work_cv_.notify_all();
+  for (std::thread &worker : workers_) {
+    worker.join();
+  }
+}
+
+void WorkPool::ForEach(size_t count, const std::function<void(size_t)> &fn) {
+  if (count == 0) {
+    return;
+  }
+
+  // A worker still looking for work from the last batch may pick up one of
+  // these tasks as soon as it is queued, so the batch state is set first.
+  // The queue locks publish it to whichever worker takes the task.
+  pending_ = count;
+  fn_ = &fn;
+  size_t num_queues = queues_.size();
+  for (size_t q = 0; q < num_queues; q++) {
+    size_t begin = count * q / num_queues;
+    size_t end = count * (q + 1) / num_queues;
+    std::lock_guard<std::mutex> lock(queues_[q]->mu);
+    for (size_t i = begin; i < end; i++) {
+      queues_[q]->tasks.push_back(i);
+    }
+  }
+
+  std::unique_lock<std::mutex> lock(mu_);
+  generation_++;
+  work_cv_.notify_all();
+  done_cv_.wait(lock, [this] { return pending_ == 0; });
+  fn_ = nullptr;
+}
+
+void WorkPool::work(size_t self) {
+  uint64_t seen = 0;
+  for (;;) {
+    {
+      std::unique_lock<std::mutex> lock(mu_);
+      work_cv_.wait(lock, [&] { return stop_ || generation_ != seen; });
+      if (stop_) {
+        return;
+      }
+      seen = generation_;
+    }
+
+    size_t task;
+    while (take(self, task)) {
+      (*fn_)(task);
+      if (pending_.fetch_sub(1) == 1) {
+        // Taking the lock orders this with the caller's check of pending_,
+        // so the wakeup cannot be missed.
+        std::lock_guard<std::mutex> lock(mu_);
+        done_cv_.notify_all();
+      }
+    }
+  }
+}
+
+bool WorkPool::take(size_t self, size_t &task) {
+  {
+    TaskQueue &own = *queues_[self];
+    std::lock_guard<std::mutex> lock(own.mu);
+    if (!own.tasks.empty()) {
+      task = own.tasks.back();
+      own.tasks.pop_back();
+      return true;
+    }
+  }
+
+  size_t num_queues = queues_.size();
+  for (size_t i = 1; i < num_queues; i++) {
+    TaskQueue &victim = *queues_[(self + i) % num_queues];
+    std::lock_guard<std::mutex> lock(victim.mu);
+    if (!victim.tasks.empty()) {
+      task = victim.tasks.front();
+      victim.tasks.pop_front();
+      return true;
+    }
+  }
+  return false;
+}
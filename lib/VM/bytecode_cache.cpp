@@ -0,0 +1,523 @@
+#include "sif/VM/bytecode_cache.h"
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace sif;
+
+namespace {
+// Bump whenever the file layout, the meaning of any instruction, or what
+// the compiler emits for some source changes.
+const uint32_t CACHE_VERSION = 6;
+const char CACHE_MAGIC[4] = {'S', 'I', 'F', 'C'};
+const uint64_t DEFAULT_MAX_BYTES = 64 << 20;
+
+// Identifies the build that wrote a file, so a file written by sif built
+// with another compiler, or with another instruction set, misses even if
+// CACHE_VERSION was not bumped.
+#define SIF_OPCODE_NAME(name) #name ","
+const char BUILD_FINGERPRINT[] =
+    __VERSION__ ";" SIF_OPCODES(SIF_OPCODE_NAME);
+#undef SIF_OPCODE_NAME
+
+#define SIF_OPCODE_COUNT(name) +1
+const unsigned NUM_OPCODES = 0 SIF_OPCODES(SIF_OPCODE_COUNT);
+#undef SIF_OPCODE_COUNT
+
+// A cache file is a FileHeader, then a ProtoRecord per proto, a ConstRecord
+// per constant, each proto's code, the bytes of the string constants and
+// last a copy of the source, found at source_at.
+// Everything is stored in the host's byte order.
+struct FileHeader {
+  char magic[4];
+  uint32_t version;
+  uint64_t build_id;
+  uint64_t source_hash;
+  uint64_t source_at;
+  uint64_t source_size;
+  uint32_t num_protos;
+  uint32_t num_constants;
+  uint32_t num_globals;
+  uint32_t strings_size;
+};
+
+// code_at is the file offset of the proto's instructions, which are
+// followed directly by the same number of source offsets.
+struct ProtoRecord {
+  uint32_t code_at;
+  uint32_t code_size;
+  uint32_t arity;
+  uint32_t num_regs;
+  uint32_t num_upvals;
+};
+
+// bits holds a number's bit pattern, a bool, a proto index, or the file
+// offset of a string's bytes, in which case size is its length.
+struct ConstRecord {
+  uint32_t kind;
+  uint32_t size;
+  uint64_t bits;
+};
+
+static_assert(sizeof(FileHeader) == 56);
+static_assert(sizeof(ProtoRecord) == 20);
+static_assert(sizeof(ConstRecord) == 16);
+
+template <typename T> void append(std::string &buf, const T &val) {
+  buf.append(reinterpret_cast<const char *>(&val), sizeof(T));
+}
+
+template <typename T> T read_at(const char *data, size_t at) {
+  T val;
+  std::memcpy(&val, data + at, sizeof(T));
+  return val;
+}
+
+bool make_dirs(const std::string &dir) {
+  for (size_t i = 1; i <= dir.size(); i++) {
+    if (i == dir.size() || dir[i] == '/') {
+      std::string prefix = dir.substr(0, i);
+      if (mkdir(prefix.c_str(), 0755) != 0 && errno != EEXIST) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+bool write_file(const std::string &path, const std::string &contents) {
+  int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    return false;
+  }
+
+  size_t total = 0;
+  while (total < contents.size()) {
+    ssize_t n = write(fd, contents.data() + total, contents.size() - total);
+    if (n <= 0) {
+      close(fd);
+      return false;
+    }
+    total += static_cast<size_t>(n);
+  }
+  return close(fd) == 0;
+}
+
+// Checks every operand of a proto's code in one pass: registers against
+// the proto's registers, constant, global, upvalue and proto indices
+// against their tables, and jump targets against the code. Only a closure
+// can run a proto with upvalues, so Call must not target one. The code
+// must end in an instruction that cannot fall through, so that pc never
+// leaves it.
+bool valid_code(const FnProto &proto, const BytecodeProgram &program,
+                size_t source_size) {
+  uint32_t regs = proto.num_regs;
+  uint32_t size = static_cast<uint32_t>(proto.code.size());
+  auto jump_ok = [&](uint32_t at, Instr ins) {
+    int64_t target = int64_t(at) + 1 + arg_sbx(ins);
+    return target >= 0 && target < size;
+  };
+
+  for (uint32_t at = 0; at < size; at++) {
+    Instr ins = proto.code[at];
+    uint32_t a = arg_a(ins);
+    uint32_t b = arg_b(ins);
+    uint32_t c = arg_c(ins);
+    uint32_t bx = arg_bx(ins);
+    if (static_cast<unsigned>(op_of(ins)) >= NUM_OPCODES ||
+        proto.offsets[at] > source_size) {
+      return false;
+    }
+
+    bool ok;
+    switch (op_of(ins)) {
+    case OpCode::LoadK:
+      ok = a < regs && bx < program.constants_.size();
+      break;
+    case OpCode::LoadNil:
+    case OpCode::LoadBool:
+    case OpCode::Ret:
+      ok = a < regs;
+      break;
+    case OpCode::Move:
+    case OpCode::Neg:
+    case OpCode::Not:
+      ok = a < regs && b < regs;
+      break;
+    case OpCode::GetGlobal:
+    case OpCode::SetGlobal:
+      ok = a < regs && bx < program.num_globals_;
+      break;
+    case OpCode::GetUpval:
+    case OpCode::SetUpval:
+      ok = a < regs && bx < proto.num_upvals;
+      break;
+    case OpCode::Closure:
+      // The instructions saying what to capture follow, and are checked as
+      // instructions of their own.
+      ok = a < regs && bx < program.protos_.size() &&
+           size - at - 1 >= program.protos_[bx].num_upvals;
+      for (uint32_t i = 1; ok && i <= program.protos_[bx].num_upvals; i++) {
+        OpCode capture = op_of(proto.code[at + i]);
+        ok = capture == OpCode::Move || capture == OpCode::GetUpval;
+      }
+      break;
+    case OpCode::Close:
+      ok = a < regs;
+      break;
+    case OpCode::Jmp:
+      ok = jump_ok(at, ins);
+      break;
+    case OpCode::JmpFalse:
+    case OpCode::JmpTrue:
+      ok = a < regs && jump_ok(at, ins);
+      break;
+    case OpCode::Call:
+      // The arguments go in the registers after A.
+      ok = bx < program.protos_.size() &&
+           program.protos_[bx].num_upvals == 0 &&
+           a + program.protos_[bx].arity < regs;
+      break;
+    case OpCode::CallValue:
+      ok = a + b < regs;
+      break;
+    case OpCode::RetNil:
+      ok = true;
+      break;
+    case OpCode::Print:
+      ok = a < regs && a + b <= regs;
+      break;
+    case OpCode::ForPrep:
+    case OpCode::ForLoop:
+      // The iterated value, the count, the element and the index.
+      ok = a + 3 < regs && jump_ok(at, ins);
+      break;
+    default:
+      // The binary operators and Range.
+      ok = a < regs && b < regs && c < regs;
+      break;
+    }
+    if (!ok) {
+      return false;
+    }
+  }
+
+  OpCode last = op_of(proto.code[size - 1]);
+  return last == OpCode::Ret || last == OpCode::RetNil || last == OpCode::Jmp;
+}
+
+uint64_t build_id() {
+  static const uint64_t id = BytecodeCache::Hash(BUILD_FINGERPRINT);
+  return id;
+}
+} // namespace
+
+uint64_t BytecodeCache::Hash(std::string_view text) {
+  // FNV-1a style, but a word at a time so hashing stays well ahead of the
+  // lexer on large scripts.
+  const uint64_t prime = 1099511628211ull;
+  uint64_t h = 14695981039346656037ull ^ text.size();
+  size_t i = 0;
+  for (; i + 8 <= text.size(); i += 8) {
+    h = (h ^ read_at<uint64_t>(text.data(), i)) * prime;
+    h ^= h >> 29;
+  }
+  for (; i < text.size(); i++) {
+    h = (h ^ static_cast<uint8_t>(text[i])) * prime;
+  }
+  return h;
+}
+
+bool BytecodeCache::Load(const SourceBuffer &source,
+                         BytecodeProgram &out) const {
+  uint64_t hash = Hash(source.Text());
+  std::unique_ptr<SourceBuffer> file = SourceBuffer::FromFile(path_for(hash));
+  if (file == nullptr) {
+    return false;
+  }
+
+  const char *data = file->Text().data();
+  size_t size = file->Size();
+  if (size < sizeof(FileHeader)) {
+    return false;
+  }
+
+  auto header = read_at<FileHeader>(data, 0);
+  if (std::memcmp(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0 ||
+      header.version != CACHE_VERSION || header.build_id != build_id() ||
+      header.source_hash != hash || header.source_size != source.Size() ||
+      header.num_protos == 0) {
+    return false;
+  }
+
+  // A hash can collide, so the file is only used for the very source it
+  // was written for.
+  if (header.source_at > size || size - header.source_at < source.Size() ||
+      std::memcmp(data + header.source_at, source.Text().data(),
+                  source.Size()) != 0) {
+    return false;
+  }
+
+  uint64_t at = sizeof(FileHeader);
+  uint64_t records_end = at + header.num_protos * sizeof(ProtoRecord) +
+                         header.num_constants * sizeof(ConstRecord);
+  if (records_end > size) {
+    return false;
+  }
+
+  BytecodeProgram program;
+  program.protos_.reserve(header.num_protos);
+  for (uint32_t i = 0; i < header.num_protos;
+       i++, at += sizeof(ProtoRecord)) {
+    auto rec = read_at<ProtoRecord>(data, at);
+    uint64_t code_end = rec.code_at + rec.code_size * uint64_t(8);
+    if (rec.code_at % alignof(Instr) != 0 || rec.code_size == 0 ||
+        code_end > size || rec.num_regs > 256 || rec.arity > rec.num_regs ||
+        (i == 0 && rec.num_upvals != 0)) {
+      return false;
+    }
+
+    // The mapping is page aligned, so aligned offsets are aligned pointers.
+    auto code = reinterpret_cast<const Instr *>(data + rec.code_at);
+    auto offsets = reinterpret_cast<const uint32_t *>(code + rec.code_size);
+    program.protos_.push_back(FnProto{
+        std::span<const Instr>(code, rec.code_size),
+        std::span<const uint32_t>(offsets, rec.code_size), rec.arity,
+        rec.num_regs, rec.num_upvals});
+  }
+
+  program.constants_.reserve(header.num_constants);
+  for (uint32_t i = 0; i < header.num_constants;
+       i++, at += sizeof(ConstRecord)) {
+    auto rec = read_at<ConstRecord>(data, at);
+    switch (static_cast<ValueKind>(rec.kind)) {
+    case ValueKind::Nil:
+      program.constants_.push_back(Value());
+      break;
+    case ValueKind::Bool:
+      program.constants_.push_back(Value::FromBool(rec.bits != 0));
+      break;
+    case ValueKind::Number: {
+      double num;
+      std::memcpy(&num, &rec.bits, sizeof(num));
+      program.constants_.push_back(Value::FromNumber(num));
+      break;
+    }
+    case ValueKind::String:
+      if (rec.bits > size || rec.size > size - rec.bits) {
+        return false;
+      }
+      program.constants_.push_back(
+          Value::FromString(std::string_view(data + rec.bits, rec.size)));
+      break;
+    case ValueKind::CompiledFn:
+      if (rec.bits >= header.num_protos ||
+          program.protos_[rec.bits].num_upvals != 0) {
+        return false;
+      }
+      program.constants_.push_back(
+          Value::FromProto(static_cast<uint32_t>(rec.bits)));
+      break;
+    default:
+      return false;
+    }
+  }
+
+  program.num_globals_ = header.num_globals;
+  for (const FnProto &proto : program.protos_) {
+    if (!valid_code(proto, program, source.Size())) {
+      return false;
+    }
+  }
+
+  // Only the access time changes, so the file is still the one a later
+  // Load finds. Failing to set it only makes the file look older.
+  const struct timespec times[2] = {{0, UTIME_NOW}, {0, UTIME_OMIT}};
+  utimensat(AT_FDCWD, path_for(hash).c_str(), times, 0);
+
+  program.mapping_ = std::move(file);
+  out = std::move(program);
+  return true;
+}
+
+bool BytecodeCache::Store(const SourceBuffer &source,
+                          const BytecodeProgram &program) const {
+  const std::vector<FnProto> &protos = program.protos_;
+  const std::vector<Value> &constants = program.constants_;
+
+  size_t code_at = sizeof(FileHeader) + protos.size() * sizeof(ProtoRecord) +
+                   constants.size() * sizeof(ConstRecord);
+  size_t strings_at = code_at;
+  for (const FnProto &proto : protos) {
+    strings_at += proto.code.size() * 8;
+  }
+
+  std::string buf;
+  uint32_t strings_size = 0;
+  for (const Value &val : constants) {
+    if (val.Kind() == ValueKind::String) {
+      strings_size += static_cast<uint32_t>(val.GetString().size());
+    }
+  }
+  buf.reserve(strings_at + strings_size + source.Size());
+
+  FileHeader header;
+  std::memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+  header.version = CACHE_VERSION;
+  header.build_id = build_id();
+  header.source_hash = Hash(source.Text());
+  header.source_at = strings_at + strings_size;
+  header.source_size = source.Size();
+  header.num_protos = static_cast<uint32_t>(protos.size());
+  header.num_constants = static_cast<uint32_t>(constants.size());
+  header.num_globals = program.num_globals_;
+  header.strings_size = strings_size;
+  append(buf, header);
+
+  for (const FnProto &proto : protos) {
+    uint32_t code_size = static_cast<uint32_t>(proto.code.size());
+    append(buf, ProtoRecord{static_cast<uint32_t>(code_at), code_size,
+                            proto.arity, proto.num_regs, proto.num_upvals});
+    code_at += code_size * 8;
+  }
+
+  size_t string_at = strings_at;
+  for (const Value &val : constants) {
+    ConstRecord rec = ConstRecord{static_cast<uint32_t>(val.Kind()), 0, 0};
+    switch (val.Kind()) {
+    case ValueKind::Nil:
+      break;
+    case ValueKind::Bool:
+      rec.bits = val.GetBool();
+      break;
+    case ValueKind::Number: {
+      double num = val.GetNumber();
+      std::memcpy(&rec.bits, &num, sizeof(num));
+      break;
+    }
+    case ValueKind::String:
+      rec.size = static_cast<uint32_t>(val.GetString().size());
+      rec.bits = string_at;
+      string_at += rec.size;
+      break;
+    case ValueKind::CompiledFn:
+      rec.bits = val.GetProto();
+      break;
+    default:
+      // Nothing else can appear in a constant pool.
+      return false;
+    }
+    append(buf, rec);
+  }
+
+  for (const FnProto &proto : protos) {
+    buf.append(reinterpret_cast<const char *>(proto.code.data()),
+               proto.code.size_bytes());
+    buf.append(reinterpret_cast<const char *>(proto.offsets.data()),
+               proto.offsets.size_bytes());
+  }
+  for (const Value &val : constants) {
+    if (val.Kind() == ValueKind::String) {
+      buf.append(val.GetString());
+    }
+  }
+  buf.append(source.Text());
+
+  if (!make_dirs(dir_)) {
+    return false;
+  }
+
+  // Write to a private file and rename it into place, so a concurrent Load
+  // sees either no file or a complete one.
+  std::string path = path_for(header.source_hash);
+  std::string tmp_path = path + ".tmp" + std::to_string(getpid());
+  if (!write_file(tmp_path, buf) ||
+      std::rename(tmp_path.c_str(), path.c_str()) != 0) {
+    unlink(tmp_path.c_str());
+    return false;
+  }
+  evict(path);
+  return true;
+}
+
+// Removes the least recently used cache files, other than keep, until the
+// rest fit in max_bytes_. Another process may be evicting at the same
+// time, or have a removed file mapped, which is harmless either way.
+void BytecodeCache::evict(const std::string &keep) const {
+  struct Entry {
+    struct timespec used;
+    uint64_t size;
+    std::string path;
+  };
+
+  DIR *dir = opendir(dir_.c_str());
+  if (dir == nullptr) {
+    return;
+  }
+  std::vector<Entry> entries;
+  uint64_t total = 0;
+  while (const struct dirent *ent = readdir(dir)) {
+    std::string_view name = ent->d_name;
+    struct stat st;
+    std::string path = dir_ + "/" + ent->d_name;
+    if (!name.ends_with(".sifc") || stat(path.c_str(), &st) != 0) {
+      continue;
+    }
+    total += static_cast<uint64_t>(st.st_size);
+    entries.push_back(Entry{st.st_atim, static_cast<uint64_t>(st.st_size),
+                            std::move(path)});
+  }
+  closedir(dir);
+  if (total <= max_bytes_) {
+    return;
+  }
+
+  std::sort(entries.begin(), entries.end(),
+            [](const Entry &lhs, const Entry &rhs) {
+              if (lhs.used.tv_sec != rhs.used.tv_sec) {
+                return lhs.used.tv_sec < rhs.used.tv_sec;
+              }
+              return lhs.used.tv_nsec < rhs.used.tv_nsec;
+            });
+  for (const Entry &entry : entries) {
+    if (total <= max_bytes_) {
+      break;
+    }
+    if (entry.path != keep && unlink(entry.path.c_str()) == 0) {
+      total -= entry.size;
+    }
+  }
+}
+
+std::string BytecodeCache::DefaultDir() {
+  if (const char *dir = std::getenv("SIF_CACHE_DIR")) {
+    return dir;
+  }
+  if (const char *xdg = std::getenv("XDG_CACHE_HOME")) {
+    return std::string(xdg) + "/sif";
+  }
+  if (const char *home = std::getenv("HOME")) {
+    return std::string(home) + "/.cache/sif";
+  }
+  return "";
+}
+
+uint64_t BytecodeCache::DefaultMaxBytes() {
+  if (const char *size = std::getenv("SIF_CACHE_SIZE")) {
+    return std::strtoull(size, nullptr, 10);
+  }
+  return DEFAULT_MAX_BYTES;
+}
+
+std::string BytecodeCache::path_for(uint64_t hash) const {
+  char name[32];
+  std::snprintf(name, sizeof(name), "%016llx.sifc",
+                static_cast<unsigned long long>(hash));
+  return dir_ + "/" + name;
+}
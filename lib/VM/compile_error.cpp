@@ -0,0 +1,55 @@
+#include "sif/VM/compile_error.h"
+#include <string>
+
+using namespace sif;
+
+bool CompileError::IsLimit() {
+  switch (kind_) {
+  case CompileErrorKind::TooManyRegisters:
+  case CompileErrorKind::TooManyConstants:
+  case CompileErrorKind::TooManyGlobals:
+  case CompileErrorKind::TooManyFunctions:
+  case CompileErrorKind::TooManyUpvalues:
+  case CompileErrorKind::JumpTooFar:
+    return true;
+  default:
+    return false;
+  }
+}
+
+std::string CompileError::error_to_msg() {
+  std::string msg;
+  switch (kind_) {
+  case CompileErrorKind::UndefinedSymbol:
+    msg = "undefined symbol";
+    break;
+  case CompileErrorKind::TooManyRegisters:
+    msg = "function needs too many registers";
+    break;
+  case CompileErrorKind::TooManyConstants:
+    msg = "program has too many constants";
+    break;
+  case CompileErrorKind::TooManyGlobals:
+    msg = "program has too many globals";
+    break;
+  case CompileErrorKind::TooManyFunctions:
+    msg = "program has too many functions";
+    break;
+  case CompileErrorKind::TooManyUpvalues:
+    msg = "function captures too many variables";
+    break;
+  case CompileErrorKind::JumpTooFar:
+    msg = "block is too large to jump over";
+    break;
+  case CompileErrorKind::UnsupportedExpr:
+    msg = "expression is not supported by the vm";
+    break;
+  case CompileErrorKind::WrongArgCount:
+    msg = "wrong number of arguments";
+    break;
+  }
+
+  // Lines and columns are stored zero based.
+  return msg + " at line " + std::to_string(line_ + 1) + ", column " +
+         std::to_string(pos_ + 1);
+}
@@ -0,0 +1,936 @@
+#include "sif/VM/compiler.h"
+#include <algorithm>
+#include <bit>
+
+using namespace sif;
+
+Compiler::Compiler(const SourceBuffer &source, StringInterner &interner)
+    : source_(source), interner_(interner) {
+  out_ = nullptr;
+  curr_offset_ = 0;
+  error_ = std::nullopt;
+  print_sym_ = interner_.Intern("print");
+  range_sym_ = interner_.Intern("range");
+}
+
+bool Compiler::Compile(const ProgramAST *program, BytecodeProgram &out) {
+  out_ = &out;
+  out_->protos_.push_back(FnProto{{}, {}, 0, 0, 0});
+
+  // Globals are exactly the names the program's own list of declarations
+  // declares, so a global declared twice is rebound there.
+  std::unordered_set<Symbol> declared;
+  for (const ASTNode *decl : program->blocks_) {
+    std::optional<Symbol> sym;
+    if (decl->GetKind() == ASTKind::VarDecl) {
+      sym = static_cast<const VarDeclAST *>(decl)->ident_token_.GetSymbol();
+    } else if (decl->GetKind() == ASTKind::FnDecl) {
+      sym = static_cast<const FnDeclAST *>(decl)->ident_token_.GetSymbol();
+    }
+    if (sym.has_value() && !declared.insert(*sym).second) {
+      rebound_.insert(*sym);
+    }
+    scan(decl);
+  }
+
+  FnState main = FnState{0, ASTList(), {}, 0, 0, {}, {}};
+  fn_stack_.push_back(&main);
+  for (const ASTNode *decl : program->blocks_) {
+    if (!stmt(decl)) {
+      fn_stack_.clear();
+      return false;
+    }
+  }
+  emit(encode_abc(OpCode::RetNil, 0, 0, 0));
+  out_->SetCode(0, std::move(main.code), std::move(main.offsets));
+  fn_stack_.pop_back();
+
+  out_->num_globals_ = static_cast<uint32_t>(globals_.size());
+  return true;
+}
+
+void Compiler::scan(const ASTNode *node) {
+  if (node == nullptr) {
+    return;
+  }
+
+  switch (node->GetKind()) {
+  case ASTKind::Block:
+    for (const ASTNode *decl : static_cast<const BlockAST *>(node)->decls_) {
+      scan(decl);
+    }
+    break;
+  case ASTKind::VarDecl:
+    scan(static_cast<const VarDeclAST *>(node)->rhs_);
+    break;
+  case ASTKind::FnDecl:
+    scan(static_cast<const FnDeclAST *>(node)->body_);
+    break;
+  case ASTKind::IfStmt: {
+    auto ast = static_cast<const IfStmtAST *>(node);
+    scan(ast->cond_expr);
+    scan(ast->if_stmts);
+    for (const ASTNode *elif : ast->elif_exprs) {
+      scan(elif);
+    }
+    for (const ASTNode *decl : ast->else_stmts) {
+      scan(decl);
+    }
+    break;
+  }
+  case ASTKind::ElifStmt: {
+    auto ast = static_cast<const ElifStmtAST *>(node);
+    scan(ast->cond_expr_);
+    scan(ast->stmts_);
+    break;
+  }
+  case ASTKind::ForStmt: {
+    auto ast = static_cast<const ForStmtAST *>(node);
+    scan(ast->in_expr_list_);
+    scan(ast->stmts_);
+    break;
+  }
+  case ASTKind::ReturnStmt:
+    scan(static_cast<const ReturnStmtAST *>(node)->ret_expr_);
+    break;
+  case ASTKind::ExprStmt:
+    scan(static_cast<const ExprStmtAST *>(node)->expr_);
+    break;
+  case ASTKind::FnCallExpr:
+    for (const ASTNode *arg :
+         static_cast<const FnCallExprAST *>(node)->fn_params_) {
+      scan(arg);
+    }
+    break;
+  case ASTKind::VarAssignExpr: {
+    auto ast = static_cast<const VarAssignAST *>(node);
+    rebound_.insert(ast->ident_tkn_.GetSymbol());
+    scan(ast->rhs_);
+    break;
+  }
+  case ASTKind::BinaryExpr: {
+    auto ast = static_cast<const BinaryExprAST *>(node);
+    scan(ast->lhs_);
+    scan(ast->rhs_);
+    break;
+  }
+  case ASTKind::UnaryExpr:
+    scan(static_cast<const UnaryExprAST *>(node)->rhs_);
+    break;
+  default:
+    // Tables and arrays are rejected when they are compiled.
+    break;
+  }
+}
+
+bool Compiler::stmt(const ASTNode *node) {
+  // Temporaries only live for the statement that needs them, so every
+  // statement starts allocating from just above the live locals.
+  uint32_t base = fn().free_reg;
+  size_t num_locals = fn().locals.size();
+  bool ok = true;
+
+  switch (node->GetKind()) {
+  case ASTKind::Block:
+    begin_scope();
+    ok = block(static_cast<const BlockAST *>(node)->decls_);
+    end_scope();
+    break;
+  case ASTKind::VarDecl:
+    ok = var_decl(static_cast<const VarDeclAST *>(node));
+    break;
+  case ASTKind::FnDecl:
+    ok = fn_decl(static_cast<const FnDeclAST *>(node));
+    break;
+  case ASTKind::IfStmt:
+    ok = if_stmt(static_cast<const IfStmtAST *>(node));
+    break;
+  case ASTKind::ForStmt:
+    ok = for_stmt(static_cast<const ForStmtAST *>(node));
+    break;
+  case ASTKind::ReturnStmt:
+    ok = ret_stmt(static_cast<const ReturnStmtAST *>(node));
+    break;
+  case ASTKind::ExprStmt: {
+    const ASTNode *expr_node = static_cast<const ExprStmtAST *>(node)->expr_;
+    if (expr_node->GetKind() == ASTKind::VarAssignExpr) {
+      // The value of an assignment statement is never used, so do not copy
+      // it anywhere.
+      ok = assign(static_cast<const VarAssignAST *>(expr_node), std::nullopt);
+    } else {
+      uint8_t reg;
+      ok = expr_any(expr_node, reg);
+    }
+    break;
+  }
+  default: {
+    uint8_t reg;
+    ok = expr_any(node, reg);
+    break;
+  }
+  }
+
+  if (fn().locals.size() > num_locals) {
+    fn().free_reg = fn().locals.back().reg + 1u;
+  } else {
+    fn().free_reg = base;
+  }
+  return ok;
+}
+
+bool Compiler::block(ASTList stmts) {
+  for (const ASTNode *node : stmts) {
+    if (!stmt(node)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool Compiler::var_decl(const VarDeclAST *ast) {
+  curr_offset_ = ast->ident_token_.GetOffset();
+  Symbol sym = ast->ident_token_.GetSymbol();
+
+  if (at_global_scope()) {
+    uint8_t reg;
+    if (ast->rhs_ == nullptr) {
+      if (!alloc_reg(reg)) {
+        return false;
+      }
+      emit(encode_abc(OpCode::LoadNil, reg, 0, 0));
+    } else if (!expr_any(ast->rhs_, reg)) {
+      return false;
+    }
+
+    // The slot is only bound after the rhs, which may refer to an earlier
+    // declaration of the same name.
+    uint16_t slot;
+    if (!global_slot(sym, slot)) {
+      return false;
+    }
+    curr_offset_ = ast->ident_token_.GetOffset();
+    emit(encode_abx(OpCode::SetGlobal, reg, slot));
+    return true;
+  }
+
+  // Declaring a name again in the same scope assigns to the variable
+  // already there, which a closure may have captured.
+  Local *prev = find_local(sym);
+  if (prev != nullptr && prev->depth != fn().depth) {
+    prev = nullptr;
+  }
+
+  uint8_t reg;
+  if (prev != nullptr) {
+    reg = prev->reg;
+    prev->proto = NO_PROTO;
+  } else if (!alloc_reg(reg)) {
+    return false;
+  }
+  if (ast->rhs_ == nullptr) {
+    emit(encode_abc(OpCode::LoadNil, reg, 0, 0));
+  } else if (!expr(ast->rhs_, reg)) {
+    return false;
+  }
+  if (prev == nullptr) {
+    fn().locals.push_back(Local{sym, reg, NO_PROTO, fn().depth, false});
+  }
+  return true;
+}
+
+bool Compiler::fn_decl(const FnDeclAST *ast) {
+  curr_offset_ = ast->ident_token_.GetOffset();
+  Symbol sym = ast->ident_token_.GetSymbol();
+  ASTList params = static_cast<const ParamListAST *>(ast->params_)->params_;
+  ASTList captures =
+      static_cast<const ParamListAST *>(ast->captures_)->params_;
+
+  if (out_->protos_.size() > UINT16_MAX) {
+    return fail(CompileErrorKind::TooManyFunctions);
+  }
+  if (captures.size() > UINT16_MAX) {
+    return fail(CompileErrorKind::TooManyUpvalues);
+  }
+  uint32_t idx = static_cast<uint32_t>(out_->protos_.size());
+  out_->protos_.push_back(FnProto{{},
+                                  {},
+                                  static_cast<uint32_t>(params.size()),
+                                  0,
+                                  static_cast<uint32_t>(captures.size())});
+
+  // Calls can only be bound to the function if the name is never bound to
+  // anything else, and the function needs no closure.
+  bool is_global = at_global_scope();
+  uint32_t call_proto =
+      rebound_.count(sym) == 0 && captures.empty() ? idx : NO_PROTO;
+
+  // Bind the name before compiling the body, so a global function can call
+  // itself directly and a local one can capture itself.
+  uint16_t slot = 0;
+  uint8_t reg = 0;
+  if (is_global) {
+    if (!global_slot(sym, slot)) {
+      return false;
+    }
+    globals_[sym].proto = call_proto;
+  } else if (!declare_local(sym, call_proto, reg)) {
+    return false;
+  }
+
+  FnState state = FnState{idx, captures, {}, 0, 0, {}, {}};
+  fn_stack_.push_back(&state);
+  for (const ASTNode *param : params) {
+    uint8_t param_reg;
+    if (!alloc_reg(param_reg)) {
+      return false;
+    }
+    Symbol param_sym = static_cast<const LiteralExprAST *>(param)
+                           ->lit_tkn_.GetSymbol();
+    state.locals.push_back(Local{param_sym, param_reg, NO_PROTO, 0, false});
+  }
+  if (!stmt(ast->body_)) {
+    return false;
+  }
+  emit(encode_abc(OpCode::RetNil, 0, 0, 0));
+  out_->SetCode(idx, std::move(state.code), std::move(state.offsets));
+  fn_stack_.pop_back();
+
+  // The function is still a first class value, for calls through other
+  // variables.
+  curr_offset_ = ast->ident_token_.GetOffset();
+  if (is_global) {
+    if (!alloc_reg(reg) || !load_fn(ast, idx, reg)) {
+      return false;
+    }
+    emit(encode_abx(OpCode::SetGlobal, reg, slot));
+    return true;
+  }
+  return load_fn(ast, idx, reg);
+}
+
+// Loads the value of the function compiled to proto idx: a constant if it
+// captures nothing, and otherwise a new closure over what it captures.
+bool Compiler::load_fn(const FnDeclAST *ast, uint32_t idx, uint8_t dst) {
+  ASTList captures =
+      static_cast<const ParamListAST *>(ast->captures_)->params_;
+  if (captures.empty()) {
+    uint16_t k;
+    if (!add_constant(Value::FromProto(idx), k)) {
+      return false;
+    }
+    emit(encode_abx(OpCode::LoadK, dst, k));
+    return true;
+  }
+
+  emit(encode_abx(OpCode::Closure, dst, static_cast<uint16_t>(idx)));
+  for (const ASTNode *node : captures) {
+    Token tkn = static_cast<const LiteralExprAST *>(node)->lit_tkn_;
+    Resolved res;
+    if (!resolve(tkn, res)) {
+      return false;
+    }
+
+    curr_offset_ = ast->ident_token_.GetOffset();
+    if (res.storage == Storage::Local) {
+      find_local(tkn.GetSymbol())->captured = true;
+      emit(encode_abc(OpCode::Move, 0, static_cast<uint8_t>(res.index), 0));
+    } else if (res.storage == Storage::Upvalue) {
+      emit(encode_abx(OpCode::GetUpval, 0, static_cast<uint16_t>(res.index)));
+    } else {
+      // The parser never lists a global as captured.
+      return fail(CompileErrorKind::UndefinedSymbol);
+    }
+  }
+  return true;
+}
+
+bool Compiler::if_stmt(const IfStmtAST *ast) {
+  std::vector<size_t> exits;
+
+  // Conditions are dead once tested, so the branches can reuse their
+  // registers.
+  uint32_t saved = fn().free_reg;
+  uint8_t cond;
+  if (!expr_any(ast->cond_expr, cond)) {
+    return false;
+  }
+  size_t next = emit_jump(OpCode::JmpFalse, cond);
+  fn().free_reg = saved;
+  if (!stmt(ast->if_stmts)) {
+    return false;
+  }
+
+  for (const ASTNode *node : ast->elif_exprs) {
+    auto elif = static_cast<const ElifStmtAST *>(node);
+    exits.push_back(emit_jump(OpCode::Jmp, 0));
+    if (!patch_jump(next)) {
+      return false;
+    }
+    if (!expr_any(elif->cond_expr_, cond)) {
+      return false;
+    }
+    next = emit_jump(OpCode::JmpFalse, cond);
+    fn().free_reg = saved;
+    if (!stmt(elif->stmts_)) {
+      return false;
+    }
+  }
+
+  if (!ast->else_stmts.empty()) {
+    exits.push_back(emit_jump(OpCode::Jmp, 0));
+    if (!patch_jump(next) || !block(ast->else_stmts)) {
+      return false;
+    }
+  } else if (!patch_jump(next)) {
+    return false;
+  }
+
+  for (size_t exit : exits) {
+    if (!patch_jump(exit)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool Compiler::for_stmt(const ForStmtAST *ast) {
+  ASTList vars = static_cast<const ParamListAST *>(ast->var_list_)->params_;
+  ASTList body = static_cast<const BlockAST *>(ast->stmts_)->decls_;
+
+  // R[A] holds the iterable, R[A + 1] the position in it, and the loop
+  // variables are R[A + 2] (the element) and R[A + 3] (the index).
+  uint8_t iter, reg;
+  if (!alloc_reg(iter)) {
+    return false;
+  }
+  for (int i = 0; i < 3; i++) {
+    if (!alloc_reg(reg)) {
+      return false;
+    }
+  }
+  if (!expr(ast->in_expr_list_, iter)) {
+    return false;
+  }
+  fn().free_reg = iter + 4u;
+
+  auto val_ast = static_cast<const LiteralExprAST *>(vars.back());
+  curr_offset_ = val_ast->lit_tkn_.GetOffset();
+  size_t prep = emit_jump(OpCode::ForPrep, iter);
+  size_t body_start = fn().code.size();
+
+  // As in the tree walker, the body's declarations share the scope of the
+  // loop variables. The scope ends on every pass, so a closure made in the
+  // body captures that pass's variables.
+  begin_scope();
+  for (size_t i = 0; i < vars.size(); i++) {
+    auto var_ast = static_cast<const LiteralExprAST *>(vars[i]);
+    Symbol sym = var_ast->lit_tkn_.GetSymbol();
+    uint8_t var_reg = static_cast<uint8_t>(iter + 2 + (vars.size() - 1 - i));
+    fn().locals.push_back(Local{sym, var_reg, NO_PROTO, fn().depth, false});
+  }
+  bool ok = block(body);
+  end_scope();
+  if (!ok || !patch_jump(prep)) {
+    return false;
+  }
+
+  curr_offset_ = val_ast->lit_tkn_.GetOffset();
+  return emit_loop(OpCode::ForLoop, iter, body_start);
+}
+
+bool Compiler::ret_stmt(const ReturnStmtAST *ast) {
+  if (ast->ret_expr_ == nullptr) {
+    emit(encode_abc(OpCode::RetNil, 0, 0, 0));
+    return true;
+  }
+
+  uint8_t reg;
+  if (!expr_any(ast->ret_expr_, reg)) {
+    return false;
+  }
+  emit(encode_abc(OpCode::Ret, reg, 0, 0));
+  return true;
+}
+
+bool Compiler::expr(const ASTNode *node, uint8_t dst) {
+  switch (node->GetKind()) {
+  case ASTKind::LiteralExpr:
+    return literal(static_cast<const LiteralExprAST *>(node), dst);
+  case ASTKind::BinaryExpr:
+    return binary(static_cast<const BinaryExprAST *>(node), dst);
+  case ASTKind::UnaryExpr:
+    return unary(static_cast<const UnaryExprAST *>(node), dst);
+  case ASTKind::VarAssignExpr:
+    return assign(static_cast<const VarAssignAST *>(node), dst);
+  case ASTKind::FnCallExpr:
+    return call(static_cast<const FnCallExprAST *>(node), dst);
+  default:
+    // Tables and arrays have no instructions yet.
+    return fail(CompileErrorKind::UnsupportedExpr);
+  }
+}
+
+bool Compiler::expr_any(const ASTNode *node, uint8_t &reg) {
+  // A local can be used in place rather than copied to a temporary.
+  if (node->GetKind() == ASTKind::LiteralExpr) {
+    Token tkn = static_cast<const LiteralExprAST *>(node)->lit_tkn_;
+    Resolved res;
+    if (tkn.GetKind() == TokenKind::Identifier) {
+      curr_offset_ = tkn.GetOffset();
+      if (!resolve(tkn, res)) {
+        return false;
+      }
+      if (res.storage == Storage::Local) {
+        reg = static_cast<uint8_t>(res.index);
+        return true;
+      }
+    }
+  }
+
+  if (!alloc_reg(reg)) {
+    return false;
+  }
+  return expr(node, reg);
+}
+
+bool Compiler::literal(const LiteralExprAST *ast, uint8_t dst) {
+  Token tkn = ast->lit_tkn_;
+  curr_offset_ = tkn.GetOffset();
+  uint16_t k;
+
+  switch (tkn.GetKind()) {
+  case TokenKind::NumberLiteral:
+    if (!number_constant(ast->GetNumber(), k)) {
+      return false;
+    }
+    emit(encode_abx(OpCode::LoadK, dst, k));
+    return true;
+  case TokenKind::StringLiteral:
+    if (!string_constant(tkn.GetSymbol(), k)) {
+      return false;
+    }
+    emit(encode_abx(OpCode::LoadK, dst, k));
+    return true;
+  case TokenKind::True:
+    emit(encode_abc(OpCode::LoadBool, dst, 1, 0));
+    return true;
+  case TokenKind::False:
+    emit(encode_abc(OpCode::LoadBool, dst, 0, 0));
+    return true;
+  case TokenKind::Identifier:
+    return load_symbol(tkn, dst);
+  default:
+    emit(encode_abc(OpCode::LoadNil, dst, 0, 0));
+    return true;
+  }
+}
+
+bool Compiler::load_symbol(Token tkn, uint8_t dst) {
+  curr_offset_ = tkn.GetOffset();
+  Resolved res;
+  if (!resolve(tkn, res)) {
+    return false;
+  }
+
+  switch (res.storage) {
+  case Storage::Local:
+    if (res.index != dst) {
+      emit(encode_abc(OpCode::Move, dst, res.index, 0));
+    }
+    break;
+  case Storage::Upvalue:
+    emit(encode_abx(OpCode::GetUpval, dst, res.index));
+    break;
+  case Storage::Global:
+    emit(encode_abx(OpCode::GetGlobal, dst, res.index));
+    break;
+  }
+  return true;
+}
+
+bool Compiler::binary(const BinaryExprAST *ast, uint8_t dst) {
+  TokenKind op_kind = ast->op_tkn_.GetKind();
+  if (op_kind == TokenKind::DoubleAmpersand ||
+      op_kind == TokenKind::DoublePipe) {
+    return logical(ast, dst);
+  }
+
+  OpCode op;
+  switch (op_kind) {
+  case TokenKind::Plus:
+    op = OpCode::Add;
+    break;
+  case TokenKind::Minus:
+    op = OpCode::Sub;
+    break;
+  case TokenKind::Star:
+    op = OpCode::Mul;
+    break;
+  case TokenKind::Slash:
+    op = OpCode::Div;
+    break;
+  case TokenKind::Percent:
+    op = OpCode::Mod;
+    break;
+  case TokenKind::EqualEqual:
+    op = OpCode::Eq;
+    break;
+  case TokenKind::BangEqual:
+    op = OpCode::Ne;
+    break;
+  case TokenKind::LessThan:
+    op = OpCode::Lt;
+    break;
+  case TokenKind::LessThanEqual:
+    op = OpCode::Le;
+    break;
+  case TokenKind::GreaterThan:
+    op = OpCode::Gt;
+    break;
+  case TokenKind::GreaterThanEqual:
+    op = OpCode::Ge;
+    break;
+  default:
+    curr_offset_ = ast->op_tkn_.GetOffset();
+    return fail(CompileErrorKind::UnsupportedExpr);
+  }
+
+  uint32_t saved = fn().free_reg;
+  uint8_t lhs, rhs;
+  if (!expr_any(ast->lhs_, lhs) || !expr_any(ast->rhs_, rhs)) {
+    return false;
+  }
+  curr_offset_ = ast->op_tkn_.GetOffset();
+  emit(encode_abc(op, dst, lhs, rhs));
+  fn().free_reg = saved;
+  return true;
+}
+
+bool Compiler::logical(const BinaryExprAST *ast, uint8_t dst) {
+  // Work in a temporary, since dst may be a local the rhs still reads.
+  uint32_t saved = fn().free_reg;
+  uint8_t tmp;
+  if (!alloc_reg(tmp) || !expr(ast->lhs_, tmp)) {
+    return false;
+  }
+
+  OpCode op = ast->op_tkn_.GetKind() == TokenKind::DoubleAmpersand
+                  ? OpCode::JmpFalse
+                  : OpCode::JmpTrue;
+  size_t skip = emit_jump(op, tmp);
+  if (!expr(ast->rhs_, tmp) || !patch_jump(skip)) {
+    return false;
+  }
+
+  // The result is always a bool, whichever side produced it.
+  emit(encode_abc(OpCode::Not, dst, tmp, 0));
+  emit(encode_abc(OpCode::Not, dst, dst, 0));
+  fn().free_reg = saved;
+  return true;
+}
+
+bool Compiler::unary(const UnaryExprAST *ast, uint8_t dst) {
+  uint32_t saved = fn().free_reg;
+  uint8_t rhs;
+  if (!expr_any(ast->rhs_, rhs)) {
+    return false;
+  }
+
+  OpCode op =
+      ast->op_tkn_.GetKind() == TokenKind::Bang ? OpCode::Not : OpCode::Neg;
+  curr_offset_ = ast->op_tkn_.GetOffset();
+  emit(encode_abc(op, dst, rhs, 0));
+  fn().free_reg = saved;
+  return true;
+}
+
+bool Compiler::assign(const VarAssignAST *ast, std::optional<uint8_t> dst) {
+  curr_offset_ = ast->ident_tkn_.GetOffset();
+  Resolved res;
+  if (!resolve(ast->ident_tkn_, res)) {
+    return false;
+  }
+
+  uint32_t saved = fn().free_reg;
+  uint8_t reg;
+  if (res.storage == Storage::Local) {
+    reg = static_cast<uint8_t>(res.index);
+    if (!expr(ast->rhs_, reg)) {
+      return false;
+    }
+  } else {
+    if (!expr_any(ast->rhs_, reg)) {
+      return false;
+    }
+    curr_offset_ = ast->ident_tkn_.GetOffset();
+    OpCode op = res.storage == Storage::Global ? OpCode::SetGlobal
+                                               : OpCode::SetUpval;
+    emit(encode_abx(op, reg, static_cast<uint16_t>(res.index)));
+  }
+
+  if (dst.has_value() && dst.value() != reg) {
+    emit(encode_abc(OpCode::Move, dst.value(), reg, 0));
+  }
+  fn().free_reg = saved;
+  return true;
+}
+
+bool Compiler::call(const FnCallExprAST *ast, uint8_t dst) {
+  Token tkn = ast->fn_ident_tkn_;
+  curr_offset_ = tkn.GetOffset();
+  uint32_t saved = fn().free_reg;
+  uint32_t count = static_cast<uint32_t>(ast->fn_params_.size());
+
+  Resolved res = Resolved{Storage::Local, 0, NO_PROTO};
+  if (!ast->is_std_ && !resolve(tkn, res)) {
+    return false;
+  }
+  // A call with the wrong number of arguments fails only if it runs, as it
+  // does in the interpreter.
+  if (res.proto != NO_PROTO && out_->protos_[res.proto].arity != count) {
+    res.proto = NO_PROTO;
+  }
+
+  // Arguments go in consecutive registers after the base. If dst is the
+  // newest temporary it doubles as the base.
+  uint8_t base = dst;
+  if (dst + 1u != fn().free_reg || !is_temp(dst)) {
+    if (!alloc_reg(base)) {
+      return false;
+    }
+  }
+  if (ast->is_std_) {
+    // Builtins take their arguments from the base register on.
+    fn().free_reg = base;
+  } else if (res.proto == NO_PROTO && !load_symbol(tkn, base)) {
+    return false;
+  }
+
+  for (const ASTNode *arg : ast->fn_params_) {
+    uint8_t reg;
+    if (!alloc_reg(reg) || !expr(arg, reg)) {
+      return false;
+    }
+    fn().free_reg = reg + 1u;
+  }
+
+  curr_offset_ = tkn.GetOffset();
+  Symbol sym = tkn.GetSymbol();
+  if (ast->is_std_ && sym == print_sym_) {
+    emit(encode_abc(OpCode::Print, base, count, 0));
+    emit(encode_abc(OpCode::LoadNil, dst, 0, 0));
+  } else if (ast->is_std_ && sym == range_sym_) {
+    // range(end) or range(start, end)
+    if (count != 1 && count != 2) {
+      return fail(CompileErrorKind::WrongArgCount);
+    }
+    if (count == 1) {
+      uint16_t k;
+      uint8_t end;
+      if (!alloc_reg(end) || !number_constant(0, k)) {
+        return false;
+      }
+      emit(encode_abc(OpCode::Move, end, base, 0));
+      emit(encode_abx(OpCode::LoadK, base, k));
+    }
+    emit(encode_abc(OpCode::Range, dst, base, base + 1));
+  } else if (ast->is_std_) {
+    emit(encode_abc(OpCode::LoadNil, dst, 0, 0));
+  } else if (res.proto != NO_PROTO) {
+    emit(encode_abx(OpCode::Call, base, static_cast<uint16_t>(res.proto)));
+    if (dst != base) {
+      emit(encode_abc(OpCode::Move, dst, base, 0));
+    }
+  } else {
+    emit(encode_abc(OpCode::CallValue, base, count, 0));
+    if (dst != base) {
+      emit(encode_abc(OpCode::Move, dst, base, 0));
+    }
+  }
+
+  fn().free_reg = saved;
+  return true;
+}
+
+bool Compiler::resolve(Token tkn, Resolved &out) {
+  Symbol sym = tkn.GetSymbol();
+  if (const Local *local = find_local(sym)) {
+    out = Resolved{Storage::Local, local->reg, local->proto};
+    return true;
+  }
+
+  // The parser has already resolved every name lexically, so a name that
+  // is not a local is either one the function captures or a global.
+  ASTList captures = fn().captures;
+  for (size_t i = 0; i < captures.size(); i++) {
+    auto capture_ast = static_cast<const LiteralExprAST *>(captures[i]);
+    if (capture_ast->lit_tkn_.GetSymbol() == sym) {
+      out = Resolved{Storage::Upvalue, static_cast<uint32_t>(i), NO_PROTO};
+      return true;
+    }
+  }
+
+  auto it = globals_.find(sym);
+  if (it == globals_.end()) {
+    curr_offset_ = tkn.GetOffset();
+    return fail(CompileErrorKind::UndefinedSymbol);
+  }
+  out = Resolved{Storage::Global, it->second.slot, it->second.proto};
+  return true;
+}
+
+bool Compiler::global_slot(Symbol sym, uint16_t &slot) {
+  auto it = globals_.find(sym);
+  if (it != globals_.end()) {
+    // Redeclaring a global reuses its slot.
+    slot = it->second.slot;
+    return true;
+  }
+
+  if (globals_.size() > UINT16_MAX) {
+    return fail(CompileErrorKind::TooManyGlobals);
+  }
+  slot = static_cast<uint16_t>(globals_.size());
+  globals_[sym] = Global{slot, NO_PROTO};
+  return true;
+}
+
+// Declaring a name again in the same scope reuses the variable already
+// there, which a closure may have captured.
+bool Compiler::declare_local(Symbol sym, uint32_t proto, uint8_t &reg) {
+  Local *prev = find_local(sym);
+  if (prev != nullptr && prev->depth == fn().depth) {
+    reg = prev->reg;
+    prev->proto = proto;
+    return true;
+  }
+
+  if (!alloc_reg(reg)) {
+    return false;
+  }
+  fn().locals.push_back(Local{sym, reg, proto, fn().depth, false});
+  return true;
+}
+
+Compiler::Local *Compiler::find_local(Symbol sym) {
+  std::vector<Local> &locals = fn().locals;
+  for (size_t i = locals.size(); i-- > 0;) {
+    if (locals[i].sym == sym) {
+      return &locals[i];
+    }
+  }
+  return nullptr;
+}
+
+bool Compiler::alloc_reg(uint8_t &reg) {
+  FnState &state = fn();
+  if (state.free_reg >= MAX_REGS) {
+    return fail(CompileErrorKind::TooManyRegisters);
+  }
+  reg = static_cast<uint8_t>(state.free_reg++);
+  proto().num_regs = std::max(proto().num_regs, state.free_reg);
+  return true;
+}
+
+bool Compiler::is_temp(uint8_t reg) {
+  const std::vector<Local> &locals = fn().locals;
+  return locals.empty() || reg > locals.back().reg;
+}
+
+void Compiler::begin_scope() { fn().depth++; }
+
+void Compiler::end_scope() {
+  FnState &state = fn();
+  state.depth--;
+
+  // The registers of the scope's locals are about to be reused, so move any
+  // captured ones out to their upvalues first.
+  int close_from = -1;
+  while (!state.locals.empty() && state.locals.back().depth > state.depth) {
+    if (state.locals.back().captured) {
+      close_from = state.locals.back().reg;
+    }
+    state.locals.pop_back();
+  }
+  if (close_from >= 0) {
+    emit(encode_abc(OpCode::Close, static_cast<uint8_t>(close_from), 0, 0));
+  }
+}
+
+bool Compiler::add_constant(Value val, uint16_t &idx) {
+  if (out_->constants_.size() > UINT16_MAX) {
+    return fail(CompileErrorKind::TooManyConstants);
+  }
+  idx = static_cast<uint16_t>(out_->constants_.size());
+  out_->constants_.push_back(val);
+  return true;
+}
+
+// Numbers are deduplicated by bit pattern, as -0 equals 0 but is not the
+// same constant.
+bool Compiler::number_constant(double num, uint16_t &idx) {
+  uint64_t bits = std::bit_cast<uint64_t>(num);
+  auto it = number_consts_.find(bits);
+  if (it != number_consts_.end()) {
+    idx = it->second;
+    return true;
+  }
+  if (!add_constant(Value::FromNumber(num), idx)) {
+    return false;
+  }
+  number_consts_[bits] = idx;
+  return true;
+}
+
+bool Compiler::string_constant(Symbol sym, uint16_t &idx) {
+  auto it = string_consts_.find(sym);
+  if (it != string_consts_.end()) {
+    idx = it->second;
+    return true;
+  }
+  // Long strings point into the interner, which outlives the program.
+  if (!add_constant(Value::FromString(interner_.Lookup(sym)), idx)) {
+    return false;
+  }
+  string_consts_[sym] = idx;
+  return true;
+}
+
+void Compiler::emit(Instr ins) {
+  FnState &state = fn();
+  state.code.push_back(ins);
+  state.offsets.push_back(curr_offset_);
+}
+
+size_t Compiler::emit_jump(OpCode op, uint8_t a) {
+  emit(encode_asbx(op, a, 0));
+  return fn().code.size() - 1;
+}
+
+bool Compiler::patch_jump(size_t at) {
+  std::vector<Instr> &code = fn().code;
+  size_t dist = code.size() - (at + 1);
+  if (dist > static_cast<size_t>(SBX_MAX)) {
+    return fail(CompileErrorKind::JumpTooFar);
+  }
+  code[at] = encode_asbx(op_of(code[at]), arg_a(code[at]),
+                         static_cast<int32_t>(dist));
+  return true;
+}
+
+bool Compiler::emit_loop(OpCode op, uint8_t a, size_t target) {
+  size_t dist = fn().code.size() + 1 - target;
+  if (dist > static_cast<size_t>(-SBX_MIN)) {
+    return fail(CompileErrorKind::JumpTooFar);
+  }
+  emit(encode_asbx(op, a, -static_cast<int32_t>(dist)));
+  return true;
+}
+
+bool Compiler::fail(CompileErrorKind kind) {
+  if (!error_.has_value()) {
+    auto loc = source_.Locate(curr_offset_);
+    error_ = CompileError(kind, loc.line, loc.col);
+  }
+  return false;
+}
@@ -0,0 +1,413 @@
+#include "sif/VM/vm.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace sif;
+
+// GCC and Clang can jump straight to the next instruction's handler
+// through a table of label addresses, which predicts far better than the
+// single indirect branch a switch compiles to. Define SIF_NO_COMPUTED_GOTO
+// to build the portable switch instead.
+#if defined(__GNUC__) && !defined(SIF_NO_COMPUTED_GOTO)
+#define SIF_COMPUTED_GOTO
+#endif
+
+#ifdef SIF_COMPUTED_GOTO
+#define VM_SWITCH(op) goto *DISPATCH[static_cast<uint8_t>(op)];
+#define VM_CASE(name) label_##name:
+#define VM_NEXT()                                                              \
+  ins = *pc++;                                                                 \
+  goto *DISPATCH[static_cast<uint8_t>(op_of(ins))]
+#else
+#define VM_SWITCH(op) switch (op)
+#define VM_CASE(name) case OpCode::name:
+#define VM_NEXT() continue
+#endif
+
+#define VM_FAIL(kind) return fail(RuntimeErrorKind::kind, proto, pc)
+
+// Arithmetic on numbers only.
+#define VM_ARITH(name, expr)                                                   \
+  VM_CASE(name) {                                                              \
+    const Value &lhs = R[arg_b(ins)];                                          \
+    const Value &rhs = R[arg_c(ins)];                                          \
+    if (lhs.Kind() != ValueKind::Number || rhs.Kind() != ValueKind::Number) {  \
+      VM_FAIL(TypeMismatch);                                                   \
+    }                                                                          \
+    double l = lhs.GetNumber();                                                \
+    double r = rhs.GetNumber();                                                \
+    R[arg_a(ins)] = Value::FromNumber(expr);                                   \
+    VM_NEXT();                                                                 \
+  }
+
+// Orderings apply to two numbers or two strings.
+#define VM_COMPARE(name, cmp)                                                  \
+  VM_CASE(name) {                                                              \
+    const Value &lhs = R[arg_b(ins)];                                          \
+    const Value &rhs = R[arg_c(ins)];                                          \
+    if (lhs.Kind() == ValueKind::Number && rhs.Kind() == ValueKind::Number) {  \
+      R[arg_a(ins)] = Value::FromBool(lhs.GetNumber() cmp rhs.GetNumber());    \
+    } else if (lhs.Kind() == ValueKind::String &&                              \
+               rhs.Kind() == ValueKind::String) {                              \
+      R[arg_a(ins)] = Value::FromBool(lhs.GetString() cmp rhs.GetString());    \
+    } else {                                                                   \
+      VM_FAIL(TypeMismatch);                                                   \
+    }                                                                          \
+    VM_NEXT();                                                                 \
+  }
+
+namespace {
+const size_t INITIAL_REGS = 1024;
+
+// Same result as fmod, but whole numbers, by far the common case, take the
+// much cheaper integer remainder.
+double num_mod(double l, double r) {
+  const double limit = 9007199254740992.0;
+  if (std::trunc(l) == l && std::trunc(r) == r && std::fabs(l) < limit &&
+      std::fabs(r) < limit && r != 0) {
+    int64_t rem = static_cast<int64_t>(l) % static_cast<int64_t>(r);
+    // fmod keeps the sign of l even when the result is zero.
+    return rem == 0 && std::signbit(l) ? -0.0 : static_cast<double>(rem);
+  }
+  return std::fmod(l, r);
+}
+} // namespace
+
+VM::VM(const BytecodeProgram &program, const SourceBuffer &source,
+       std::ostream &out)
+    : program_(program), source_(source), out_(out) {
+  error_ = std::nullopt;
+}
+
+bool VM::Run() {
+#ifdef SIF_COMPUTED_GOTO
+#define SIF_OPCODE_LABEL(name) &&label_##name,
+  static const void *const DISPATCH[] = {SIF_OPCODES(SIF_OPCODE_LABEL)};
+#undef SIF_OPCODE_LABEL
+#endif
+
+  const FnProto *proto = &program_.protos_[0];
+  const Value *K = program_.constants_.data();
+  globals_.assign(program_.num_globals_, Value());
+  regs_.assign(std::max(INITIAL_REGS, size_t(proto->num_regs)), Value());
+  frames_.clear();
+  open_upvals_.clear();
+
+  const Instr *pc = proto->code.data();
+  const Closure *cl = nullptr;
+  size_t base = 0;
+  Value *R = regs_.data();
+  Instr ins;
+
+  for (;;) {
+    ins = *pc++;
+    VM_SWITCH(op_of(ins)) {
+      VM_CASE(LoadK) {
+        R[arg_a(ins)] = K[arg_bx(ins)];
+        VM_NEXT();
+      }
+      VM_CASE(LoadNil) {
+        R[arg_a(ins)] = Value();
+        VM_NEXT();
+      }
+      VM_CASE(LoadBool) {
+        R[arg_a(ins)] = Value::FromBool(arg_b(ins) != 0);
+        VM_NEXT();
+      }
+      VM_CASE(Move) {
+        R[arg_a(ins)] = R[arg_b(ins)];
+        VM_NEXT();
+      }
+      VM_CASE(GetGlobal) {
+        R[arg_a(ins)] = globals_[arg_bx(ins)];
+        VM_NEXT();
+      }
+      VM_CASE(SetGlobal) {
+        globals_[arg_bx(ins)] = R[arg_a(ins)];
+        VM_NEXT();
+      }
+      VM_CASE(GetUpval) {
+        R[arg_a(ins)] = *cl->upvals[arg_bx(ins)]->loc;
+        VM_NEXT();
+      }
+      VM_CASE(SetUpval) {
+        *cl->upvals[arg_bx(ins)]->loc = R[arg_a(ins)];
+        VM_NEXT();
+      }
+      VM_CASE(Closure) {
+        const FnProto *fn = &program_.protos_[arg_bx(ins)];
+        Closure *closure =
+            closures_.NewClosure(nullptr, arg_bx(ins), fn->num_upvals);
+        for (Upvalue *&upval : closure->upvals) {
+          Instr capture = *pc++;
+          if (op_of(capture) == OpCode::Move) {
+            upval = open_upvalue(base + arg_b(capture));
+          } else {
+            upval = cl->upvals[arg_bx(capture)];
+          }
+        }
+        R[arg_a(ins)] = Value::FromClosure(closure);
+        VM_NEXT();
+      }
+      VM_CASE(Close) {
+        close_upvalues(base + arg_a(ins));
+        VM_NEXT();
+      }
+      VM_CASE(Add) {
+        const Value &lhs = R[arg_b(ins)];
+        const Value &rhs = R[arg_c(ins)];
+        if (lhs.Kind() == ValueKind::Number &&
+            rhs.Kind() == ValueKind::Number) {
+          double sum = lhs.GetNumber() + rhs.GetNumber();
+          R[arg_a(ins)] = Value::FromNumber(sum);
+        } else if (lhs.Kind() == ValueKind::String &&
+                   rhs.Kind() == ValueKind::String) {
+          R[arg_a(ins)] = strings_.Concat(lhs.GetString(), rhs.GetString());
+        } else {
+          VM_FAIL(TypeMismatch);
+        }
+        VM_NEXT();
+      }
+      VM_ARITH(Sub, l - r)
+      VM_ARITH(Mul, l * r)
+      VM_ARITH(Div, l / r)
+      VM_ARITH(Mod, num_mod(l, r))
+      VM_CASE(Eq) {
+        bool eq = R[arg_b(ins)].Equals(R[arg_c(ins)]);
+        R[arg_a(ins)] = Value::FromBool(eq);
+        VM_NEXT();
+      }
+      VM_CASE(Ne) {
+        bool eq = R[arg_b(ins)].Equals(R[arg_c(ins)]);
+        R[arg_a(ins)] = Value::FromBool(!eq);
+        VM_NEXT();
+      }
+      VM_COMPARE(Lt, <)
+      VM_COMPARE(Le, <=)
+      VM_COMPARE(Gt, >)
+      VM_COMPARE(Ge, >=)
+      VM_CASE(Neg) {
+        const Value &rhs = R[arg_b(ins)];
+        if (rhs.Kind() != ValueKind::Number) {
+          VM_FAIL(TypeMismatch);
+        }
+        R[arg_a(ins)] = Value::FromNumber(-rhs.GetNumber());
+        VM_NEXT();
+      }
+      VM_CASE(Not) {
+        R[arg_a(ins)] = Value::FromBool(!R[arg_b(ins)].IsTruthy());
+        VM_NEXT();
+      }
+      VM_CASE(Jmp) {
+        pc += arg_sbx(ins);
+        VM_NEXT();
+      }
+      VM_CASE(JmpFalse) {
+        if (!R[arg_a(ins)].IsTruthy()) {
+          pc += arg_sbx(ins);
+        }
+        VM_NEXT();
+      }
+      VM_CASE(JmpTrue) {
+        if (R[arg_a(ins)].IsTruthy()) {
+          pc += arg_sbx(ins);
+        }
+        VM_NEXT();
+      }
+      VM_CASE(Call) {
+        const FnProto *callee = &program_.protos_[arg_bx(ins)];
+        if (frames_.size() == MAX_CALL_DEPTH) {
+          VM_FAIL(StackOverflow);
+        }
+        if (!deadline_.Check()) {
+          VM_FAIL(TimedOut);
+        }
+        frames_.push_back(Frame{proto, pc, base, cl});
+        base += arg_a(ins) + 1u;
+        if (base + callee->num_regs > regs_.size()) {
+          grow_regs(base + callee->num_regs);
+        }
+        R = regs_.data() + base;
+        proto = callee;
+        pc = callee->code.data();
+        cl = nullptr;
+        VM_NEXT();
+      }
+      VM_CASE(CallValue) {
+        const Value &callee_val = R[arg_a(ins)];
+        const Closure *callee_cl = nullptr;
+        uint32_t callee_proto;
+        if (callee_val.Kind() == ValueKind::CompiledFn) {
+          callee_proto = callee_val.GetProto();
+        } else if (callee_val.Kind() == ValueKind::Closure) {
+          callee_cl = callee_val.GetClosure();
+          callee_proto = callee_cl->proto;
+        } else {
+          VM_FAIL(NotCallable);
+        }
+        const FnProto *callee = &program_.protos_[callee_proto];
+        if (callee->arity != arg_b(ins)) {
+          VM_FAIL(WrongArgCount);
+        }
+        if (frames_.size() == MAX_CALL_DEPTH) {
+          VM_FAIL(StackOverflow);
+        }
+        if (!deadline_.Check()) {
+          VM_FAIL(TimedOut);
+        }
+
+        frames_.push_back(Frame{proto, pc, base, cl});
+        base += arg_a(ins) + 1u;
+        if (base + callee->num_regs > regs_.size()) {
+          grow_regs(base + callee->num_regs);
+        }
+        R = regs_.data() + base;
+        proto = callee;
+        pc = callee->code.data();
+        cl = callee_cl;
+        VM_NEXT();
+      }
+      VM_CASE(Ret) {
+        if (frames_.empty()) {
+          // A top level return ends the program.
+          return true;
+        }
+        if (!open_upvals_.empty()) {
+          close_upvalues(base);
+        }
+        R[-1] = R[arg_a(ins)];
+        const Frame &frame = frames_.back();
+        proto = frame.proto;
+        pc = frame.pc;
+        base = frame.base;
+        cl = frame.closure;
+        frames_.pop_back();
+        R = regs_.data() + base;
+        VM_NEXT();
+      }
+      VM_CASE(RetNil) {
+        if (frames_.empty()) {
+          return true;
+        }
+        if (!open_upvals_.empty()) {
+          close_upvalues(base);
+        }
+        R[-1] = Value();
+        const Frame &frame = frames_.back();
+        proto = frame.proto;
+        pc = frame.pc;
+        base = frame.base;
+        cl = frame.closure;
+        frames_.pop_back();
+        R = regs_.data() + base;
+        VM_NEXT();
+      }
+      VM_CASE(Print) {
+        uint8_t first = arg_a(ins);
+        for (uint8_t i = 0; i < arg_b(ins); i++) {
+          if (i != 0) {
+            out_ << ' ';
+          }
+          R[first + i].Print(out_);
+        }
+        out_ << '\n';
+        VM_NEXT();
+      }
+      VM_CASE(Range) {
+        const Value &start = R[arg_b(ins)];
+        const Value &end = R[arg_c(ins)];
+        if (start.Kind() != ValueKind::Number ||
+            end.Kind() != ValueKind::Number) {
+          VM_FAIL(TypeMismatch);
+        }
+        R[arg_a(ins)] = Value::FromRange(start.GetNumber(), end.GetNumber());
+        VM_NEXT();
+      }
+      VM_CASE(ForPrep) {
+        ValueKind kind = R[arg_a(ins)].Kind();
+        if (kind != ValueKind::Range && kind != ValueKind::String) {
+          VM_FAIL(NotIterable);
+        }
+        R[arg_a(ins) + 1] = Value::FromNumber(0);
+        pc += arg_sbx(ins);
+        VM_NEXT();
+      }
+      VM_CASE(ForLoop) {
+        // The verifier does not tie a ForLoop to the ForPrep that set up its
+        // registers, so code loaded from a cache file may reach one without
+        // it.
+        Value *loop = R + arg_a(ins);
+        if (loop[1].Kind() != ValueKind::Number) {
+          VM_FAIL(NotIterable);
+        }
+        double count = loop[1].GetNumber();
+        if (loop[0].Kind() == ValueKind::Range) {
+          double i = loop[0].RangeStart() + count;
+          if (i < loop[0].RangeEnd()) {
+            loop[2] = Value::FromNumber(i);
+            loop[3] = Value::FromNumber(count);
+            loop[1] = Value::FromNumber(count + 1);
+            if (!deadline_.Check()) {
+              VM_FAIL(TimedOut);
+            }
+            pc += arg_sbx(ins);
+          }
+        } else if (loop[0].Kind() == ValueKind::String) {
+          std::string_view str = loop[0].GetString();
+          size_t i = static_cast<size_t>(count);
+          if (i < str.size()) {
+            loop[2] = Value::FromString(str.substr(i, 1));
+            loop[3] = Value::FromNumber(count);
+            loop[1] = Value::FromNumber(count + 1);
+            if (!deadline_.Check()) {
+              VM_FAIL(TimedOut);
+            }
+            pc += arg_sbx(ins);
+          }
+        } else {
+          VM_FAIL(NotIterable);
+        }
+        VM_NEXT();
+      }
+    }
+  }
+}
+
+// Returns the upvalue for register slot, sharing it with any closure that
+// already captured the same variable.
+Upvalue *VM::open_upvalue(size_t slot) {
+  auto it = std::lower_bound(
+      open_upvals_.begin(), open_upvals_.end(), slot,
+      [](const Upvalue *upval, size_t s) { return upval->slot < s; });
+  if (it != open_upvals_.end() && (*it)->slot == slot) {
+    return *it;
+  }
+  Upvalue *upval = closures_.NewOpenUpvalue(&regs_[slot], slot);
+  open_upvals_.insert(it, upval);
+  return upval;
+}
+
+void VM::close_upvalues(size_t from) {
+  while (!open_upvals_.empty() && open_upvals_.back()->slot >= from) {
+    Upvalue *upval = open_upvals_.back();
+    upval->value = *upval->loc;
+    upval->loc = &upval->value;
+    open_upvals_.pop_back();
+  }
+}
+
+// Resizing moves the registers, so the open upvalues are pointed at their
+// new place.
+void VM::grow_regs(size_t needed) {
+  regs_.resize(std::max(regs_.size() * 2, needed));
+  for (Upvalue *upval : open_upvals_) {
+    upval->loc = &regs_[upval->slot];
+  }
+}
+
+bool VM::fail(RuntimeErrorKind kind, const FnProto *proto, const Instr *pc) {
+  size_t at = static_cast<size_t>(pc - proto->code.data()) - 1;
+  auto loc = source_.Locate(proto->offsets[at]);
+  error_ = RuntimeError(kind, loc.line, loc.col);
+  return false;
+}
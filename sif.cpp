@@ -1,10 +1,47 @@
 #include "sif/Driver/driver.h"
+#include "sif/Driver/server.h"
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
 
 using namespace sif;
 
+static int usage() {
+  std::cerr << "usage: sif [--vm] [--cache] [--stats[=json]] [-j <threads>] "
+               "[--timeout <seconds>] <file or ->\n"
+            << "       sif --check [--stats[=json]] [-j <threads>] "
+               "<file or directory>...\n"
+            << "       sif --serve <socket> [-j <threads>]\n"
+            << "       sif --connect <socket> <arguments>...\n";
+  return 1;
+}
+
 int main(int argc, char *argv[]) {
-  std::string filename = argv[1];
-  Driver driver = Driver(filename);
-  driver.run();
-  return 0;
+  std::vector<std::string> args(argv + 1, argv + argc);
+
+  // A server takes the arguments of each request from its client instead.
+  if (args.size() >= 2 && args[0] == "--serve") {
+    size_t jobs = 0;
+    if (args.size() == 4 && args[2] == "-j") {
+      jobs = std::strtoul(args[3].c_str(), nullptr, 10);
+    } else if (args.size() != 2) {
+      return usage();
+    }
+    Server server = Server(args[1], jobs);
+    return server.Run();
+  }
+  if (args.size() >= 3 && args[0] == "--connect") {
+    return SendRequest(args[1],
+                       std::vector<std::string>(args.begin() + 2, args.end()));
+  }
+
+  std::vector<std::string> paths;
+  DriverOptions opts;
+  if (!ParseArgs(args, paths, opts)) {
+    return usage();
+  }
+
+  Driver driver = Driver(paths, opts);
+  return driver.run();
 }
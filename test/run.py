@@ -1,6 +1,36 @@
 import os
 import argparse
+import json
+import socket
 import subprocess
+import tempfile
+import time
+
+# Returns the programs in a suite. Each may have an expected stdout in a
+# .out file and expected diagnostics in a .err file next to it.
+def tests(test_dir, folder):
+    folder_path = os.path.join(test_dir, folder)
+    return [os.path.join(folder_path, f) for f in sorted(os.listdir(folder_path)) if f.endswith(".sif")]
+
+# Checks how a test ran. Programs in a *_fail suite must fail with a
+# diagnostic rather than crash, unless they were only checked and fail
+# only when run.
+def expect(result, input_path, how, check_only=False):
+    name = os.path.basename(input_path)
+    suite = os.path.basename(os.path.dirname(input_path))
+    fails = suite == "parse_fail" or (suite == "run_fail" and not check_only)
+    if not fails:
+        assert result.returncode == 0, f"test '{name}' {how} failed:\n{result.stderr}"
+    else:
+        assert result.returncode == 1, f"test '{name}' {how} exited with {result.returncode}, not 1"
+    if check_only:
+        return
+    base = os.path.splitext(input_path)[0]
+    for ext, actual in ((".out", result.stdout), (".err", result.stderr)):
+        if os.path.exists(base + ext):
+            with open(base + ext) as f:
+                expected = f.read()
+            assert actual == expected, f"test '{name}' {how} wrote {actual!r}, expected {expected!r}"
 
 def run():
     parser = argparse.ArgumentParser()
@@ -21,11 +51,154 @@ def run():
         test_dir = "./test"
         folders = [f for f in os.listdir(test_dir) if os.path.isdir(os.path.join(test_dir, f))]
         for folder in folders:
-            folder_path = os.path.join(test_dir, folder)
-            for input in os.listdir(folder_path):
-                input_path = os.path.join(folder_path, input)
-                result = subprocess.run([sif_build, input_path])
-                assert result.returncode == 0, f"test '{input}' failed"
+            for input_path in tests(test_dir, folder):
+                # Every test must pass on both the tree walker and the VM.
+                for flags in ([], ["--vm"]):
+                    result = subprocess.run([sif_build, *flags, input_path], capture_output=True, text=True)
+                    expect(result, input_path, " ".join(flags))
+                # And when it is piped in rather than named. A program that
+                # only fails when run still parses.
+                for flags in ([], ["--vm"], ["--check"]):
+                    with open(input_path, "rb") as stdin:
+                        result = subprocess.run([sif_build, *flags, "-"], stdin=stdin, capture_output=True, text=True)
+                    expect(result, input_path, f"{' '.join(flags)} on stdin", flags == ["--check"])
+
+        # The passing suites must also pass when checked in one parallel run,
+        # and the programs that do not parse must fail it.
+        pass_dirs = [os.path.join(test_dir, f) for f in folders if not f.endswith("_fail")]
+        result = subprocess.run([sif_build, "--check", *pass_dirs])
+        assert result.returncode == 0, "checking the test directory failed"
+        result = subprocess.run([sif_build, "--check", os.path.join(test_dir, "parse_fail")], capture_output=True)
+        assert result.returncode == 1, "checking the parse_fail directory did not fail"
+
+        # Stats come after any diagnostics, as one line of JSON.
+        result = subprocess.run([sif_build, "--check", "--stats=json", *pass_dirs], capture_output=True, text=True)
+        assert result.returncode == 0, "checking the test directory with stats failed"
+        stats = json.loads(result.stderr.splitlines()[-1])
+        assert stats["bytes_read"] > 0, "no bytes read"
+        if stats["counters_enabled"]:
+            assert stats["tokens"]["Eof"] == stats["ast_nodes"]["Program"], "tokens and files disagree"
+
+        # A program too large for the VM's 16 bit operands still runs, on
+        # the tree walker. Names cannot hold digits, so the functions are
+        # named in base 26.
+        def name(i):
+            letters = ""
+            while True:
+                letters = chr(ord("a") + i % 26) + letters
+                i //= 26
+                if i == 0:
+                    return "zz" + letters
+        count = 70000
+        big = "".join(f"fn {name(i)}() {{\n  return {i};\n}}\n" for i in range(count))
+        big += f"print({name(count - 1)}());\n"
+        for flags in ([], ["--vm"]):
+            result = subprocess.run([sif_build, *flags, "-"], input=big, capture_output=True, text=True)
+            assert result.returncode == 0, f"a program with {count} functions {' '.join(flags)} failed:\n{result.stderr}"
+            assert result.stdout == f"{count - 1}\n", f"a program with {count} functions {' '.join(flags)} wrote {result.stdout!r}"
+
+        # Run through the bytecode cache twice: the first run compiles and
+        # writes a cache file, and the second must load it, leaving it as it
+        # is, and behave the same.
+        with tempfile.TemporaryDirectory() as cache_dir:
+            env = dict(os.environ, SIF_CACHE_DIR=cache_dir)
+            for folder in folders:
+                if folder == "parse_fail":
+                    continue
+                for input_path in tests(test_dir, folder):
+                    before = set(os.listdir(cache_dir))
+                    result = subprocess.run([sif_build, "--cache", input_path], capture_output=True, text=True, env=env)
+                    expect(result, input_path, "--cache on a miss")
+                    written = set(os.listdir(cache_dir)) - before
+                    if folder.endswith("_fail") and not written:
+                        # It failed to compile, so nothing was cached.
+                        continue
+                    assert len(written) == 1, f"test '{input_path}' wrote {len(written)} cache files"
+                    cache_path = os.path.join(cache_dir, written.pop())
+                    stat = os.stat(cache_path)
+                    result = subprocess.run([sif_build, "--cache", input_path], capture_output=True, text=True, env=env)
+                    expect(result, input_path, "--cache on a hit")
+                    after = os.stat(cache_path)
+                    assert (after.st_ino, after.st_mtime_ns) == (stat.st_ino, stat.st_mtime_ns), \
+                        f"test '{input_path}' missed the cache on its second run"
+
+        # A program that would run for hours fails once its --timeout has
+        # passed, on both engines, whether it loops or recurses.
+        loop = "for i in range(0, 1000000000000) {\n  print(i + 1 == 0);\n}\n"
+        recurse = "fn fib(n) {\n  if n < 2 {\n    return n;\n  }\n  return fib(n - 1) + fib(n - 2);\n}\nfib(90);\n"
+        for program, where in ((loop, "line 1,"), (recurse, "line 5,")):
+            for flags in ([], ["--vm"]):
+                result = subprocess.run([sif_build, *flags, "--timeout", "1", "-"], input=program,
+                                        capture_output=True, text=True, timeout=30)
+                assert result.returncode == 1, f"a --timeout run {' '.join(flags)} exited with {result.returncode}"
+                assert f"ran for too long at {where}" in result.stderr, \
+                    f"a --timeout run {' '.join(flags)} wrote {result.stderr!r}"
+
+        # The cache is kept to $SIF_CACHE_SIZE by evicting the least recently
+        # used files, where every hit is a use, not only the first one after
+        # a write. The programs are the same size, so each leaves a file of
+        # the same size, and the cap fits two of them.
+        with tempfile.TemporaryDirectory() as cache_dir, tempfile.TemporaryDirectory() as src_dir:
+            def cached(name, size):
+                path = os.path.join(src_dir, name + ".sif")
+                with open(path, "w") as f:
+                    f.write(f"print({ord(name)});\n")
+                env = dict(os.environ, SIF_CACHE_DIR=cache_dir, SIF_CACHE_SIZE=str(size))
+                result = subprocess.run([sif_build, "--cache", path], capture_output=True, text=True, env=env)
+                assert result.returncode == 0, f"caching '{name}' failed:\n{result.stderr}"
+                return set(os.listdir(cache_dir))
+            first = cached("a", 1 << 20)
+            file_size = os.path.getsize(os.path.join(cache_dir, *first))
+            cap = 2 * file_size + file_size // 2
+            cached("a", cap)
+            second = cached("b", cap) - first
+            cached("a", cap)
+            third = cached("c", cap) - first - second
+            assert set(os.listdir(cache_dir)) == first | third, \
+                "the cache did not evict its least recently used file"
+
+        # Every program that parses must come back unchanged from a round
+        # trip through the flat AST, when the benchmarks have been built.
+        flat_bench = "./build/bench/flat_ast_bench"
+        if os.path.exists(flat_bench):
+            for folder in folders:
+                if folder == "parse_fail":
+                    continue
+                for input_path in tests(test_dir, folder):
+                    result = subprocess.run([flat_bench, input_path, "1"], capture_output=True, text=True)
+                    assert result.returncode == 0, f"flat AST round trip of '{input_path}' failed:\n{result.stderr}"
+
+        # And once more through a server, which must answer just as sif does.
+        with tempfile.TemporaryDirectory() as tmp:
+            sock_path = os.path.join(tmp, "sif.sock")
+            server = subprocess.Popen([sif_build, "--serve", sock_path])
+            try:
+                while True:
+                    assert server.poll() is None, "the server failed to start"
+                    try:
+                        with socket.socket(socket.AF_UNIX) as probe:
+                            probe.connect(sock_path)
+                        break
+                    except OSError:
+                        time.sleep(0.01)
+                for folder in folders:
+                    for input_path in tests(test_dir, folder):
+                        for flags in ([], ["--vm"]):
+                            result = subprocess.run([sif_build, "--connect", sock_path, *flags, input_path],
+                                                    capture_output=True, text=True)
+                            expect(result, input_path, f"{' '.join(flags)} on the server")
+                result = subprocess.run([sif_build, "--connect", sock_path, "--check", *pass_dirs])
+                assert result.returncode == 0, "checking the test directory failed on the server"
+                # A request that runs too long fails, and frees its thread.
+                with open(os.path.join(tmp, "loop.sif"), "w") as f:
+                    f.write(loop)
+                result = subprocess.run([sif_build, "--connect", sock_path, "--timeout", "1", os.path.join(tmp, "loop.sif")],
+                                        capture_output=True, text=True, timeout=30)
+                assert result.returncode == 1 and "ran for too long" in result.stderr, \
+                    f"a --timeout request exited with {result.returncode}: {result.stderr!r}"
+            finally:
+                server.terminate()
+                server.wait()
 
 if __name__ == "__main__":
     run()